@@ -1,8 +1,38 @@
+// the one translation unit that counts allocations
+#define PINTTEST_TRACK_ALLOCATIONS
 #include "PintTest.h"
 
 #include <vector>
 #include <string_view>
 #include <iostream>
+#include <filesystem>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <sstream>
+#include <tuple>
+#include <cmath>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <optional>
+#include <numeric>
+#include <deque>
+#include <map>
+#include <set>
+#include <stdexcept>
+#include <cstring>
+
+#ifdef __linux__
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#endif
 
 namespace
 {
@@ -28,6 +58,79 @@ namespace
     {
         EXPECT_TRUE(false);
     }
+
+    // A fixture for TEST_F, which every unfiltered run below runs as well
+    struct MacroFixture : PintTest::Fixture
+    {
+        static void SetUpSuite() { s_shared = std::make_unique<int>(2); ++s_setUps; }
+        static void TearDownSuite() { s_shared.reset(); }
+        void SetUp() { m_value = *s_shared; }
+        static inline std::unique_ptr<int> s_shared;
+        static inline int s_setUps = 0;
+        int m_value = 0;
+    };
+    TEST_F(MacroFixture, UsesMembers)
+    {
+        ASSERT_TRUE(s_shared != nullptr);
+        EXPECT_EQ(m_value, times2(1));
+    }
+
+    // A PROPERTY, which every unfiltered run checks as well
+    std::atomic<int> sortIgnoresRotationCases = 0;
+    PROPERTY(SortIgnoresRotation, PintTest::Gen::vectors(PintTest::Gen::integers(-100, 100)), PintTest::Gen::integers(0, 10))(const std::vector<int>& v, int by)
+    {
+        ++sortIgnoresRotationCases;
+        auto rotated = v;
+        if (!v.empty())
+            std::rotate(rotated.begin(), rotated.begin() + by % std::ssize(v), rotated.end());
+        auto sorted = v;
+        std::sort(sorted.begin(), sorted.end());
+        std::sort(rotated.begin(), rotated.end());
+        EXPECT_RANGE_EQ(rotated, sorted) << "rotated by " << by;
+    }
+
+    // A TEST_ASYNC, which every unfiltered run runs as well
+    std::atomic<int> asyncMacroRuns = 0;
+    TEST_ASYNC(SleepsAsync)
+    {
+        const auto start = std::chrono::steady_clock::now();
+        co_await PintTest::sleepFor(std::chrono::milliseconds(1));
+        EXPECT_GE(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(1));
+        ++asyncMacroRuns;
+    }
+
+    // A fixture that counts its TearDowns, for tests run with runFixtureTest
+    struct CountedFixture : PintTest::Fixture
+    {
+        static inline int s_tearDowns = 0;
+        void TearDown() { ++s_tearDowns; }
+    };
+
+#ifdef __linux__
+    // Touch size bytes of newly mapped memory, mapped directly so that malloc can't hand back pages already resident
+    void touchNewMemory(size_t size)
+    {
+        void* const memory = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (memory == MAP_FAILED)
+            return;
+        std::memset(memory, 1, size);
+        PintTest::DoNotOptimize(memory);
+        PintTest::ClobberMemory();
+        ::munmap(memory, size);
+    }
+#endif
+
+    int benchmarkRuns = 0;
+    BENCHMARK(benchtimes2)
+    {
+        ++benchmarkRuns;
+        int x = 1;
+        while (state.keepRunning())
+        {
+            PintTest::DoNotOptimize(x);
+            PintTest::DoNotOptimize(times2(x));
+        }
+    }
 }
 
 int main()
@@ -70,7 +173,7 @@ int main()
             std::cerr << "Test failed at line " << __LINE__ << "\n";
             return 1;
         }
-        if (ran != 4)
+        if (ran != 7)
         {
             std::cerr << "Test failed at line " << __LINE__ << "\n";
             return 1;
@@ -88,7 +191,7 @@ int main()
             std::cerr << "Test failed at line " << __LINE__ << "\n";
             return 1;
         }
-        if (ran != 4)
+        if (ran != 7)
         {
             std::cerr << "Test failed at line " << __LINE__ << "\n";
             return 1;
@@ -107,7 +210,7 @@ int main()
                 std::cerr << "Test failed at line " << __LINE__ << "\n";
                 return 1;
             }
-            if (ran != 4)
+            if (ran != 7)
             {
                 std::cerr << "Test failed at line " << __LINE__ << "\n";
                 return 1;
@@ -132,22 +235,73 @@ int main()
             return 1;
         }
     }
+    // several filters can be given - a test runs if it matches any of the includes and none of the excludes
+    for (const auto& vec :
+        {
+            std::vector<std::string_view>{"--filter=abc", "--filter=def"}
+            ,std::vector<std::string_view>{"--filter=abc", "--filter=-def"}
+            ,std::vector<std::string_view>{"--filter=times2", "--filter=-times2"}
+        })
     {
-        const auto [ran, failed] = PintTest::runAllTests2(std::vector<std::string_view>{"--filter=abc", "--filter=def"});
-        if (-1 != ran)
+        const auto [ran, failed] = PintTest::runAllTests2(vec);
+        if (ran != 1 || failed != 0)
+        {
+            std::cerr << "Test failed at line " << __LINE__ << "\n";
+            return 1;
+        }
+    }
+    for (const auto& [vec, expectedRan, expectedFailed] :
+        {
+            std::tuple{ std::vector<std::string_view>{"--filter=test*"}, 3, 0 }
+            ,std::tuple{ std::vector<std::string_view>{"--filter=*times2"}, 2, 0 }
+            ,std::tuple{ std::vector<std::string_view>{"--filter=test?imes2"}, 2, 0 }
+            ,std::tuple{ std::vector<std::string_view>{"--filter=-*Fail*"}, 6, 0 }
+            ,std::tuple{ std::vector<std::string_view>{"--filter=/^This/"}, 2, 1 }
+            ,std::tuple{ std::vector<std::string_view>{"--filter=/^This/", "--filter=Wrong"}, 3, 1 }
+            ,std::tuple{ std::vector<std::string_view>{"--filter=times2", "--filter=-/Wrong$/"}, 2, 0 }
+            ,std::tuple{ std::vector<std::string_view>{"--filter=abc", "--filter=Always", "--filter=xyz"}, 2, 1 }
+        })
+    {
+        const auto [ran, failed] = PintTest::runAllTests2(vec);
+        if (ran != expectedRan || failed != expectedFailed)
+        {
+            std::cerr << "Test failed at line " << __LINE__ << "\n";
+            return 1;
+        }
+    }
+    // the substring patterns are built into the automaton once, however many of them there are
+    {
+        std::vector<std::string> patterns;
+        for (int i = 0; i < 5000; ++i)
+            patterns.push_back("--filter=NoSuchTest" + std::to_string(i));
+        patterns.emplace_back("--filter=Always");
+        const auto start = std::chrono::steady_clock::now();
+        const auto [ran, failed] = PintTest::runAllTests2(std::vector<std::string_view>(patterns.begin(), patterns.end()));
+        if (ran != 2 || failed != 1 || std::chrono::steady_clock::now() - start > std::chrono::seconds(2))
         {
             std::cerr << "Test failed at line " << __LINE__ << "\n";
             return 1;
         }
     }
     {
-        const auto [ran, failed] = PintTest::runAllTests2(std::vector<std::string_view>{"--filter=abc", "--filter=-def"});
+        const auto [ran, failed] = PintTest::runAllTests2(std::vector<std::string_view>{"--filter=/(/"});
         if (-1 != ran)
         {
             std::cerr << "Test failed at line " << __LINE__ << "\n";
             return 1;
         }
     }
+    {
+        std::ostringstream listed;
+        auto* const coutBuffer = std::cout.rdbuf(listed.rdbuf());
+        const auto [ran, failed] = PintTest::runAllTests2(std::vector<std::string_view>{"--list-tests", "--filter=-Fails"});
+        std::cout.rdbuf(coutBuffer);
+        if (ran != 0 || failed != 0 || listed.str() != "testtimes2\ntesttimes2Wrong\nMacroFixture.UsesMembers\nSortIgnoresRotation\nSleepsAsync\n")
+        {
+            std::cerr << "Test failed at line " << __LINE__ << "\n";
+            return 1;
+        }
+    }
     for (const auto& vec :
         {
             std::vector<std::string_view>{"--filter=rong"}
@@ -183,7 +337,1328 @@ int main()
             std::cerr << "Test failed at line " << __LINE__ << "\n";
             return 1;
         }
-        if (ran != 3)
+        if (ran != 6)
+        {
+            std::cerr << "Test failed at line " << __LINE__ << "\n";
+            return 1;
+        }
+    }
+    for (const auto& vec :
+        {
+            std::vector<std::string_view>{"--jobs=2"}
+            ,std::vector<std::string_view>{"--jobs=0"}
+            ,std::vector<std::string_view>{"--jobs=8", "--filter=-nothing"}
+        })
+    {
+        const auto [ran, failed] = PintTest::runAllTests2(vec);
+        if (1 != failed)
+        {
+            std::cerr << "Test failed at line " << __LINE__ << "\n";
+            return 1;
+        }
+        if (ran != 7)
+        {
+            std::cerr << "Test failed at line " << __LINE__ << "\n";
+            return 1;
+        }
+    }
+    for (const auto& vec :
+        {
+            std::vector<std::string_view>{"--jobs="}
+            ,std::vector<std::string_view>{"--jobs=two"}
+        })
+    {
+        const auto [ran, failed] = PintTest::runAllTests2(vec);
+        if (-1 != ran)
+        {
+            std::cerr << "Test failed at line " << __LINE__ << "\n";
+            return 1;
+        }
+    }
+    for (const auto& vec :
+        {
+            std::vector<std::string_view>{"--shard-index=0"}
+            ,std::vector<std::string_view>{"--total-shards=2"}
+            ,std::vector<std::string_view>{"--shard-index=2", "--total-shards=2"}
+            ,std::vector<std::string_view>{"--shard-index=0", "--total-shards=0"}
+        })
+    {
+        const auto [ran, failed] = PintTest::runAllTests2(vec);
+        if (-1 != ran)
+        {
+            std::cerr << "Test failed at line " << __LINE__ << "\n";
+            return 1;
+        }
+    }
+    {
+        const auto shard0 = (std::filesystem::temp_directory_path() / "PintTestShard0.txt").string();
+        const auto shard1 = (std::filesystem::temp_directory_path() / "PintTestShard1.txt").string();
+        const auto results0 = "--results-file=" + shard0;
+        const auto results1 = "--results-file=" + shard1;
+        const auto [ran0, failed0] = PintTest::runAllTests2(std::vector<std::string_view>{"--shard-index=0", "--total-shards=2", results0});
+        if (ran0 != 4 || failed0 != 1)
+        {
+            std::cerr << "Test failed at line " << __LINE__ << "\n";
+            return 1;
+        }
+        const auto [ran1, failed1] = PintTest::runAllTests2(std::vector<std::string_view>{"--shard-index=1", "--total-shards=2", results1});
+        if (ran1 != 4 || failed1 != 0)
+        {
+            std::cerr << "Test failed at line " << __LINE__ << "\n";
+            return 1;
+        }
+        const auto merge0 = "--merge-results=" + shard0;
+        const auto merge1 = "--merge-results=" + shard1;
+        const auto [ran, failed] = PintTest::runAllTests2(std::vector<std::string_view>{merge0, merge1});
+        std::filesystem::remove(shard0);
+        std::filesystem::remove(shard1);
+        if (ran != 6 || failed != 1)
+        {
+            std::cerr << "Test failed at line " << __LINE__ << "\n";
+            return 1;
+        }
+    }
+    {
+        // benchmarks are skipped unless asked for
+        const auto [ran, failed] = PintTest::runAllTests2(std::vector<std::string_view>{"--filter=benchtimes2"});
+        if (ran != 1 || failed != 0 || benchmarkRuns != 0)
+        {
+            std::cerr << "Test failed at line " << __LINE__ << "\n";
+            return 1;
+        }
+    }
+    {
+        const auto [ran, failed] = PintTest::runAllTests2(std::vector<std::string_view>{"--benchmark", "--filter=benchtimes2"});
+        if (ran != 1 || failed != 0 || benchmarkRuns == 0)
+        {
+            std::cerr << "Test failed at line " << __LINE__ << "\n";
+            return 1;
+        }
+    }
+    // a benchmark that doesn't run its loop to the end has timed nothing, and fails rather than being run forever with
+    // ever more iterations
+    {
+        PintTest::registerBenchmarkFn("ReturnsBeforeLoop", [](PintTest::BenchmarkState&) {});
+        PintTest::registerBenchmarkFn("BreaksOutOfLoop", [](PintTest::BenchmarkState& state)
+            {
+                while (state.keepRunning())
+                    break;
+            });
+        if (PintTest::runAllTests2({ "--output=quiet", "--benchmark", "--filter=ReturnsBeforeLoop", "--filter=BreaksOutOfLoop" }) != std::pair{ 1, 2 })
+        {
+            std::cerr << "Test failed at line " << __LINE__ << "\n";
+            return 1;
+        }
+    }
+    for (const auto& vec :
+        {
+            std::vector<std::string_view>{"--output=xml"}
+            ,std::vector<std::string_view>{"--output=quiet:file.txt"}
+            ,std::vector<std::string_view>{"--output=json:/no/such/directory/results.json"}
+        })
+    {
+        const auto [ran, failed] = PintTest::runAllTests2(vec);
+        if (-1 != ran)
+        {
+            std::cerr << "Test failed at line " << __LINE__ << "\n";
+            return 1;
+        }
+    }
+    {
+        const auto jsonFile = (std::filesystem::temp_directory_path() / "PintTestResults.json").string();
+        const auto junitFile = (std::filesystem::temp_directory_path() / "PintTestResults.xml").string();
+        const auto jsonArg = "--output=json:" + jsonFile;
+        const auto junitArg = "--output=junit:" + junitFile;
+        const auto [ran, failed] = PintTest::runAllTests2(std::vector<std::string_view>{"--output=quiet", jsonArg, junitArg});
+        if (ran != 7 || failed != 1)
+        {
+            std::cerr << "Test failed at line " << __LINE__ << "\n";
+            return 1;
+        }
+        const auto readFile = [](const std::string& fileName)
+        {
+            std::ifstream file(fileName);
+            return std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+        };
+        const auto json = readFile(jsonFile);
+        const auto junit = readFile(junitFile);
+        std::filesystem::remove(jsonFile);
+        std::filesystem::remove(junitFile);
+        if (json.find("\"name\": \"ThisAlwaysFails\", \"status\": \"failed\"") == std::string::npos
+            || json.find("\"tests_ran\": 7, \"tests_failed\": 1") == std::string::npos)
+        {
+            std::cerr << "Test failed at line " << __LINE__ << "\n";
+            return 1;
+        }
+        if (junit.find("<testcase name=\"ThisAlwaysFails\"") == std::string::npos
+            || junit.find("<failure type=\"failure\"") == std::string::npos
+            || !junit.ends_with("</testsuites>\n"))
+        {
+            std::cerr << "Test failed at line " << __LINE__ << "\n";
+            return 1;
+        }
+    }
+    {
+        struct CountingReporter : PintTest::Reporter
+        {
+            int m_finished = 0;
+            int m_failed = 0;
+            void testFinished(const PintTest::TestResult& result) override
+            {
+                ++m_finished;
+                m_failed += result.passed() ? 0 : 1;
+            }
+        };
+        const auto counter = std::make_shared<CountingReporter>();
+        PintTest::addReporter(counter);
+        const auto [ran, failed] = PintTest::runAllTests2(std::vector<std::string_view>{"--output=quiet"});
+        if (ran != 7 || counter->m_finished != 7 || counter->m_failed != 1)
+        {
+            std::cerr << "Test failed at line " << __LINE__ << "\n";
+            return 1;
+        }
+    }
+    {
+        PintTest::PerfCounters counters;
+        counters.m_values[PintTest::PerfCounters::CYCLES] = 200;
+        counters.m_values[PintTest::PerfCounters::INSTRUCTIONS] = 300;
+        counters.m_available = 1u << PintTest::PerfCounters::CYCLES;
+        if (counters.ipc() || !counters.has(PintTest::PerfCounters::CYCLES) || counters.has(PintTest::PerfCounters::INSTRUCTIONS))
+        {
+            std::cerr << "Test failed at line " << __LINE__ << "\n";
+            return 1;
+        }
+        counters.m_available |= 1u << PintTest::PerfCounters::INSTRUCTIONS;
+        if (counters.ipc() != 1.5)
+        {
+            std::cerr << "Test failed at line " << __LINE__ << "\n";
+            return 1;
+        }
+    }
+    {
+        // the counters may well not be available where the tests run, in which case they are left out, but the tests
+        // still run
+        struct CountersReporter : PintTest::Reporter
+        {
+            int m_finished = 0;
+            int m_badCounters = 0;
+            void testFinished(const PintTest::TestResult& result) override
+            {
+                ++m_finished;
+                if (result.m_counters && result.m_counters->m_available == 0)
+                    ++m_badCounters;
+            }
+        };
+        const auto counters = std::make_shared<CountersReporter>();
+        PintTest::addReporter(counters);
+        const auto [ran, failed] = PintTest::runAllTests2(std::vector<std::string_view>{"--output=quiet", "--perf-counters", "--jobs=2"});
+        if (ran != 7 || failed != 1 || counters->m_finished != 7 || counters->m_badCounters != 0)
+        {
+            std::cerr << "Test failed at line " << __LINE__ << "\n";
+            return 1;
+        }
+    }
+    {
+        const auto ranges = PintTest::executeTest([]
+            {
+                std::vector<int> a(1000);
+                std::vector<int> b(1000);
+                EXPECT_RANGE_EQ(a, b);
+                std::vector<float> f{ 1.0f, 2.0f };
+                std::vector<float> g{ 1.0f, std::nextafter(2.0f, 3.0f) };
+                EXPECT_RANGE_NEAR(f, g, PintTest::Tolerance::ulps(1));
+                EXPECT_RANGE_NEAR(f, g, 1e-6);
+                b[500] = 1;
+                b[502] = 2;
+                EXPECT_RANGE_EQ(a, b);
+                EXPECT_RANGE_NEAR(f, g, PintTest::Tolerance::ulps(0));
+                EXPECT_RANGE_EQ(f, std::vector<float>{ 1.0f });
+            }, "Ranges");
+        if (ranges.m_fails != 3 || ranges.m_failures.size() != 3
+            || ranges.m_failures[0].m_message.find("2 of 1000 elements differ, the first at index 500") == std::string::npos
+            || ranges.m_failures[0].m_message.find("* [502] 0 vs 2") == std::string::npos
+            || ranges.m_failures[0].m_message.find("[498]") == std::string::npos
+            || ranges.m_failures[0].m_message.find("[497]") != std::string::npos
+            || ranges.m_failures[1].m_message.find("* [1] 2 vs 2.0000002 (1 ulps)") == std::string::npos
+            || ranges.m_failures[2].m_message.find("Sizes: 2 and 1") == std::string::npos)
+        {
+            std::cerr << "Test failed at line " << __LINE__ << "\n";
+            return 1;
+        }
+    }
+    {
+        const auto noAllocs = PintTest::executeTest([] { int i = 1; EXPECT_NO_ALLOC { PintTest::DoNotOptimize(i); } }, "NoAllocs");
+        if (!noAllocs.passed() || !noAllocs.m_allocations || noAllocs.m_allocations->m_allocations != 0)
+        {
+            std::cerr << "Test failed at line " << __LINE__ << "\n";
+            return 1;
+        }
+        const auto withinLimit = PintTest::executeTest([] { EXPECT_ALLOCS_LE(1) { auto p = std::make_unique<int>(1); PintTest::DoNotOptimize(p); } }, "WithinLimit");
+        if (!withinLimit.passed() || !withinLimit.m_allocations || withinLimit.m_allocations->m_allocations != 1
+            || withinLimit.m_allocations->m_bytes != sizeof(int))
+        {
+            std::cerr << "Test failed at line " << __LINE__ << "\n";
+            return 1;
+        }
+        const auto overLimit = PintTest::executeTest([] { EXPECT_NO_ALLOC { std::vector<int> v(4); PintTest::DoNotOptimize(v); } }, "OverLimit");
+        if (overLimit.m_fails != 1 || overLimit.m_failures.size() != 1
+            || overLimit.m_failures[0].m_message.find("Actual: 1 (16 bytes)") == std::string::npos)
+        {
+            std::cerr << "Test failed at line " << __LINE__ << "\n";
+            return 1;
+        }
+        // a block left by break or return is still checked
+        const auto broken = PintTest::executeTest([]
+            {
+                for (int i = 0; i < 2; ++i)
+                    EXPECT_NO_ALLOC { std::vector<int> v(4); PintTest::DoNotOptimize(v); break; }
+            }, "BreaksOut");
+        const auto returned = PintTest::executeTest([] { EXPECT_NO_ALLOC { std::vector<int> v(4); PintTest::DoNotOptimize(v); return; } }, "ReturnsOut");
+        if (broken.m_fails != 2 || returned.m_fails != 1 || returned.m_failures.size() != 1
+            || returned.m_failures[0].m_message.find("Actual: 1 (16 bytes)") == std::string::npos)
+        {
+            std::cerr << "Test failed at line " << __LINE__ << "\n";
+            return 1;
+        }
+        // the nothrow new returns nullptr when the new_handler throws, rather than letting it escape
+        const auto oldHandler = std::set_new_handler([] { throw std::bad_alloc(); });
+        void* const huge = ::operator new(std::numeric_limits<std::size_t>::max() / 2, std::nothrow);
+        std::set_new_handler(oldHandler);
+        if (huge)
+        {
+            std::cerr << "Test failed at line " << __LINE__ << "\n";
+            return 1;
+        }
+    }
+#ifdef __linux__
+    // with --resource-usage each test's CPU time, page faults, context switches and growth of the peak resident set
+    // are reported, and totalled in the summary, and EXPECT_RSS_GROWTH_LE checks the growth over a block
+    {
+        struct ResourcesReporter : PintTest::Reporter
+        {
+            int m_withResources = 0;
+            std::optional<PintTest::ResourceUsage> m_total;
+            void testFinished(const PintTest::TestResult& result) override { m_withResources += result.m_resources.has_value(); }
+            void runFinished(const PintTest::RunSummary& summary) override { m_total = summary.m_resources; }
+        };
+        const auto resources = std::make_shared<ResourcesReporter>();
+        PintTest::addReporter(resources);
+        const auto [ran, failed] = PintTest::runAllTests2({ "--output=quiet", "--resource-usage" });
+        // SleepsAsync runs interleaved with the other async tests, so it has no resource usage of its own
+        if (ran != 7 || failed != 1 || resources->m_withResources != 6 || !resources->m_total)
+        {
+            std::cerr << "Test failed at line " << __LINE__ << "\n";
+            return 1;
+        }
+        // executeTest measures as the last run did
+        const auto touches = PintTest::executeTest([] { touchNewMemory(32 << 20); }, "Touches32MB");
+        if (!touches.passed() || !touches.m_resources || touches.m_resources->m_minorFaults < 1000 ||
+            touches.m_resources->m_peakRssGrowth < (16 << 20))
+        {
+            std::cerr << "Test failed at line " << __LINE__ << "\n";
+            return 1;
+        }
+        const auto growth = PintTest::executeTest([]
+            {
+                EXPECT_RSS_GROWTH_LE(1 << 20) { touchNewMemory(32 << 20); }
+                EXPECT_RSS_GROWTH_LE(256 << 20) { touchNewMemory(32 << 20); }
+                EXPECT_RSS_GROWTH_LE(1 << 20) {}
+            }, "RssGrowth");
+        if (growth.m_fails != 1 || growth.m_failures.size() != 1 ||
+            growth.m_failures[0].m_message.find("peak RSS growth <= 1 << 20\nExpected: at most 1048576 bytes") == std::string::npos)
+        {
+            std::cerr << "Test failed at line " << __LINE__ << "\n";
+            return 1;
+        }
+        // the peak that EXPECT_RSS_GROWTH_LE resets is still the test's
+        const auto checksAfterPeak = PintTest::executeTest([]
+            {
+                touchNewMemory(32 << 20);
+                EXPECT_RSS_GROWTH_LE(1 << 20) {}
+            }, "ChecksAfterPeak");
+        if (!checksAfterPeak.passed() || !checksAfterPeak.m_resources || checksAfterPeak.m_resources->m_peakRssGrowth < (16 << 20))
+        {
+            std::cerr << "Test failed at line " << __LINE__ << "\n";
+            return 1;
+        }
+        resources->m_total.reset();
+        PintTest::runAllTests2({ "--output=quiet" });
+        if (resources->m_total || PintTest::executeTest([] {}, "NotMeasured").m_resources)
+        {
+            std::cerr << "Test failed at line " << __LINE__ << "\n";
+            return 1;
+        }
+    }
+#endif
+    {
+        const auto timingDb = (std::filesystem::temp_directory_path() / "PintTestTimings.txt").string();
+        std::filesystem::remove(timingDb);
+        const auto timingDbArg = "--timing-db=" + timingDb;
+        const auto [ran, failed] = PintTest::runAllTests2(std::vector<std::string_view>{timingDbArg, "--jobs=2", "--slowest=2"});
+        if (ran != 7 || failed != 1)
+        {
+            std::cerr << "Test failed at line " << __LINE__ << "\n";
+            return 1;
+        }
+        std::ifstream file(timingDb);
+        const std::string timings(std::istreambuf_iterator<char>(file), {});
+        file.close();
+        for (const auto* name : { "\ttesttimes2\n", "\ttesttimes2Wrong\n", "\tThisAlwaysFails\n" })
+        {
+            if (timings.find(name) == std::string::npos)
+            {
+                std::cerr << "Test failed at line " << __LINE__ << "\n";
+                return 1;
+            }
+        }
+        // balanced by time, the shards should still run every test exactly once between them.  A shard doesn't save the
+        // timings, which would have the later shard split the tests differently
+        const auto shardResults = (std::filesystem::temp_directory_path() / "PintTestShardResults.txt").string();
+        const auto shardResultsArg = "--results-file=" + shardResults;
+        std::map<std::string, int> shardRuns;
+        int shardFails = 0;
+        for (const std::string_view shardArg : { "--shard-index=0", "--shard-index=1" })
+        {
+            const auto [shardRan, shardFailed] = PintTest::runAllTests2(std::vector<std::string_view>{timingDbArg, shardResultsArg, shardArg, "--total-shards=2"});
+            shardFails += shardFailed;
+            std::ifstream shardFile(shardResults);
+            for (std::string line; std::getline(shardFile, line);)
+                if (!line.starts_with('#'))
+                    ++shardRuns[line.substr(line.rfind('\t') + 1)];
+            std::ifstream afterShard(timingDb);
+            if (shardRan < 1 || std::string(std::istreambuf_iterator<char>(afterShard), {}) != timings)
+            {
+                std::cerr << "Test failed at line " << __LINE__ << "\n";
+                return 1;
+            }
+        }
+        std::filesystem::remove(timingDb);
+        std::filesystem::remove(shardResults);
+        if (shardRuns != std::map<std::string, int>{ { "MacroFixture.UsesMembers", 1 }, { "SleepsAsync", 1 }, { "SortIgnoresRotation", 1 }, { "ThisAlwaysFails", 1 }, { "testtimes2", 1 }, { "testtimes2Wrong", 1 } } ||
+            shardFails != 1)
+        {
+            std::cerr << "Test failed at line " << __LINE__ << "\n";
+            return 1;
+        }
+        const auto [ranBad, failedBad] = PintTest::runAllTests2(std::vector<std::string_view>{"--slowest=many"});
+        if (ranBad != -1)
+        {
+            std::cerr << "Test failed at line " << __LINE__ << "\n";
+            return 1;
+        }
+    }
+#ifndef _WIN32
+    for (const auto& vec :
+        {
+            std::vector<std::string_view>{"--isolate"}
+            ,std::vector<std::string_view>{"--isolate", "--jobs=3"}
+        })
+    {
+        const auto [ran, failed] = PintTest::runAllTests2(vec);
+        if (1 != failed)
+        {
+            std::cerr << "Test failed at line " << __LINE__ << "\n";
+            return 1;
+        }
+        if (ran != 7)
+        {
+            std::cerr << "Test failed at line " << __LINE__ << "\n";
+            return 1;
+        }
+    }
+    // these are registered last, so that they don't affect the counts above
+    PintTest::registerTestFn("CrashesWithAbort", [] { std::abort(); });
+    PintTest::registerTestFn("CrashesWithExit", [] { std::exit(3); });
+    for (const auto& vec :
+        {
+            std::vector<std::string_view>{"--isolate", "--filter=Crashes"}
+            ,std::vector<std::string_view>{"--isolate", "--filter=Crashes", "--jobs=2"}
+        })
+    {
+        const auto [ran, failed] = PintTest::runAllTests2(vec);
+        if (2 != failed)
+        {
+            std::cerr << "Test failed at line " << __LINE__ << "\n";
+            return 1;
+        }
+        if (ran != 3)
+        {
+            std::cerr << "Test failed at line " << __LINE__ << "\n";
+            return 1;
+        }
+    }
+#ifdef __linux__
+    // a worker that can't be started fails its tests, rather than the run ending without them.  The run is made in a
+    // child process, whose file descriptors are limited so that only the first worker's pipe can be made
+    {
+        PintTest::registerTestFn("UnstartedWorkerA", [] {});
+        PintTest::registerTestFn("UnstartedWorkerB", [] {});
+        const pid_t child = ::fork();
+        if (child == 0)
+        {
+            struct NotRunReporter : PintTest::Reporter
+            {
+                int m_notRun = 0;
+                void testFinished(const PintTest::TestResult& result) override
+                {
+                    m_notRun += !result.m_failures.empty() && result.m_failures[0].m_message.find("couldn't start a worker process") != std::string::npos;
+                }
+            };
+            const auto reporter = std::make_shared<NotRunReporter>();
+            PintTest::addReporter(reporter);
+            const int firstFree = ::dup(0);
+            ::close(firstFree);
+            const rlimit limit{ static_cast<rlim_t>(firstFree + 2), static_cast<rlim_t>(firstFree + 2) };
+            ::setrlimit(RLIMIT_NOFILE, &limit);
+            const auto ranAndFailed = PintTest::runAllTests2({ "--output=quiet", "--filter=UnstartedWorker", "--isolate", "--jobs=2" });
+            ::_exit(ranAndFailed == std::pair{ 3, 1 } && reporter->m_notRun == 1 ? 0 : 1);
+        }
+        int status = 0;
+        if (child < 0 || ::waitpid(child, &status, 0) != child || !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+        {
+            std::cerr << "Test failed at line " << __LINE__ << "\n";
+            return 1;
+        }
+    }
+#endif
+#endif
+    // suites are set up once, before their first test, and torn down once, after their last, and their tests are run
+    // together, on one thread and in one shard.  The run counts include PintTest::selfTest
+    {
+        static std::atomic<int> setUps = 0;
+        static std::atomic<int> tearDowns = 0;
+        static std::mutex orderMutex;
+        static std::vector<std::pair<std::string, std::thread::id>> order;
+        const auto record = [](const char* name)
+            {
+                return [name]
+                    {
+                        std::lock_guard lock(orderMutex);
+                        order.emplace_back(name, std::this_thread::get_id());
+                    };
+            };
+        const auto* suiteA = PintTest::registerSuite([] { ++setUps; }, [] { ++tearDowns; });
+        PintTest::registerTestFn("SuiteA.First", record("SuiteA.First"), suiteA);
+        PintTest::registerTestFn("SuiteLoner", record("SuiteLoner"));
+        PintTest::registerTestFn("SuiteA.Second", record("SuiteA.Second"), suiteA);
+        PintTest::registerTestFn("SuiteA.Third", record("SuiteA.Third"), suiteA);
+        for (const auto& vec :
+            {
+                std::vector<std::string_view>{"--filter=Suite"}
+                ,std::vector<std::string_view>{"--filter=Suite", "--jobs=3"}
+            })
+        {
+            setUps = tearDowns = 0;
+            order.clear();
+            const auto [ran, failed] = PintTest::runAllTests2(vec);
+            if (ran != 5 || failed != 0 || setUps != 1 || tearDowns != 1 || order.size() != 4)
+            {
+                std::cerr << "Test failed at line " << __LINE__ << "\n";
+                return 1;
+            }
+            std::vector<std::pair<std::string, std::thread::id>> suiteOrder;
+            std::copy_if(order.begin(), order.end(), std::back_inserter(suiteOrder), [](const auto& entry) { return entry.first != "SuiteLoner"; });
+            if (suiteOrder.size() != 3 || suiteOrder[0].first != "SuiteA.First" || suiteOrder[1].first != "SuiteA.Second" || suiteOrder[2].first != "SuiteA.Third"
+                || suiteOrder[0].second != suiteOrder[1].second || suiteOrder[1].second != suiteOrder[2].second)
+            {
+                std::cerr << "Test failed at line " << __LINE__ << "\n";
+                return 1;
+            }
+        }
+        setUps = tearDowns = 0;
+        const auto [ran0, failed0] = PintTest::runAllTests2({ "--filter=Suite", "--shard-index=0", "--total-shards=2" });
+        const auto [ran1, failed1] = PintTest::runAllTests2({ "--filter=Suite", "--shard-index=1", "--total-shards=2" });
+        if (ran0 + ran1 != 6 || (ran0 != 4 && ran1 != 4) || setUps != 1 || tearDowns != 1)
+        {
+            std::cerr << "Test failed at line " << __LINE__ << "\n";
+            return 1;
+        }
+#ifndef _WIN32
+        {
+            const auto [ran, failed] = PintTest::runAllTests2({ "--filter=Suite", "--isolate", "--jobs=2" });
+            if (ran != 5 || failed != 0)
+            {
+                std::cerr << "Test failed at line " << __LINE__ << "\n";
+                return 1;
+            }
+        }
+#endif
+
+        // a TEST_F is in its fixture's suite, and set up by the fixture
+        MacroFixture::s_setUps = 0;
+        if (PintTest::runAllTests2({ "--output=quiet", "--filter=MacroFixture" }) != std::pair{ 2, 0 } || MacroFixture::s_setUps != 1 ||
+            MacroFixture::s_shared)
+        {
+            std::cerr << "Test failed at line " << __LINE__ << "\n";
+            return 1;
+        }
+
+        // failures in SetUpSuite go against the suite's first test, and stop the suite's tests running, which all fail,
+        // and in TearDownSuite against its last
+        static int setUpFailedRuns = 0;
+        const auto* failingSetUp = PintTest::registerSuite([] { EXPECT_TRUE(false); }, [] {});
+        PintTest::registerTestFn("FailingSetUp.First", [] { ++setUpFailedRuns; }, failingSetUp);
+        PintTest::registerTestFn("FailingSetUp.Second", [] { ++setUpFailedRuns; }, failingSetUp);
+        const auto* failingTearDown = PintTest::registerSuite([] {}, [] { EXPECT_TRUE(false); });
+        PintTest::registerTestFn("FailingTearDown.First", [] {}, failingTearDown);
+        PintTest::registerTestFn("FailingTearDown.Second", [] {}, failingTearDown);
+        struct PassesReporter : PintTest::Reporter
+        {
+            std::vector<bool> m_passed;
+            void testFinished(const PintTest::TestResult& result) override { m_passed.push_back(result.passed()); }
+        };
+        for (const auto& [filter, passed] : { std::pair{ "--filter=FailingSetUp.", std::vector<bool>{ true, false, false } },
+            std::pair{ "--filter=FailingTearDown.", std::vector<bool>{ true, true, false } } })
+        {
+            const auto passes = std::make_shared<PassesReporter>();
+            PintTest::addReporter(passes);
+            const auto [ran, failed] = PintTest::runAllTests2(std::vector<std::string_view>{"--output=quiet", filter});
+            if (ran != 3 || failed != static_cast<int>(std::count(passed.begin(), passed.end(), false)) || passes->m_passed != passed || setUpFailedRuns != 0)
+            {
+                std::cerr << "Test failed at line " << __LINE__ << "\n";
+                return 1;
+            }
+        }
+    }
+    // checks made on the threads that a test starts are attributed to it, implicitly when it's the only test running,
+    // and otherwise through AttachToTest
+    {
+        const auto failOnThreads = [](bool attach)
+            {
+                std::vector<std::thread> threads;
+                for (int t = 0; t < 4; ++t)
+                {
+                    threads.emplace_back([attach, test = PintTest::currentTest(), t]
+                        {
+                            std::optional<PintTest::AttachToTest> attached;
+                            if (attach)
+                                attached.emplace(test);
+                            for (int i = 0; i < 100; ++i)
+                            {
+                                EXPECT_TRUE(true);
+                                EXPECT_NE(t, t) << "thread " << t;
+                            }
+                        });
+                }
+                for (auto& thread : threads)
+                    thread.join();
+            };
+        for (const bool attach : { false, true })
+        {
+            const auto result = PintTest::executeTest([&failOnThreads, attach] { failOnThreads(attach); }, "FailsOnThreads");
+            // only the first 10 failures of the check on each thread are reported, with the rest summarised
+            if (result.m_fails != 400 || result.m_failures.size() != 41 || result.m_failures[0].m_message.find("thread ") == std::string::npos ||
+                result.m_failures.back().m_message != "\nfailed 360 more times")
+            {
+                std::cerr << "Test failed at line " << __LINE__ << "\n";
+                return 1;
+            }
+        }
+        struct FailuresReporter : PintTest::Reporter
+        {
+            std::vector<size_t> m_failures;
+            void testFinished(const PintTest::TestResult& result) override { m_failures.push_back(result.m_failures.size()); }
+        };
+        PintTest::registerTestFn("ThreadsFailFirst", [&failOnThreads] { failOnThreads(true); });
+        PintTest::registerTestFn("ThreadsFailSecond", [&failOnThreads] { failOnThreads(true); });
+        const auto failures = std::make_shared<FailuresReporter>();
+        PintTest::addReporter(failures);
+        const auto [ran, failed] = PintTest::runAllTests2(std::vector<std::string_view>{"--output=quiet", "--filter=ThreadsFail", "--jobs=2"});
+        if (ran != 3 || failed != 800 || failures->m_failures != std::vector<size_t>{ 0, 41, 41 })
+        {
+            std::cerr << "Test failed at line " << __LINE__ << "\n";
+            return 1;
+        }
+
+        // with --jobs a failure on a thread that isn't attached is the run's, rather than every running test's
+        struct FailsReporter : PintTest::Reporter
+        {
+            std::map<std::string, int> m_fails;
+            void testFinished(const PintTest::TestResult& result) override { m_fails[result.m_name] = result.m_fails; }
+        };
+        PintTest::registerTestFn("UnattachedFails", []
+            {
+                std::this_thread::sleep_for(std::chrono::milliseconds(20));
+                std::thread([] { EXPECT_TRUE(false); }).join();
+                std::this_thread::sleep_for(std::chrono::milliseconds(20));
+            });
+        PintTest::registerTestFn("UnattachedBystander", [] { std::this_thread::sleep_for(std::chrono::milliseconds(60)); });
+        const auto fails = std::make_shared<FailsReporter>();
+        PintTest::addReporter(fails);
+        const auto [unattachedRan, unattachedFailed] = PintTest::runAllTests2({ "--output=quiet", "--filter=Unattached", "--jobs=2" });
+        if (unattachedRan != 4 || unattachedFailed != 1 || fails->m_fails != std::map<std::string, int>{ { "PintTest::selfTest", 0 },
+            { "PintTest::unattributed", 1 }, { "UnattachedBystander", 0 }, { "UnattachedFails", 0 } })
+        {
+            std::cerr << "Test failed at line " << __LINE__ << "\n";
+            return 1;
+        }
+    }
+    // a check failing in a hot loop reports its first failures in full and counts the rest, and --max-failures stops
+    // the test
+    {
+        const auto failInLoop = []
+            {
+                for (int i = 0; i < 1'000'000; ++i)
+                {
+                    EXPECT_EQ(i, -1) << "iteration " << i;
+                    EXPECT_TRUE(i < 1'000'000);
+                }
+            };
+        const auto start = std::chrono::steady_clock::now();
+        const auto result = PintTest::executeTest(failInLoop, "FailsInLoop");
+        if (result.m_fails != 1'000'000 || result.m_failures.size() != 11 || result.m_failures[9].m_message.find("iteration 9") == std::string::npos ||
+            result.m_failures[10].m_line != result.m_failures[0].m_line || result.m_failures[10].m_message != "\nfailed 999,990 more times" ||
+            std::chrono::steady_clock::now() - start > std::chrono::seconds(5))
+        {
+            std::cerr << "Test failed at line " << __LINE__ << "\n";
+            return 1;
+        }
+        struct FailuresReporter : PintTest::Reporter
+        {
+            std::vector<PintTest::TestResult> m_results;
+            void testFinished(const PintTest::TestResult& result) override { m_results.push_back(result); }
+        };
+        PintTest::registerTestFn("FailsInLoop", failInLoop);
+        const auto unlimited = std::make_shared<FailuresReporter>();
+        PintTest::addReporter(unlimited);
+        const auto [ran, failed] = PintTest::runAllTests2(std::vector<std::string_view>{"--output=quiet", "--filter=FailsInLoop", "--failures-per-site=0", "--max-failures=25"});
+        // the check that reaches the limit is reported in full, before the test is stopped
+        if (ran != 2 || failed != 25 || unlimited->m_results.size() != 2 || unlimited->m_results[1].m_failures.size() != 26 ||
+            unlimited->m_results[1].m_failures[24].m_message.find("iteration 24") == std::string::npos ||
+            unlimited->m_results[1].m_failures.back().m_message != "\nthe test was stopped after 25 failed checks")
+        {
+            std::cerr << "Test failed at line " << __LINE__ << "\n";
+            return 1;
+        }
+        if (PintTest::runAllTests2(std::vector<std::string_view>{"--output=quiet", "--max-failures=lots"}) != std::pair{ -1, 13 })
+        {
+            std::cerr << "Test failed at line " << __LINE__ << "\n";
+            return 1;
+        }
+        // a fixture is still torn down when its test is stopped
+        struct StoppedTest : CountedFixture
+        {
+            void TestBody()
+            {
+                for (int i = 0; i < 3; ++i)
+                    EXPECT_TRUE(false);
+            }
+        };
+        static const PintTest::TestNode stoppedNode("StoppedFixture.Test", +[] { StoppedTest test; PintTest::runFixtureTest(test); });
+        CountedFixture::s_tearDowns = 0;
+        if (PintTest::runAllTests2(std::vector<std::string_view>{"--output=quiet", "--filter=StoppedFixture", "--max-failures=2"}) != std::pair{ 2, 2 } ||
+            CountedFixture::s_tearDowns != 1)
+        {
+            std::cerr << "Test failed at line " << __LINE__ << "\n";
+            return 1;
+        }
+        // and when its SetUp fails, the body isn't run, but it's still torn down
+        struct FailedSetUpTest : CountedFixture
+        {
+            void SetUp() { ASSERT_TRUE(false); }
+            void TestBody() { EXPECT_TRUE(false); }
+        };
+        CountedFixture::s_tearDowns = 0;
+        const auto failedSetUp = PintTest::executeTest([] { FailedSetUpTest test; PintTest::runFixtureTest(test); }, "FailedSetUp");
+        if (failedSetUp.m_fails != 1 || failedSetUp.m_failures.size() != 1 || CountedFixture::s_tearDowns != 1)
+        {
+            std::cerr << "Test failed at line " << __LINE__ << "\n";
+            return 1;
+        }
+    }
+    // stress runs release their threads together, and count their checks and operations against the test
+    {
+        std::atomic<uint64_t> calls = 0;
+        const auto result = PintTest::executeTest([&calls]
+            {
+                PintTest::stress(3, uint64_t(1000), [&calls](unsigned)
+                    {
+                        EXPECT_NE(0u, ++calls % 500);
+                    });
+                const auto timed = PintTest::stress(2, std::chrono::milliseconds(20), [](unsigned thread) { PintTest::DoNotOptimize(thread); });
+                EXPECT_GE(timed.m_elapsed, std::chrono::milliseconds(20));
+                EXPECT_EQ(2u, timed.m_threads.size());
+            }, "Stress");
+        if (calls != 3000 || result.m_fails != 6 || result.m_stress.size() != 2 || result.m_stress[0].operations() != 3000
+            || result.m_stress[0].m_threads.size() != 3 || result.m_stress[0].m_threads[2].m_operations != 1000
+            || result.m_stress[1].operations() == 0)
+        {
+            std::cerr << "Test failed at line " << __LINE__ << "\n";
+            return 1;
+        }
+#ifndef _WIN32
+        // through a worker process, to check the results get back from it
+        PintTest::registerTestFn("StressedInWorker", [] { PintTest::stress(2, uint64_t(100), [](unsigned) {}); });
+        const auto json = (std::filesystem::temp_directory_path() / "PintTestStress.json").string();
+        const auto output = "--output=json:" + json;
+        const auto [ran, failed] = PintTest::runAllTests2(std::vector<std::string_view>{"--filter=StressedInWorker", "--isolate", output});
+        std::ifstream file(json);
+        const std::string text((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+        if (ran != 2 || failed != 0 || text.find("\"stress\": [{ \"operations\": 200,") == std::string::npos)
+        {
+            std::cerr << "Test failed at line " << __LINE__ << "\n";
+            return 1;
+        }
+        file.close();
+        std::filesystem::remove(json);
+#endif
+    }
+    // latency percentiles are within the precision of their bucket, and the checks report the recorder with the test
+    {
+        PintTest::LatencyRecorder latencies;
+        for (uint64_t ns = 1; ns <= 1000; ++ns)
+            latencies.record(ns);
+        PintTest::LatencyRecorder slow("slow");
+        slow.record(std::chrono::seconds(1));
+        slow.record(std::chrono::nanoseconds(-5));
+        const auto p50 = latencies.percentile(50).count();
+        const auto slowMax = slow.percentile(100).count();
+        if (latencies.count() != 1000 || latencies.min().count() != 1 || latencies.max().count() != 1000 || latencies.mean().count() != 500
+            || p50 < 500 || p50 > 504 || latencies.percentile(10).count() != 100 || latencies.percentile(100).count() != 1000
+            || slowMax != 1000000000 || slow.percentile(50).count() != 0 || slow.percentile(51).count() < 1000000000 - 1000000000 / 128)
+        {
+            std::cerr << "Test failed at line " << __LINE__ << "\n";
+            return 1;
+        }
+        latencies.merge(slow);
+        if (latencies.count() != 1002 || latencies.max().count() != 1000000000 || latencies.min().count() != 0)
+        {
+            std::cerr << "Test failed at line " << __LINE__ << "\n";
+            return 1;
+        }
+        const auto result = PintTest::executeTest([&latencies, &slow]
+            {
+                EXPECT_P99_LT(latencies, std::chrono::microseconds(2));
+                EXPECT_MAX_LT(latencies, std::chrono::seconds(2));
+                EXPECT_MAX_LT(latencies, std::chrono::milliseconds(1));
+                EXPECT_PERCENTILE_LT(slow, 51.0, std::chrono::nanoseconds(1));
+            }, "Latencies");
+        if (result.m_fails != 2 || result.m_latencies.size() != 2 || result.m_latencies[0].m_name != "latencies" || result.m_latencies[1].m_name != "slow"
+            || result.m_latencies[0].m_values[PintTest::LatencySummary::MAX].count() != 1000000000
+            || result.m_failures[0].m_message.find("latencies max < std::chrono::milliseconds(1)\nExpected: < 1000000ns\nActual: 1000000000ns (max of 1002 samples)") == std::string::npos
+            || result.m_failures[1].m_message.find("slow p51 < std::chrono::nanoseconds(1)\nExpected: < 1ns\nActual: 1000000000ns (p51 of 2 samples)") == std::string::npos)
+        {
+            std::cerr << "Test failed at line " << __LINE__ << "\n";
+            return 1;
+        }
+#ifndef _WIN32
+        PintTest::registerTestFn("LatencyInWorker", []
+            {
+                PintTest::LatencyRecorder worker("worker");
+                for (int i = 0; i < 3; ++i)
+                    worker.record(std::chrono::nanoseconds(10));
+                worker.report();
+            });
+        const auto json = (std::filesystem::temp_directory_path() / "PintTestLatency.json").string();
+        const auto output = "--output=json:" + json;
+        const auto [ran, failed] = PintTest::runAllTests2(std::vector<std::string_view>{"--filter=LatencyInWorker", "--isolate", output});
+        std::ifstream file(json);
+        const std::string text((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+        if (ran != 2 || failed != 0 || text.find("\"latencies\": [{ \"name\": \"worker\", \"count\": 3, \"min_ns\": 10,") == std::string::npos)
+        {
+            std::cerr << "Test failed at line " << __LINE__ << "\n";
+            return 1;
+        }
+        file.close();
+        std::filesystem::remove(json);
+#endif
+    }
+    // a test or benchmark fails against the baseline only when it's slower by more than the threshold, significantly
+    {
+        const auto baseline = (std::filesystem::temp_directory_path() / "PintTestBaseline.txt").string();
+        std::filesystem::remove(baseline);
+        const auto save = "--save-baseline=" + baseline;
+        const auto compare = "--compare-baseline=" + baseline;
+        static std::chrono::microseconds sleepFor{ 1000 };
+        static int spins = 1000;
+        PintTest::registerTestFn("BaselineSubject", [] { std::this_thread::sleep_for(sleepFor); });
+        PintTest::registerBenchmarkFn("BaselineBenchmark", [](PintTest::BenchmarkState& state)
+            {
+                while (state.keepRunning())
+                    for (int i = 0; i < spins; ++i)
+                        PintTest::DoNotOptimize(i);
+            });
+        const auto [noBaseline, noBaselineError] = PintTest::runAllTests2(std::vector<std::string_view>{"--filter=BaselineSubject", compare});
+        const auto [badThreshold, badThresholdError] = PintTest::runAllTests2({ "--regression-threshold=fast" });
+        if (noBaseline != -1 || noBaselineError != 12 || badThreshold != -1 || badThresholdError != 12)
+        {
+            std::cerr << "Test failed at line " << __LINE__ << "\n";
+            return 1;
+        }
+        // a test has a sample per run, so the baseline is built up over several
+        for (int run = 0; run < 25; ++run)
+        {
+            const auto [ran, failed] = PintTest::runAllTests2(std::vector<std::string_view>{"--output=quiet", "--filter=BaselineSubject", save});
+            if (ran != 2 || failed != 0)
+            {
+                std::cerr << "Test failed at line " << __LINE__ << "\n";
+                return 1;
+            }
+        }
+        {
+            std::ifstream file(baseline);
+            std::string line;
+            std::getline(file, line);
+            if (!line.starts_with("test\tBaselineSubject\t") || std::count(line.begin(), line.end(), ' ') != 19)
+            {
+                std::cerr << "Test failed at line " << __LINE__ << "\n";
+                return 1;
+            }
+        }
+        sleepFor = std::chrono::microseconds(0);
+        const auto [fasterRan, fasterFailed] = PintTest::runAllTests2(std::vector<std::string_view>{"--output=quiet", "--filter=BaselineSubject", compare});
+        sleepFor = std::chrono::microseconds(20000);
+        const auto [slowerRan, slowerFailed] = PintTest::runAllTests2(std::vector<std::string_view>{"--output=quiet", "--filter=BaselineSubject", compare});
+        const auto [thresholdRan, thresholdFailed] = PintTest::runAllTests2(std::vector<std::string_view>{"--output=quiet", "--filter=BaselineSubject", compare, "--regression-threshold=100000"});
+        if (fasterRan != 3 || fasterFailed != 0 || slowerRan != 3 || slowerFailed != 1 || thresholdRan != 3 || thresholdFailed != 0)
+        {
+            std::cerr << "Test failed at line " << __LINE__ << "\n";
+            return 1;
+        }
+
+        // a single sample slower than all of a baseline of 19 has p = 0.05, which isn't significant, and of 20 it is
+        for (const int samples : { 19, 20 })
+        {
+            {
+                std::ofstream file(baseline);
+                file << "test\tBaselineSubject\t1";
+                for (int i = 1; i < samples; ++i)
+                    file << " 1";
+                file << '\n';
+            }
+            const auto [boundaryRan, boundaryFailed] = PintTest::runAllTests2(std::vector<std::string_view>{"--output=quiet", "--filter=BaselineSubject", compare});
+            if (boundaryRan != 3 || boundaryFailed != (samples == 20 ? 1 : 0))
+            {
+                std::cerr << "Test failed at line " << __LINE__ << "\n";
+                return 1;
+            }
+        }
+        std::filesystem::remove(baseline);
+
+        // benchmarks have many samples a run, so one run of each is enough
+        const auto [benchmarkRan, benchmarkFailed] = PintTest::runAllTests2(std::vector<std::string_view>{"--output=quiet", "--filter=BaselineBenchmark", "--benchmark", save});
+        spins = 10000;
+        const auto [slowerBenchmarkRan, slowerBenchmarkFailed] = PintTest::runAllTests2(std::vector<std::string_view>{"--output=quiet", "--filter=BaselineBenchmark", "--benchmark", compare});
+        if (benchmarkRan != 1 || benchmarkFailed != 0 || slowerBenchmarkRan != 2 || slowerBenchmarkFailed != 1)
+        {
+            std::cerr << "Test failed at line " << __LINE__ << "\n";
+            return 1;
+        }
+        std::filesystem::remove(baseline);
+    }
+    // files and snapshots are compared byte for byte, reporting the first difference in hex, and --update-snapshots
+    // writes them instead
+    {
+        const auto directory = std::filesystem::temp_directory_path() / "PintTestSnapshots";
+        std::filesystem::remove_all(directory);
+        std::filesystem::create_directories(directory);
+        const auto expectedFile = directory / "expected.bin";
+        const auto actualFile = directory / "actual.bin";
+        std::string bytes(10000, '\0');
+        for (size_t i = 0; i < bytes.size(); ++i)
+            bytes[i] = static_cast<char>(i * 7);
+        const auto write = [](const std::filesystem::path& path, const std::string& contents)
+            {
+                std::ofstream(path, std::ios::binary) << contents;
+            };
+        write(expectedFile, bytes);
+        write(actualFile, bytes);
+        const auto same = PintTest::executeTest([&] { EXPECT_FILE_EQ(expectedFile, actualFile); }, "FilesSame");
+        bytes[5000] = 'x';
+        write(actualFile, bytes);
+        const auto different = PintTest::executeTest([&] { EXPECT_FILE_EQ(expectedFile, actualFile); }, "FilesDifferent");
+        const auto missing = PintTest::executeTest([&] { ASSERT_FILE_EQ(directory / "missing.bin", actualFile); }, "FileMissing");
+        if (!same.passed() || different.m_fails != 1 || different.m_failures[0].m_message.find("First difference at offset 5000 (0x1388)") == std::string::npos ||
+            different.m_failures[0].m_message.find("* 00001380  80 87 8e 95 9c a3 aa b1 78 bf") == std::string::npos ||
+            missing.m_fails != 1 || missing.m_failures[0].m_message.find("doesn't exist") == std::string::npos)
+        {
+            std::cerr << "Test failed at line " << __LINE__ << "\n";
+            return 1;
+        }
+
+        std::vector<uint32_t> values{ 1, 2, 3 };
+        PintTest::registerTestFn("SnapshotOfValues", [&values] { EXPECT_SNAPSHOT("values.bin", values); });
+        const auto snapshotDir = "--snapshot-dir=" + directory.string();
+        const auto run = [&snapshotDir](bool update)
+            {
+                std::vector<std::string_view> args{ "--output=quiet", "--filter=SnapshotOfValues", snapshotDir };
+                if (update)
+                    args.emplace_back("--update-snapshots");
+                return PintTest::runAllTests2(args);
+            };
+        const auto beforeWritten = run(false);
+        const auto written = run(true);
+        const auto unchanged = run(false);
+        values[1] = 5;
+        const auto changed = run(false);
+        if (beforeWritten != std::pair{ 2, 1 } || written != std::pair{ 2, 0 } || unchanged != std::pair{ 2, 0 } || changed != std::pair{ 2, 1 } ||
+            std::filesystem::file_size(directory / "values.bin") != 3 * sizeof(uint32_t))
+        {
+            std::cerr << "Test failed at line " << __LINE__ << "\n";
+            return 1;
+        }
+        std::filesystem::remove_all(directory);
+    }
+    // --shuffle orders the tests by the seed, each iteration of --repeat= with the next seed, and --until-fail stops at
+    // the first iteration that fails, reporting which it was
+    {
+        struct OrderReporter : PintTest::Reporter
+        {
+            std::vector<std::string> m_order;
+            std::vector<PintTest::RunSummary> m_summaries;
+            void testStarting(const std::string& name) override { m_order.push_back(name); }
+            void runFinished(const PintTest::RunSummary& summary) override { m_summaries.push_back(summary); }
+        };
+        for (const auto* name : { "ShuffledA", "ShuffledB", "ShuffledC", "ShuffledD", "ShuffledE", "ShuffledF" })
+            PintTest::registerTestFn(name, [] {});
+        const auto order = std::make_shared<OrderReporter>();
+        PintTest::addReporter(order);
+        const auto [ran, failed] = PintTest::runAllTests2({ "--output=quiet", "--filter=Shuffled", "--shuffle", "--seed=42", "--repeat=3" });
+        const auto repeated = order->m_order;
+        order->m_order.clear();
+        PintTest::runAllTests2({ "--output=quiet", "--filter=Shuffled", "--shuffle", "--seed=43" });
+        const auto second = std::vector<std::string>(repeated.begin() + 7, repeated.begin() + 13);
+        if (ran != 19 || failed != 0 || repeated.size() != 19 || std::vector<std::string>(order->m_order.begin() + 1, order->m_order.end()) != second ||
+            std::equal(second.begin(), second.end(), repeated.begin() + 1) || order->m_summaries[0].m_iterations != 3 || order->m_summaries[0].m_seed != 42u)
+        {
+            std::cerr << "Test failed at line " << __LINE__ << "\n";
+            return 1;
+        }
+
+        static std::atomic<int> calls = 0;
+        PintTest::registerTestFn("FailsEveryFifth", [] { EXPECT_NE(++calls % 5, 0); });
+        order->m_summaries.clear();
+        const auto [ranUntil, failedUntil] = PintTest::runAllTests2({ "--output=quiet", "--filter=FailsEveryFifth", "--until-fail" });
+        calls = 0;
+        const auto [ranJobs, failedJobs] = PintTest::runAllTests2({ "--output=quiet", "--filter=FailsEveryFifth", "--repeat=12", "--jobs=3" });
+        if (ranUntil != 6 || failedUntil != 1 || order->m_summaries[0].m_iterations != 5 ||
+            order->m_summaries[0].m_failedIterations != std::vector<std::pair<unsigned, uint64_t>>{ { 5, 0 } } ||
+            ranJobs != 13 || failedJobs != 2 || calls != 12 || order->m_summaries[1].m_failedIterations.size() != 2)
+        {
+            std::cerr << "Test failed at line " << __LINE__ << "\n";
+            return 1;
+        }
+
+        // --until-fail keeps only the results of the iteration that failed, but the summary still covers them all
+        calls = 0;
+        order->m_summaries.clear();
+        const auto untilResults = (std::filesystem::temp_directory_path() / "PintTestUntilFail.txt").string();
+        const auto untilResultsArg = "--results-file=" + untilResults;
+        PintTest::runAllTests2({ "--output=quiet", "--filter=FailsEveryFifth", "--until-fail", "--slowest=10", untilResultsArg });
+        std::ifstream untilFile(untilResults);
+        std::vector<std::string> untilLines;
+        for (std::string line; std::getline(untilFile, line);)
+            untilLines.push_back(line);
+        untilFile.close();
+        std::filesystem::remove(untilResults);
+        if (untilLines.size() != 2 || !untilLines[1].starts_with("FAILED") || order->m_summaries[0].m_slowest.size() != 5)
+        {
+            std::cerr << "Test failed at line " << __LINE__ << "\n";
+            return 1;
+        }
+
+        // each iteration sets a suite up and tears it down again, and no two iterations run it at once
+        static std::atomic<int> setUps = 0;
+        static std::atomic<int> tearDowns = 0;
+        static std::atomic<int> inSuite = 0;
+        static std::atomic<bool> overlapped = false;
+        const auto* suite = PintTest::registerSuite([] { ++setUps; overlapped = overlapped || ++inSuite != 1; }, [] { --inSuite; ++tearDowns; });
+        PintTest::registerTestFn("RepeatedSuite.First", [] { std::this_thread::sleep_for(std::chrono::milliseconds(1)); }, suite);
+        PintTest::registerTestFn("RepeatedSuite.Second", [] {}, suite);
+        const auto [ranSuite, failedSuite] = PintTest::runAllTests2({ "--output=quiet", "--filter=RepeatedSuite", "--repeat=4", "--jobs=2", "--shuffle" });
+        if (ranSuite != 9 || failedSuite != 0 || setUps != 4 || tearDowns != 4 || overlapped)
+        {
+            std::cerr << "Test failed at line " << __LINE__ << "\n";
+            return 1;
+        }
+        if (PintTest::runAllTests2({ "--repeat=0" }) != std::pair{ -1, 14 } || PintTest::runAllTests2({ "--seed=x" }) != std::pair{ -1, 14 })
+        {
+            std::cerr << "Test failed at line " << __LINE__ << "\n";
+            return 1;
+        }
+    }
+    // a property is checked with --property-cases cases, and the first that fails is shrunk to the smallest case that
+    // still fails, which is reported with the seed, and is the same on any number of threads
+    {
+        using Gen = PintTest::Gen;
+        static std::atomic<int> cases = 0;
+        static std::atomic<bool> outOfRange = false;
+        PintTest::registerProperty("PropertyInRange", [](int i, const std::string& s, const std::vector<double>& v)
+            {
+                ++cases;
+                outOfRange = outOfRange || i < -5 || i > 5 || v.size() > 3 ||
+                    std::any_of(s.begin(), s.end(), [](char c) { return c < ' ' || c > '~'; }) ||
+                    std::any_of(v.begin(), v.end(), [](double d) { return d < 1.0 || d > 2.0; });
+            }, Gen::integers(-5, 5), Gen::strings(), Gen::vectors(Gen::reals(1.0, 2.0), 3));
+        const auto [ranInRange, failedInRange] = PintTest::runAllTests2({ "--output=quiet", "--filter=PropertyInRange", "--property-cases=5000" });
+        if (ranInRange != 2 || failedInRange != 0 || cases != 5000 || outOfRange)
+        {
+            std::cerr << "Test failed at line " << __LINE__ << "\n";
+            return 1;
+        }
+
+        struct FailuresReporter : PintTest::Reporter
+        {
+            std::vector<PintTest::TestResult> m_results;
+            int m_fails = 0;
+            void testFinished(const PintTest::TestResult& result) override { m_results.push_back(result); }
+            void runFinished(const PintTest::RunSummary& summary) override { m_fails = summary.m_fails; }
+        };
+        PintTest::registerProperty("PropertySumBelow100", [](const std::vector<int>& v)
+            {
+                EXPECT_LT(std::accumulate(v.begin(), v.end(), 0), 100);
+            }, Gen::vectors(Gen::integers(0, 1000)));
+        PintTest::registerProperty("PropertyHasNoX", [](const std::string& s) { EXPECT_EQ(s.find('x'), std::string::npos); }, Gen::strings());
+        const auto run = [](const char* jobs)
+            {
+                const auto reporter = std::make_shared<FailuresReporter>();
+                PintTest::addReporter(reporter);
+                const auto ranAndFailed = PintTest::runAllTests2({ "--output=quiet", "--filter=PropertySumBelow100", "--filter=PropertyHasNoX", "--seed=7", jobs });
+                return std::pair{ ranAndFailed, reporter };
+            };
+        const auto [ranAndFailed, reporter] = run("--property-jobs=1");
+        const auto& results = reporter->m_results;
+        if (ranAndFailed != std::pair{ 3, 2 } || reporter->m_fails != 2 || results.size() != 3 ||
+            results[1].m_fails != 1 || results[1].m_failures.size() != 2 || results[2].m_fails != 1 ||
+            results[1].m_failures[0].m_message.find("(with --seed=7)") == std::string::npos ||
+            !results[1].m_failures[0].m_message.ends_with("arguments:\n    {100}\n") ||
+            !results[2].m_failures[0].m_message.ends_with("arguments:\n    \"x\"\n"))
+        {
+            std::cerr << "Test failed at line " << __LINE__ << "\n";
+            return 1;
+        }
+        const auto [ranAndFailedJobs, reporterJobs] = run("--property-jobs=3");
+        if (ranAndFailedJobs != ranAndFailed || reporterJobs->m_results[1].m_failures[0].m_message != results[1].m_failures[0].m_message ||
+            reporterJobs->m_results[2].m_failures[0].m_message != results[2].m_failures[0].m_message)
+        {
+            std::cerr << "Test failed at line " << __LINE__ << "\n";
+            return 1;
+        }
+        // a PROPERTY is checked with --property-cases= cases, as registerProperty's are
+        sortIgnoresRotationCases = 0;
+        if (PintTest::runAllTests2({ "--output=quiet", "--filter=SortIgnoresRotation", "--property-cases=50" }) != std::pair{ 2, 0 } ||
+            sortIgnoresRotationCases != 50)
+        {
+            std::cerr << "Test failed at line " << __LINE__ << "\n";
+            return 1;
+        }
+        // each iteration of --repeat checks new cases, from the seed plus the iteration, which --seed= alone makes again
+        static std::set<int> repeatedCases;
+        static std::mutex repeatedMutex;
+        PintTest::registerProperty("PropertyRepeated", [](int i) { std::lock_guard lock(repeatedMutex); repeatedCases.insert(i); }, Gen::integers<int>());
+        for (const std::string_view jobs : { "--jobs=1", "--jobs=2" })
+        {
+            repeatedCases.clear();
+            if (PintTest::runAllTests2({ "--output=quiet", "--filter=PropertyRepeated", "--property-cases=100", "--repeat=3", jobs }) != std::pair{ 4, 0 } ||
+                repeatedCases.size() < 250)
+            {
+                std::cerr << "Test failed at line " << __LINE__ << "\n";
+                return 1;
+            }
+        }
+        const auto repeatedReporter = std::make_shared<FailuresReporter>();
+        PintTest::addReporter(repeatedReporter);
+        PintTest::runAllTests2({ "--output=quiet", "--filter=PropertyHasNoX", "--seed=7", "--repeat=2" });
+        const auto repeated = repeatedReporter->m_results;
+        const auto secondReporter = std::make_shared<FailuresReporter>();
+        PintTest::addReporter(secondReporter);
+        PintTest::runAllTests2({ "--output=quiet", "--filter=PropertyHasNoX", "--seed=8" });
+        if (repeated.size() != 3 || secondReporter->m_results.size() != 2 ||
+            repeated[1].m_failures[0].m_message.find("(with --seed=7)") == std::string::npos ||
+            repeated[2].m_failures[0].m_message.find("(with --seed=8)") == std::string::npos ||
+            secondReporter->m_results[1].m_failures[0].m_message != repeated[2].m_failures[0].m_message)
+        {
+            std::cerr << "Test failed at line " << __LINE__ << "\n";
+            return 1;
+        }
+        if (PintTest::runAllTests2({ "--property-cases=0" }) != std::pair{ -1, 15 } || PintTest::runAllTests2({ "--property-jobs=x" }) != std::pair{ -1, 15 })
+        {
+            std::cerr << "Test failed at line " << __LINE__ << "\n";
+            return 1;
+        }
+    }
+    // the checks that fail in a trial are counted, but don't fail the test it's run in
+    {
+        static const PintTest::TestNode trialTest("TrialFailsTwice", []
+            {
+                EXPECT_EQ(PintTest::runTrial([] { EXPECT_EQ(1, 2); EXPECT_EQ(1, 1); EXPECT_TRUE(false); }), 2);
+                EXPECT_EQ(PintTest::runTrial([] {}), 0);
+            });
+        if (PintTest::runAllTests2({ "--output=quiet", "--filter=TrialFailsTwice" }) != std::pair{ 2, 0 })
+        {
+            std::cerr << "Test failed at line " << __LINE__ << "\n";
+            return 1;
+        }
+    }
+    // async tests are run together on one event loop, so that while one sleeps the others run, and each is reported as
+    // the test its checks were made in.  Run on its own an async test gets a loop of its own
+    {
+        using namespace std::chrono_literals;
+        static auto sleeps = []() -> PintTest::Task
+            {
+                for (int i = 0; i < 5; ++i)
+                    co_await PintTest::sleepFor(20ms);
+                EXPECT_TRUE(true);
+            };
+        static auto failsLater = []() -> PintTest::Task
+            {
+                co_await PintTest::sleepFor(10ms);
+                CO_ASSERT_EQ(1, 2);
+                EXPECT_TRUE(false);
+            };
+        static auto throws = []() -> PintTest::Task
+            {
+                co_await PintTest::sleepFor(1ms);
+                throw std::runtime_error("async");
+            };
+        static std::deque<std::string> names;
+        static std::deque<PintTest::TestNode> nodes;
+        for (int i = 0; i < 50; ++i)
+            nodes.emplace_back(names.emplace_back("AsyncSleeps" + std::to_string(i)).c_str(), +[] { PintTest::runTask(+sleeps); }, +sleeps);
+        static const PintTest::TestNode failsLaterNode("AsyncFailsLater", +[] { PintTest::runTask(+failsLater); }, +failsLater);
+        static const PintTest::TestNode throwsNode("AsyncThrows", +[] { PintTest::runTask(+throws); }, +throws);
+
+        const auto start = std::chrono::steady_clock::now();
+        const auto [ranSleeps, failedSleeps] = PintTest::runAllTests2({ "--output=quiet", "--filter=AsyncSleeps" });
+        // 50 tests sleeping for 100ms each would take 5s one after another
+        if (ranSleeps != 51 || failedSleeps != 0 || std::chrono::steady_clock::now() - start > 2s)
+        {
+            std::cerr << "Test failed at line " << __LINE__ << "\n";
+            return 1;
+        }
+
+        struct AsyncReporter : PintTest::Reporter
+        {
+            std::vector<PintTest::TestResult> m_results;
+            void testFinished(const PintTest::TestResult& result) override { m_results.push_back(result); }
+        };
+        const auto reporter = std::make_shared<AsyncReporter>();
+        PintTest::addReporter(reporter);
+        const auto [ranAsync, failedAsync] = PintTest::runAllTests2({ "--output=quiet", "--filter=AsyncSleeps4", "--filter=AsyncFailsLater", "--filter=AsyncThrows" });
+        const auto result = [&reporter](std::string_view name)
+            {
+                const auto found = std::find_if(reporter->m_results.begin(), reporter->m_results.end(), [name](const auto& r) { return r.m_name == name; });
+                return found == reporter->m_results.end() ? PintTest::TestResult{} : *found;
+            };
+        if (ranAsync != 14 || failedAsync != 2 || result("AsyncFailsLater").m_fails != 1 || result("AsyncThrows").m_fails != 1 ||
+            result("AsyncThrows").m_failures.empty() || result("AsyncThrows").m_failures[0].m_message != "\nthe test threw async\n" ||
+            result("AsyncSleeps4").m_fails != 0 || result("AsyncSleeps49").m_fails != 0)
+        {
+            std::cerr << "Test failed at line " << __LINE__ << "\n";
+            return 1;
+        }
+        if (PintTest::executeTest(failsLaterNode).m_fails != 1 || PintTest::executeTest(nodes.front()).m_fails != 0 ||
+            PintTest::runAllTests2({ "--output=quiet", "--filter=AsyncFailsLater", "--jobs=2" }) != std::pair{ 2, 1 })
+        {
+            std::cerr << "Test failed at line " << __LINE__ << "\n";
+            return 1;
+        }
+        // TEST_ASYNC registers the same, with the body a coroutine
+        asyncMacroRuns = 0;
+        if (PintTest::runAllTests2({ "--output=quiet", "--filter=SleepsAsync" }) != std::pair{ 2, 0 } || asyncMacroRuns != 1 ||
+            result("SleepsAsync").m_fails != 0)
+        {
+            std::cerr << "Test failed at line " << __LINE__ << "\n";
+            return 1;
+        }
+#ifdef __linux__
+        // a reader waiting on a pipe is woken by a writer in another test
+        static int pipeFds[2] = { -1, -1 };
+        static auto reader = []() -> PintTest::Task
+            {
+                co_await PintTest::readable(pipeFds[0]);
+                char c = 0;
+                CO_ASSERT_EQ(::read(pipeFds[0], &c, 1), 1);
+                EXPECT_EQ(c, 'p');
+            };
+        static auto writer = []() -> PintTest::Task
+            {
+                co_await PintTest::sleepFor(10ms);
+                co_await PintTest::writable(pipeFds[1]);
+                EXPECT_EQ(::write(pipeFds[1], "p", 1), 1);
+            };
+        static const PintTest::TestNode readerNode("AsyncPipeReader", +[] { PintTest::runTask(+reader); }, +reader);
+        static const PintTest::TestNode writerNode("AsyncPipeWriter", +[] { PintTest::runTask(+writer); }, +writer);
+        if (::pipe(pipeFds) != 0 || PintTest::runAllTests2({ "--output=quiet", "--filter=AsyncPipe" }) != std::pair{ 3, 0 } ||
+            result("AsyncPipeReader").m_fails != 0 || result("AsyncPipeWriter").m_fails != 0)
+        {
+            std::cerr << "Test failed at line " << __LINE__ << "\n";
+            return 1;
+        }
+        ::close(pipeFds[0]);
+        ::close(pipeFds[1]);
+#endif
+    }
+#ifdef __linux__
+    // --serve keeps a process, with its tests registered, for runs requested by --connect, which get the daemon's output
+    // and results
+    {
+        using namespace std::chrono_literals;
+        const auto socketPath = (std::filesystem::temp_directory_path() / ("PintTestServe" + std::to_string(::getpid()))).string();
+        const auto serveArg = "--serve=" + socketPath;
+        const auto connectArg = "--connect=" + socketPath;
+        const pid_t daemon = ::fork();
+        if (daemon == 0)
+            ::_exit(PintTest::runAllTests2({ serveArg }).first);
+        for (int wait = 0; wait < 500 && !std::filesystem::exists(socketPath); ++wait)
+            std::this_thread::sleep_for(10ms);
+        const auto start = std::chrono::steady_clock::now();
+        for (int run = 0; run < 20; ++run)
+        {
+            if (PintTest::runAllTests2({ connectArg, "--output=quiet", "--filter=times2" }) != std::pair{ 3, 0 })
+            {
+                std::cerr << "Test failed at line " << __LINE__ << "\n";
+                return 1;
+            }
+        }
+        if (std::chrono::steady_clock::now() - start > 2s || PintTest::runAllTests2({ connectArg, "--output=quiet", "--filter=ThisAlwaysFails" }) != std::pair{ 2, 1 } ||
+            PintTest::runAllTests2({ connectArg, "--property-cases=0" }) != std::pair{ -1, 15 } ||
+            PintTest::runAllTests2({ connectArg, "--load=libtests.so" }) != std::pair{ -1, 16 })
+        {
+            std::cerr << "Test failed at line " << __LINE__ << "\n";
+            return 1;
+        }
+        // a client that stalls part way through its request is dropped, rather than holding up the next
+        {
+            sockaddr_un address{};
+            address.sun_family = AF_UNIX;
+            std::memcpy(address.sun_path, socketPath.c_str(), socketPath.size());
+            const int stalled = ::socket(AF_UNIX, SOCK_STREAM, 0);
+            const auto stalledAt = std::chrono::steady_clock::now();
+            if (::connect(stalled, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0 || ::write(stalled, "--output", 8) != 8 ||
+                PintTest::runAllTests2({ connectArg, "--output=quiet", "--filter=times2" }) != std::pair{ 3, 0 } ||
+                std::chrono::steady_clock::now() - stalledAt > 10s)
+            {
+                std::cerr << "Test failed at line " << __LINE__ << "\n";
+                return 1;
+            }
+            ::close(stalled);
+        }
+        // a second daemon on the same socket, or one on a file that isn't a socket, doesn't start, and leaves them be
+        const auto notSocketPath = socketPath + ".txt";
+        std::ofstream(notSocketPath) << "not a socket";
+        if (PintTest::runAllTests2({ serveArg }) != std::pair{ -1, 16 } || PintTest::runAllTests2({ "--serve=" + notSocketPath }) != std::pair{ -1, 16 } ||
+            !std::filesystem::exists(socketPath) || !std::filesystem::remove(notSocketPath))
+        {
+            std::cerr << "Test failed at line " << __LINE__ << "\n";
+            return 1;
+        }
+        int status = -1;
+        if (PintTest::runAllTests2({ connectArg, "--shutdown" }) != std::pair{ 0, 0 } || ::waitpid(daemon, &status, 0) != daemon ||
+            !WIFEXITED(status) || WEXITSTATUS(status) != 0 || std::filesystem::exists(socketPath) ||
+            PintTest::runAllTests2({ connectArg }) != std::pair{ -1, 16 })
+        {
+            std::cerr << "Test failed at line " << __LINE__ << "\n";
+            return 1;
+        }
+    }
+#endif
+    // duplicate names are only found when the tests are run, and stop them being run.  Registered last, as every
+    // later run would fail
+    PintTest::registerTestFn("testtimes2", [] {});
+    {
+        const auto [ran, failed] = PintTest::runAllTests2({});
+        if (ran != -1 || failed != 11)
         {
             std::cerr << "Test failed at line " << __LINE__ << "\n";
             return 1;
@@ -17,22 +17,345 @@ The following expects and asserts are supported (assert is the same as expect bu
     {EXPECT|ASSERT}_GE(a,b)
     {EXPECT|ASSERT}_LE(a,b)
     {EXPECT|ASSERT}_NEAR(a, b, tol)
+    {EXPECT|ASSERT}_RANGE_EQ(a, b)
+    {EXPECT|ASSERT}_RANGE_NEAR(a, b, tol)
+    {EXPECT|ASSERT}_P99_LT(recorder, limit)
+    {EXPECT|ASSERT}_MAX_LT(recorder, limit)
+    {EXPECT|ASSERT}_PERCENTILE_LT(recorder, percentile, limit)
+    {EXPECT|ASSERT}_FILE_EQ(expectedFile, actualFile)
+    {EXPECT|ASSERT}_SNAPSHOT(name, bytes)
+
+The range checks compare two whole ranges (vectors, arrays, spans, ...) element by element in one check, and on failure
+report the number of mismatches, the first one, and the elements around it.  For RANGE_NEAR, tol is either a number
+(an absolute tolerance) or one of PintTest::Tolerance::absolute(x), relative(x) or ulps(n).
+The latency checks are of a PintTest::LatencyRecorder (see below), and limit is a std::chrono duration.
+The file and snapshot checks compare bytes, without copying them (see below).
+
+and, if allocation tracking is enabled (see below), these checks of the block that follows them:
+
+    EXPECT_NO_ALLOC { ... }
+    EXPECT_ALLOCS_LE(n) { ... }
+
+and, on Linux, this check of how far the process's peak resident set rises, in bytes, over the block that follows:
+
+    EXPECT_RSS_GROWTH_LE(bytes) { ... }
 
 There is nothing to build  - just include the header sraight into your test code.
 Test cases are auto-registered across all cpp files in the test program.
 PintTest::runAllTests will run them all and report the detail and a summary.
 
+Tests that share expensive set up can be put in a suite, with a fixture:
+
+struct DatasetTest : PintTest::Fixture
+{
+    static void SetUpSuite() { s_data = loadDataset(); }    // once, before the first of the suite's tests
+    static void TearDownSuite() { s_data.reset(); }         // once, after the last of them
+    void SetUp() { m_cache.clear(); }                       // before each test, on a new DatasetTest
+    void TearDown() {}                                      // after each test, however it ends
+    static inline std::unique_ptr<Dataset> s_data;
+    Cache m_cache;
+};
+TEST_F(DatasetTest, Loads)          // named "DatasetTest.Loads"
+{
+    EXPECT_EQ(1000, s_data->size());
+}
+
+A suite's tests are always run together, one after the other, on the same thread (or worker process) and in the same
+shard, so that the suite is only set up once.  If SetUpSuite fails, none of the suite's tests are run: the first fails
+with SetUpSuite's failures, and the rest each fail as not run.  Failures in TearDownSuite are reported against the
+suite's last test.  Likewise a test whose SetUp fails isn't run, though its TearDown still is.  PintTest::registerSuite
+and registerTestFn can do the same at run time.
+
+The checks can be made from other threads that a test starts, without any locking.  Each thread records its failures in
+a buffer of its own, which is merged into the test's result when it finishes, so the threads must be joined before then.
+When the tests run one at a time this is automatic, but with --jobs the thread must say which test it belongs to:
+
+TEST(QueueUnderContention)
+{
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t)
+        threads.emplace_back([test = PintTest::currentTest()] { PintTest::AttachToTest attach(test); EXPECT_TRUE(...); });
+    for (auto& thread : threads)
+        thread.join();
+}
+
+With --jobs, a failure on a thread that isn't attached can't be told apart from the tests running at the time, so it
+is reported as it happens, and counted once for the run, as a failure of PintTest::unattributed.
+
 Run time parameters:
-// @TOTO - make the filter a regex
---filter=-<some_string>
-    If the test name matches some_string (simple substring match, no regex supported) then don't run the test.If not, do.  If not specified, run all tests.
-    Note that filtering for only one string is supported
+--filter=<pattern>
+    Run the tests whose names match the pattern.  Give this more than once to run the tests that match any of them.
+    If not specified, run all tests.
+
+--filter=-<pattern>
+    Don't run the tests whose names match the pattern, even if they match a --filter=<pattern>.  Can be given more
+    than once.
+
+A pattern is one of:
+    some_string     matches if the name contains some_string
+    glob*           a glob (* matches any run of characters, ? any one character) which must match the whole name
+    /regex/         an ECMAScript regular expression, which matches if it is found anywhere in the name
+The patterns are compiled once, with all the substrings matched together in a single pass over each name.
+
+--list-tests
+    Write out the names of the tests that pass the filter (and are in the shard), one per line, and don't run
+    anything.  With --benchmark the benchmarks are listed too.
+
+--jobs=N
+    Run the tests on N threads.  Each test's output is buffered and written out in one go when it finishes, so the output
+    of different tests doesn't interleave.  --jobs=0 uses one thread per core.  The default is 1, which runs the tests in
+    order on the calling thread.
+
+--isolate
+    Run the tests in forked worker processes (one per job), so that a test which crashes or calls exit is reported as
+    failed and the rest of the tests still run.  Not supported on Windows.
+
+--shard-index=I --total-shards=N
+    Only run every Nth test of those that pass the filter, starting at the Ith (0 based), so that a run can be split
+    across N machines.  Both must be given.
+
+--timing-db=<file>
+    Load the duration of each test from the file, and save the durations from this run back to it afterwards.  With
+    --jobs or --isolate the tests are then started longest first, and with --total-shards the tests are split so that
+    each shard takes a similar time (so every shard must be given the same file).  A sharded run only reads the file,
+    so that every shard splits the tests the same way, so update it with an unsharded run.
+
+--slowest=N
+    Report the N slowest tests of the run at the end.
+
+--shuffle --seed=S
+    Run the tests in a random order (each suite's tests are kept together, but shuffled among themselves).  The order
+    comes from the seed, which is reported at the end of the run, and without --seed= a new one is picked each run.
+    The seed is also what the properties' cases are generated from, so --seed= alone repeats those.
+
+--repeat=N
+    Run the tests N times over in the one process, for hunting down tests that only fail now and again.  With --shuffle
+    each iteration has a new order, from the seed plus the iteration (counting from 0), and the seed of each iteration
+    that failed is reported, so that its order can be run again with --seed=.  Each iteration also checks the
+    properties with new cases, from the seed plus the iteration, and a property that fails reports the seed that makes
+    its cases again.  With --jobs or --isolate, --jobs iterations are run at once, so that repeating a single test
+    spreads it over the cores.
+
+--until-fail
+    Run the tests over and over, as --repeat= does, until an iteration has a test that fails, and stop after that
+    iteration (with --jobs or --isolate, after the batch of iterations that it was run in).  With --repeat=N as well,
+    also stop after N iterations.  The exit code is the number of checks that failed, as for any other run, so it is 0
+    only if every iteration passed.  Only the last batch's results are kept, so --results-file=, --timing-db= and
+    --save-baseline= get those of the iteration that failed.
+
+--property-cases=N
+    Check each PROPERTY with N cases.  The default is 1000.
+
+--property-jobs=N
+    Check the cases of each property on N threads.  --property-jobs=0 uses one thread per core.  The default is 1.
+
+--save-baseline=<file>
+    Add the duration of each test that passed, and the ns/iter samples of each benchmark, to the baseline in the file
+    (creating it if need be).  The last BASELINE_SAMPLES samples of each are kept, so that running this a few times
+    builds up a distribution of each test's duration.
+
+--compare-baseline=<file>
+    Compare this run's timings with the baseline in the file.  A test or benchmark has regressed if it is slower by more
+    than the threshold (its median against the baseline's) and a one-sided Mann-Whitney U test says the slowdown is
+    significant (p < 0.05).  Each regression is a failure, of the test PintTest::compareBaseline for the tests, which is
+    run after them, and of the benchmark itself for benchmarks.  A test has one sample per run, and a single sample
+    slower than all m of the baseline's has p = 1 / (m + 1), so a test needs a baseline of at least 20 samples before it
+    can fail.  This can be given with --save-baseline of the same file, to compare and then add this run.
+
+--failures-per-site=K
+    Report only the first K failures of each check (each file and line) in a test in full, and count the rest, which
+    are summarised at the end of the test as "failed N more times".  The rest aren't formatted at all, so a check that
+    fails on every iteration of a long loop doesn't slow the test down to a crawl.  The default is 10, and 0 reports
+    every failure.  Checks made on other threads are limited per thread.
+
+--max-failures=N
+    Stop a test once N of its checks have failed (on the thread running the test), as if by an ASSERT.  The Nth failure
+    is reported as usual, followed by a note that the test was stopped.  The default is 0, for no limit.
+
+--update-snapshots
+    Make EXPECT_FILE_EQ and EXPECT_SNAPSHOT write the expected file or snapshot with the actual bytes, rather than
+    compare them.
+
+--snapshot-dir=<dir>
+    Where EXPECT_SNAPSHOT finds its snapshot files.  The default is "snapshots", in the working directory.
+
+--regression-threshold=<percent>
+    How much slower than the baseline a test or benchmark must be to have regressed.  The default is 10.
+
+--results-file=<file>
+    Write one line per test run (status, failed checks, duration in ns and name) to the file.
+
+--merge-results=<file>
+    Don't run any tests, instead combine the results files written by the shards of a run and report on them.  Give
+    this once for each results file.
+
+--output=<reporter>[:<file>]
+    How to report the results.  Give this more than once to use several reporters at the same time.  The reporters are:
+        console     the default - each test, its failures, and a summary, in colour.  Output is buffered and written
+                    when the buffer fills, a test fails or the run finishes
+        quiet       as console, but only the failures and the summary
+        json        a JSON object with the per-test timings (in ns) and failure locations, to the file or std::cout
+        junit       JUnit XML, to the file or std::cout
+    Both json and junit are streamed, with each test written as it finishes.  Reporters of your own can be added with
+    PintTest::addReporter.
+
+--perf-counters
+    Count the CPU cycles, instructions, branch misses and L1 data and last level cache misses of each test with the
+    hardware performance counters (Linux only, via perf_event_open), and report them along with the IPC.  Only the
+    thread the test runs on is counted.  If the counters can't be opened (e.g. in a container, or with
+    /proc/sys/kernel/perf_event_paranoid too high) a warning is written and the tests run without them, and counters
+    the CPU doesn't have are left out.
+
+--resource-usage
+    Measure what each test costs besides its wall time, with getrusage: its user and system CPU time (so a test that
+    spends its time blocked stands out from one that spends it computing), its minor and major page faults, and its
+    voluntary and involuntary context switches.  On Linux also how far the peak resident set rose above what was
+    resident when the test started, from /proc/self/status, with the peak reset before each test.  All the reporters
+    show them, and the summary has their totals.  With --jobs only the thread the test runs on is counted, and the
+    tests running at the same time share the peak resident set, which isn't reset.  Async tests, which run
+    interleaved, aren't measured.  About 10us a test.
+
+--benchmark
+    After the tests, run the benchmarks which pass the filter and report their ns/iter (mean, median, stddev and min).
+    Benchmarks always run one at a time on the calling thread, and are skipped if this isn't given.
+
+--serve=<socket> --load=<library>
+    Don't run any tests, instead load the test libraries (give --load= once for each) and serve runs requested with
+    --connect= on the Unix socket, until one is given --shutdown.  A socket left there by a daemon that was killed is
+    replaced, but a daemon still serving on it, or a file that isn't a socket, stops this one.  See "Serving" below.
+
+--connect=<socket>
+    Have the process serving on the socket run the tests with the rest of the arguments, and write its output.  The
+    run's results are returned as if it had been run here.
+
+Allocation tracking:
+    #define PINTTEST_TRACK_ALLOCATIONS before including PintTest.h in exactly one cpp file of the test program, and
+    the global operator new and delete are replaced with versions that count each thread's allocations.  Every test's
+    result then has the number of allocations it made and the bytes it asked for, which all the reporters show, and
+    EXPECT_NO_ALLOC/EXPECT_ALLOCS_LE can be used.  Only allocations on the thread running the test are counted.
+
+Concurrency stress tests:
+    PintTest::stress(threads, duration or iterations, fn) calls fn(threadIndex) over and over on each of the threads,
+    until the duration has passed or each thread has made that many calls.  The threads are pinned to the CPUs the
+    process may run on, round robin, and released together from a spin barrier.  The checks made in fn count against
+    the test, and the operations per second and latency of each thread and of the whole run are returned and reported
+    with the test.  A thread count of 0 means one thread per core.
+
+TEST(QueuePushPop)
+{
+    LockFreeQueue<int> queue;
+    PintTest::stress(4, std::chrono::milliseconds(100), [&queue](unsigned thread)
+        {
+            queue.push(thread);
+            EXPECT_TRUE(queue.pop().has_value());
+        });
+}
+
+Latency percentiles:
+    A PintTest::LatencyRecorder is a histogram of latencies, which records one in a few ns without allocating, so it
+    can go in the loop being measured.  EXPECT_P99_LT(recorder, limit), EXPECT_MAX_LT(recorder, limit) and
+    EXPECT_PERCENTILE_LT(recorder, percentile, limit) (and the ASSERT_s) check it, and add its percentiles to the test's
+    result for the reporters, as does recorder.report().
+
+TEST(LookupLatency)
+{
+    PintTest::LatencyRecorder latency("lookup");
+    for (int i = 0; i < 100000; ++i)
+    {
+        const auto start = std::chrono::steady_clock::now();
+        PintTest::DoNotOptimize(table.find(i));
+        latency.record(std::chrono::steady_clock::now() - start);
+    }
+    EXPECT_P99_LT(latency, std::chrono::microseconds(1));
+}
+
+Golden files and snapshots:
+    EXPECT_FILE_EQ(expectedFile, actualFile) checks that two files (std::filesystem::paths) have the same bytes, and
+    EXPECT_SNAPSHOT(name, bytes) that bytes (a std::string, vector, span, ... of any trivially copyable type) are the
+    same as the snapshot file name, in the --snapshot-dir.  The files are mapped into memory rather than read, and
+    compared with memcmp, so large files cost no more than a pass over them.  On failure only the sizes, the offset of
+    the first byte that differs, and a hex dump of the bytes around it are reported.  With --update-snapshots the
+    checks instead pass, and write the expected file or snapshot (only if it differs), to accept the current output.
+
+TEST(SerialisedIndex)
+{
+    EXPECT_SNAPSHOT("index.bin", buildIndex().serialise());    // snapshots/index.bin
+}
+
+Properties:
+    A PROPERTY is a test of a body that is called with many generated cases of its arguments, --property-cases of
+    them, rather than with a few picked by hand.  The generators (PintTest::Gen) are integers, reals, chars, strings,
+    vectors and containers of other generators, and they draw from a fast PRNG seeded from the run's --seed= and the
+    case's index, so making a case costs a few ns and (once the first few cases have grown the containers) allocates
+    nothing.  When a case fails it is shrunk, by dropping elements and moving numbers towards 0 for as long as it still
+    fails, and only the smallest failing case is reported, with the seed that reproduces it.  Numbers are passed to the
+    body by value and everything else by const reference.  --property-jobs splits the cases across threads.
+    PintTest::registerProperty does the same at run time.
+
+PROPERTY(SortIsIdempotent, PintTest::Gen::vectors(PintTest::Gen::integers(-100, 100)))(const std::vector<int>& v)
+{
+    auto once = v;
+    std::sort(once.begin(), once.end());
+    auto twice = once;
+    std::sort(twice.begin(), twice.end());
+    EXPECT_RANGE_EQ(once, twice);
+}
+
+Async tests:
+    A TEST_ASYNC is a C++20 coroutine, which can co_await PintTest::sleepFor(duration), sleepUntil(time point),
+    readable(fd) and writable(fd), and other PintTest::Tasks.  All the async tests of a run are started together on one
+    event loop on one thread (timers in a heap, fds in epoll, so Linux only), and while one waits the others run, so
+    tests that spend their time waiting (timeouts, retries, sockets) take as long as the longest of them rather than
+    the sum.  Each is reported when it finishes, and its checks count against it however its awaits interleave with
+    the others.  With --jobs or --isolate, or executeTest, each is run on a loop of its own.  ASSERT_s return, which a
+    coroutine can't, so use CO_ASSERT_TRUE ... CO_ASSERT_RANGE_NEAR instead.  Hardware counters and allocations aren't
+    measured for tests run together, as their running overlaps.
+
+TEST_ASYNC(ServerReplies)
+{
+    const int fd = connectToServer();
+    co_await PintTest::writable(fd);
+    CO_ASSERT_EQ(::write(fd, "ping", 4), 4);
+    co_await PintTest::readable(fd);
+    EXPECT_EQ(readReply(fd), "pong");
+}
+
+Benchmarks are written much like tests, with the timed code in a loop:
+
+BENCHMARK(benchtimes2)
+{
+    int x = 1;                      // setup, not timed
+    while (state.keepRunning())
+        PintTest::DoNotOptimize(times2(x));
+}
+
+Compile times:
+    By default the header is the whole library, so every file of tests compiles the runner, the reporters and the
+    formatting of failures, and includes everything they need (<iostream>, <regex>, <filesystem>, ...).  To compile all
+    that once instead, define PINTTEST_SEPARATE_IMPLEMENTATION for every file (e.g. with -D), and PINTTEST_IMPLEMENTATION
+    as well in just one of them, usually the one with main:
+
+    #define PINTTEST_IMPLEMENTATION
+    #include <PintTest.h>
+
+    int main(int argc, const char* argv[]) { return PintTest::runAllTests(argc, argv); }
 
---filter=<some_string>
-    If the test name matches some_string *(simple substring match, no regex supported) then run the test.If not, not.  If not specified, run all tests.
-    Note that filtering for only one string is supported
+    The other files then only get the declarations, the checks and the macros.  PintTestCompileBench.sh times the two.
+    Only the separate files are quicker to compile (a third less, for 1,000 checks): a header only build takes as long
+    as it ever did, and the implementation file, compiled once, takes about twice as long as a header only one.
 
-You can't specify both the filter and the not filter.
+Serving:
+    To run a few tests over and over while editing, without paying each time for starting a process, loading and
+    linking its libraries and registering every test, build the tests as shared libraries and keep a process that has
+    loaded them, with --serve=.  The libraries are built with PINTTEST_SEPARATE_IMPLEMENTATION, and the serving program
+    with PINTTEST_IMPLEMENTATION and -rdynamic (and -ldl, for glibc before 2.34), so that the libraries' tests register
+    with it.  Before each run the libraries that have been rebuilt since they were loaded are loaded again, and the
+    tests they registered before are taken out, so a run costs little more than the tests it runs.  Any program that
+    calls runAllTests can be the client, and paths in a run's arguments are relative to the serving process.  Unix only.
+
+    g++ -std=c++20 -fPIC -shared -DPINTTEST_SEPARATE_IMPLEMENTATION QueueTests.cpp -o libQueueTests.so
+    ./TestServer --serve=/tmp/tests.sock --load=./libQueueTests.so &
+    ./TestServer --connect=/tmp/tests.sock --filter=Queue
 
 Example use:
 
@@ -63,418 +386,6494 @@ int main(int argc, const char* argv[])
 
 */
 
-#include <iostream>
+// PINTTEST_SEPARATE_IMPLEMENTATION leaves the runner, the reporters and the formatting of failures out of the header,
+// so that it only declares them, and PINTTEST_IMPLEMENTATION (which implies it) compiles them into the one translation
+// unit that defines it.  Without either the header is the whole library, as usual
+#if defined(PINTTEST_IMPLEMENTATION) && !defined(PINTTEST_SEPARATE_IMPLEMENTATION)
+#define PINTTEST_SEPARATE_IMPLEMENTATION
+#endif
+#if !defined(PINTTEST_SEPARATE_IMPLEMENTATION) || defined(PINTTEST_IMPLEMENTATION)
+#define PINTTEST_RUNNER
+#endif
+#ifdef PINTTEST_SEPARATE_IMPLEMENTATION
+#define PINTTEST_RUNNER_INLINE
+#else
+#define PINTTEST_RUNNER_INLINE inline
+#endif
+
+// What the tests themselves need.  <functional> is here as well, as std::function is part of what tests call
+// (registerTestFn, registerSuite, runTrial, stress and the properties), even though it's heavy to include
 #include <source_location>
 #include <functional>
 #include <vector>
-#include <sstream>
 #include <chrono>
-#include <unordered_set>
 #include <string>
 #include <string_view>
+#include <atomic>
+#include <charconv>
+#include <algorithm>
+#include <utility>
+#include <optional>
+#include <cstring>
+#include <cmath>
+#include <memory>
+#include <ostream>
+#include <type_traits>
+#include <tuple>
+#include <coroutine>
+#include <exception>
+#include <array>
+#include <span>
+#include <bit>
+#include <ranges>
+#include <limits>
+#include <new>
+#include <cstdlib>
+#include <cstddef>
+#include <cstdint>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+// What only the runner needs
+#ifdef PINTTEST_RUNNER
+#include <iostream>
+#include <sstream>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <fstream>
+#include <iomanip>
+#include <cstdio>
+#include <unordered_map>
+#include <map>
+#include <filesystem>
+#include <regex>
 
 #ifdef _WIN32
+// without NOMINMAX, Windows.h defines min and max as macros, which break std::min, std::max and numeric_limits<T>::max
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
 #include "Windows.h"
+#include <malloc.h>
+#else
+#include <csignal>
+#include <cerrno>
+#include <fcntl.h>
+#include <poll.h>
+#include <dlfcn.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+#ifdef __linux__
+#include <sched.h>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <sys/epoll.h>
+#endif
+#elif defined(_WIN32)
+#include <malloc.h>
+#endif
+
+#if defined(_MSC_VER)
+#define PINTTEST_NOINLINE __declspec(noinline)
+#elif defined(__GNUC__) || defined(__clang__)
+#define PINTTEST_NOINLINE __attribute__((noinline, cold))
+#else
+#define PINTTEST_NOINLINE
+#endif
+
+// For the failure paths that the runner defines, which are declared before the checks that call them.  GCC won't have
+// noinline on an inline function that is declared before it is defined, so header only they are just cold
+#if defined(PINTTEST_SEPARATE_IMPLEMENTATION) || defined(_MSC_VER)
+#define PINTTEST_RUNNER_COLD PINTTEST_NOINLINE PINTTEST_RUNNER_INLINE
+#elif defined(__GNUC__) || defined(__clang__)
+#define PINTTEST_RUNNER_COLD __attribute__((cold)) inline
+#else
+#define PINTTEST_RUNNER_COLD inline
 #endif
 
+namespace PintTestNS
+{
+    class Runner;
+}
+
 class PintTest
 {
-    struct Test
-    {
-        std::string m_name;
-        std::function<void()> m_fn;
-        void test(const std::string& filter, const std::string& notFilter)
-        {
-            if (!notFilter.empty() && m_name.find(notFilter) != std::string::npos)
-                return;
+    friend class PintTestNS::Runner;
 
-            if (filter.empty() || m_name.find(filter) != std::string::npos)
-                PintTest::runTest(m_fn, m_name);
-        }
-    };
-    static inline std::vector<Test> tests;
-    static inline std::unordered_set<std::string> test_names;
+    // failures recorded on a thread which isn't running a test (e.g. one spawned by a test body)
+    static inline std::atomic<int> s_unattributedFails = 0;
+    // the highest peak resident set that resetPeakMemory has cleared during the test, which is still the test's peak
+    static inline std::atomic<uint64_t> s_clearedPeakRss = 0;
+
+    static constexpr unsigned DEFAULT_FAILURES_PER_SITE = 10;
 
 public:
 
-    static inline int s_fails = 0;
-    static inline int s_tests_failed = 0;
-    static inline int s_tests_ran = 0;
+    static inline std::atomic<int> s_fails = 0;
+    static inline std::atomic<int> s_tests_failed = 0;
+    static inline std::atomic<int> s_tests_ran = 0;
 
     static constexpr auto GREEN_TEXT_START = "\x1B[32m";
     static constexpr auto RED_TEXT_START = "\x1B[31m";
     static constexpr auto COLOUR_TEXT_END = "\033[0m\t\t";
 
-    static bool registerTestFn(const char* name, std::function<void()> test)
+    // A failed check, with the location that MsgWriter captured
+    struct Failure
     {
-        if (test_names.contains(name))
-        {
-            std::cout << RED_TEXT_START << name << name << " has already been registered" << COLOUR_TEXT_END << "\n";
-            exit(1);
-        }
-        test_names.insert(name);
-        tests.push_back({ name, test });
-        return true;
-    }
-
-    static void selfTest();
+        std::string m_file;
+        uint_least32_t m_line = 0;
+        std::string m_message;
+    };
 
-    // Create from argc/argv as follows: std::vector<std::string_view> args(argv, argv + argc);
-    // returns a pair of ints - the number of tests ran, and the number of tests failed.  If first is negative, then the arguments are invalid
-    static std::pair<int,int> runAllTests2(const std::vector<std::string_view>& args)
+    // The hardware counter values for one test, with --perf-counters.  Counters that couldn't be read are marked as
+    // not available
+    struct PerfCounters
     {
-        s_fails = 0;
-        s_tests_failed = 0;
-        s_tests_ran = 0;
+        enum Counter { CYCLES, INSTRUCTIONS, BRANCH_MISSES, L1D_MISSES, LLC_MISSES, COUNTER_COUNT };
+        static constexpr std::array<const char*, COUNTER_COUNT> NAMES{ "cycles", "instructions", "branch_misses", "l1d_misses", "llc_misses" };
 
-        PintTest::runTest(PintTest::selfTest, "PintTest::selfTest");
-        if (s_fails > 0)
-            return { s_tests_ran, s_fails };
+        std::array<uint64_t, COUNTER_COUNT> m_values{};
+        // one bit per Counter
+        uint32_t m_available = 0;
 
-        std::string filter;
-        std::string notFilter;
-        if (!args.empty())
+        [[nodiscard]] bool has(Counter counter) const { return (m_available >> counter) & 1; }
+        [[nodiscard]] std::optional<double> ipc() const
         {
-            std::string filterArg = "--filter=";
-            std::string notFilterArg = "--filter=-";
-            for (auto& arg : args)
-            {
-                if (arg.starts_with(filterArg))
-                {
-                    if (!filter.empty() || !notFilter.empty())
-                    {
-                        std::cerr << "More than one instance of \"--filter=\", terminating\n";
-                        return { -1, 1 };
-                    }
-                    if (arg.size() == filterArg.size())
-                    {
-                        std::cerr << "\"--filter=\" specified without a filter, nothing to do\n";
-                        return { s_tests_ran, s_fails };
-                    }
-                    if (arg.size() == notFilterArg.size() && arg[arg.size()-1] == '-')
-                    {
-                        std::cerr << "\"--filter=-\" specified without a filter, terminating\n";
-                        return { -1, 2 };
-                    }
-                    if (arg.starts_with(notFilterArg))
-                        notFilter = arg.substr(notFilterArg.length(), arg.size() - notFilterArg.size());
-                    else
-                        filter = arg.substr(filterArg.length(), arg.size() - filterArg.size());
-                }
-            }
+            if (!has(CYCLES) || !has(INSTRUCTIONS) || m_values[CYCLES] == 0)
+                return std::nullopt;
+            return static_cast<double>(m_values[INSTRUCTIONS]) / static_cast<double>(m_values[CYCLES]);
         }
-        const auto start = std::chrono::system_clock::now();
-
-        for (auto& test : tests)
-            test.test(filter, notFilter);
-
-        const auto durationMs = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now() - start).count();
+    };
 
-        if (s_fails)
-            std::cout << RED_TEXT_START << "Ran " << s_tests_ran << " tests and " << s_tests_failed << " failed (" << durationMs << "ms)" << COLOUR_TEXT_END << "\n";
-        else
-            std::cout << GREEN_TEXT_START << "Ran " << s_tests_ran << " tests and none failed" << " failed (" << durationMs << "ms)" << COLOUR_TEXT_END << "\n";
+    // Allocations made on one thread, with PINTTEST_TRACK_ALLOCATIONS
+    struct AllocationCounts
+    {
+        uint64_t m_allocations = 0;
+        uint64_t m_bytes = 0;
+    };
 
-        return { s_tests_ran, s_fails };
-    }
-    // Create from argc/argv as follows: std::vector<std::string_view> args(argv, argv + argc);
-    static int runAllTests(const std::vector<std::string_view>& args)
+    // What one test cost, with --resource-usage: the CPU time, page faults and context switches from getrusage, and how
+    // far the peak resident set rose above what was resident when the test started, from /proc/self/status
+    struct ResourceUsage
     {
-        auto [_, failed] = runAllTests2(args);
-        return failed;
-    }
-    /** UB if argv doesn't contain argc strings.  Which is why the version taking a vector is better.  This just makes it easier to use */
-    static int runAllTests(int argc, const char* argv[])
+        std::chrono::microseconds m_userTime{};
+        std::chrono::microseconds m_systemTime{};
+        uint64_t m_minorFaults = 0;
+        uint64_t m_majorFaults = 0;
+        uint64_t m_voluntarySwitches = 0;
+        uint64_t m_involuntarySwitches = 0;
+        uint64_t m_peakRssGrowth = 0;
+        [[nodiscard]] std::chrono::microseconds cpuTime() const { return m_userTime + m_systemTime; }
+        // For the totals of a run, which have the largest of the peak RSS growths, as they don't add up
+        ResourceUsage& operator+=(const ResourceUsage& other)
+        {
+            m_userTime += other.m_userTime;
+            m_systemTime += other.m_systemTime;
+            m_minorFaults += other.m_minorFaults;
+            m_majorFaults += other.m_majorFaults;
+            m_voluntarySwitches += other.m_voluntarySwitches;
+            m_involuntarySwitches += other.m_involuntarySwitches;
+            m_peakRssGrowth = std::max(m_peakRssGrowth, other.m_peakRssGrowth);
+            return *this;
+        }
+    };
+
+    // The process's resident set and its peak, in bytes, from /proc/self/status
+    struct MemoryUsage
     {
-        return runAllTests(std::vector<std::string_view>(argv, argv + argc));
-    }
+        uint64_t m_rss = 0;
+        uint64_t m_peakRss = 0;
+    };
 
-    static void runTest(std::function<void()> testFn, const std::string& testCase)
+    // One thread of a PintTest::stress run
+    struct StressThread
     {
-        ++PintTest::s_tests_ran;
-        const auto currentFails = PintTest::s_fails;
-        std::cout << PintTest::GREEN_TEXT_START << "Testing " << testCase << PintTest::COLOUR_TEXT_END << "\n";
-        const auto start = std::chrono::system_clock::now();
-        testFn();
-        const auto durationMs = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now() - start).count();
-        if (currentFails < PintTest::s_fails)
+        uint64_t m_operations = 0;
+        std::chrono::nanoseconds m_elapsed{};
+        // the time per operation of this thread's slowest batch of STRESS_BATCH operations
+        std::chrono::nanoseconds m_maxLatency{};
+        // the CPU the thread was pinned to, or -1 if it couldn't be
+        int m_cpu = -1;
+        [[nodiscard]] double operationsPerSecond() const
         {
-            ++PintTest::s_tests_failed;
-            std::cout << PintTest::RED_TEXT_START << "FAILED  " << testCase << " (" << durationMs << "ms)" << PintTest::COLOUR_TEXT_END << "\n";
+            return m_elapsed.count() > 0 ? static_cast<double>(m_operations) * 1e9 / static_cast<double>(m_elapsed.count()) : 0.0;
         }
-        else
+        [[nodiscard]] std::chrono::nanoseconds meanLatency() const
         {
-            std::cout << PintTest::GREEN_TEXT_START << "PASSED  " << testCase << " (" << durationMs << "ms)" << PintTest::COLOUR_TEXT_END << "\n";
+            return m_operations ? m_elapsed / static_cast<int64_t>(m_operations) : std::chrono::nanoseconds{};
         }
-    }
-};
-
-namespace PintTestNS
-{
-    // GetString returns the stream version of the object if streaming is supported, otherwise just returns the address
-    //@todo - maybe do something about const char*
-    template <typename T> concept Streamable = requires(std::ostringstream os, T value) { { os << value }; };
-    template <typename T> requires (Streamable<T>)
-        inline auto constexpr GetString(const T& value)
-    {
-        std::ostringstream ss;
-        ss << value;
-        return ss.str();
-    }
-    template <typename T> requires (!Streamable<T>)
-        inline auto constexpr GetString(const T& value)
-    {
-        return to_string(&value);
-    }
+    };
+    // Operations are timed in batches, as reading the clock for every one would cost more than many of the operations
+    // being stressed
+    static constexpr uint64_t STRESS_BATCH = 32;
 
-    // Captures the error msessage, for when the test fails
-    class Msg
+    // The outcome of a PintTest::stress run
+    struct StressResult
     {
-    public:
-        Msg() = default;
-        Msg(const std::string& value)
-            : m_Empty(value.empty())
+        std::vector<StressThread> m_threads;
+        // from the threads being released until the last of them finished
+        std::chrono::nanoseconds m_elapsed{};
+        [[nodiscard]] uint64_t operations() const
         {
-            m_SS << value;
+            uint64_t operations = 0;
+            for (const auto& thread : m_threads)
+                operations += thread.m_operations;
+            return operations;
         }
-        template <class T>
-        Msg& operator<<(const T& value)
+        [[nodiscard]] double operationsPerSecond() const
         {
-            m_SS << GetString(value);
-            return *this;
+            return m_elapsed.count() > 0 ? static_cast<double>(operations()) * 1e9 / static_cast<double>(m_elapsed.count()) : 0.0;
         }
-        friend std::ostream& operator<<(std::ostream& ss, const Msg& value)
+        // the mean over all the operations of all the threads
+        [[nodiscard]] std::chrono::nanoseconds meanLatency() const
         {
-            ss << value.getString();
-            return ss;
+            std::chrono::nanoseconds total{};
+            for (const auto& thread : m_threads)
+                total += thread.m_elapsed;
+            const auto count = operations();
+            return count ? total / static_cast<int64_t>(count) : std::chrono::nanoseconds{};
         }
-        void clear()
+        [[nodiscard]] std::chrono::nanoseconds maxLatency() const
         {
-            m_SS.clear();
+            std::chrono::nanoseconds latency{};
+            for (const auto& thread : m_threads)
+                latency = std::max(latency, thread.m_maxLatency);
+            return latency;
         }
-        [[nodiscard]] std::string getString() const { return m_SS.str(); }
-        [[nodiscard]] bool empty() const { return m_Empty; }
-    private:
-        bool m_Empty = true;
-        std::ostringstream m_SS;
-
     };
 
-    // function to create the error string (not including any extra values passed in via <<)
-    template<class L, class R>
-    Msg createCompareString(bool pass, const char* prefix, const L& l, const R& r, const char* pL, const char* pR)
+    // The percentiles etc. of a LatencyRecorder, as reported with a test
+    struct LatencySummary
     {
-        if (pass)
-            return {};
-        PintTest::s_fails += 1;
-        return std::string("\n") + pL + " " + prefix + " " + pR + "\nExpected: " + GetString(l) + "\n" + "Actual: " + GetString(r) + "\n";
-    }
+        enum Statistic { MIN, MEAN, P50, P90, P99, P999, MAX, STATISTIC_COUNT };
+        static constexpr std::array<const char*, STATISTIC_COUNT> NAMES{ "min", "mean", "p50", "p90", "p99", "p999", "max" };
 
-    inline Msg createCompareStringNear(bool pass, double l, double r, const char* pL, const char* pR, const char* pTolerance)
-    {
-        if (pass)
-            return {};
-        PintTest::s_fails += 1;
-        return std::string("\n") + pL + " == " + pR + " (+/-" + pTolerance + ")\nExpected: " + GetString(l) + "\n" + "Actual: " + GetString(r) + "\n";
-    }
+        std::string m_name;
+        uint64_t m_count = 0;
+        std::array<std::chrono::nanoseconds, STATISTIC_COUNT> m_values{};
+    };
 
-    // Test true - return an empty Msg if true, or a Msg with the error message in it if false
-    template<class T>
-    Msg compTrue(const T& t, const char* pT)
-    {
-        return createCompareString((t), "is true", t, true, pT, "true");
-    }
-    // Test false - return an empty Msg if false, or a Msg with the error message in it if true
-    template<class T>
-    Msg compFalse(const T& t, const char* pT)
+    // A histogram of latencies, which records each one in a few ns, without allocating after construction.  The buckets
+    // are log-linear, as in HdrHistogram: one per ns up to 2^LATENCY_PRECISION_BITS ns, and above that each power of two
+    // split into 2^(LATENCY_PRECISION_BITS-1), so a percentile is within 1/128th of the true value.  Not thread safe -
+    // give each thread its own, and merge them
+    class LatencyRecorder
     {
-        return createCompareString(!(t), "is false", t, false, pT, "false");
-    }
+    public:
+        static constexpr int LATENCY_PRECISION_BITS = 8;
 
-    // Test equals - return an empty Msg if pass, or a Msg with the error message in it if failed
-    template<class L, class R>
-    Msg compEq(const L& l, const R& r, const char* pL, const char* pR)
-    {
-        return createCompareString((l == r), "==", l, r, pL, pR);
-    }
-    // Test not equals - return an empty Msg if pass, or a Msg with the error message in it if failed
-    template<class L, class R>
-    Msg compNe(const L& l, const R& r, const char* pL, const char* pR)
-    {
-        return createCompareString(!(l == r), "!=", l, r, pL, pR);
-    }
+        explicit LatencyRecorder(std::string name = {})
+            : m_name(std::move(name)), m_counts(BUCKET_COUNT)
+        {
+        }
 
-    // Test geater than - return an empty Msg if pass, or a Msg with the error message in it if failed
-    template<class L, class R>
-    Msg compGt(const L& l, const R& r, const char* pL, const char* pR)
-    {
-        return createCompareString((l > r), ">", l, r, pL, pR);
-    }
-    // Test less than - return an empty Msg if pass, or a Msg with the error message in it if failed
-    template<class L, class R>
-    Msg compLt(const L& l, const R& r, const char* pL, const char* pR)
-    {
-        return createCompareString((l < r), "<", l, r, pL, pR);
-    }
-    // Test geater than or equal to - return an empty Msg if pass, or a Msg with the error message in it if failed
-    template<class L, class R>
-    Msg compGe(const L& l, const R& r, const char* pL, const char* pR)
-    {
-        return createCompareString((l >= r), ">=", l, r, pL, pR);
-    }
-    // Test less than or equal to - return an empty Msg if pass, or a Msg with the error message in it if failed
-    template<class L, class R>
-    Msg compLe(const L& l, const R& r, const char* pL, const char* pR)
-    {
-        return createCompareString((l <= r), "<=", l, r, pL, pR);
-    }
+        void record(std::chrono::nanoseconds latency) noexcept
+        {
+            record(static_cast<uint64_t>(std::max<std::chrono::nanoseconds::rep>(latency.count(), 0)));
+        }
+        void record(uint64_t ns) noexcept
+        {
+            ++m_counts[bucket(ns)];
+            ++m_count;
+            m_total += ns;
+            m_min = std::min(m_min, ns);
+            m_max = std::max(m_max, ns);
+        }
+        void merge(const LatencyRecorder& other) noexcept
+        {
+            for (size_t i = 0; i < BUCKET_COUNT; ++i)
+                m_counts[i] += other.m_counts[i];
+            m_count += other.m_count;
+            m_total += other.m_total;
+            m_min = std::min(m_min, other.m_min);
+            m_max = std::max(m_max, other.m_max);
+        }
+        void reset() noexcept
+        {
+            std::fill(m_counts.begin(), m_counts.end(), 0);
+            m_count = m_total = m_max = 0;
+            m_min = std::numeric_limits<uint64_t>::max();
+        }
 
-    // Test for nearness with doubles/floats - return an empty Msg if pass, or a Msg with the error message in it if failed
-    inline Msg compNear(double l, double r, double tolerance, const char* pL, const char* pR, const char* pTolerance)
-    {
-        const double diff = l > r ? l - r : r - l;
-        return createCompareStringNear(diff < tolerance, l, r, pL, pR, pTolerance);
-    }
+        [[nodiscard]] const std::string& name() const { return m_name; }
+        [[nodiscard]] uint64_t count() const { return m_count; }
+        [[nodiscard]] std::chrono::nanoseconds min() const { return nanoseconds(m_count ? m_min : 0); }
+        [[nodiscard]] std::chrono::nanoseconds max() const { return nanoseconds(m_max); }
+        [[nodiscard]] std::chrono::nanoseconds mean() const { return nanoseconds(m_count ? m_total / m_count : 0); }
+        // The latency that percentile percent of those recorded are at or below: the top of the bucket that the
+        // percentile falls in, but no more than the maximum, so percentile(100) is exactly max()
+        [[nodiscard]] std::chrono::nanoseconds percentile(double percent) const
+        {
+            if (m_count == 0)
+                return {};
+            const auto target = std::clamp<uint64_t>(static_cast<uint64_t>(std::ceil(percent / 100.0 * static_cast<double>(m_count))), 1, m_count);
+            uint64_t seen = 0;
+            size_t i = 0;
+            while ((seen += m_counts[i]) < target)
+                ++i;
+            return nanoseconds(std::min(highestInBucket(i), m_max));
+        }
 
-    // a class to actually output the error message, and add a new line of required
-    class MsgWriter
-    {
-    public:
+        [[nodiscard]] LatencySummary summary() const
+        {
+            LatencySummary summary{ m_name, m_count, {} };
+            summary.m_values[LatencySummary::MIN] = min();
+            summary.m_values[LatencySummary::MEAN] = mean();
+            summary.m_values[LatencySummary::P50] = percentile(50);
+            summary.m_values[LatencySummary::P90] = percentile(90);
+            summary.m_values[LatencySummary::P99] = percentile(99);
+            summary.m_values[LatencySummary::P999] = percentile(99.9);
+            summary.m_values[LatencySummary::MAX] = max();
+            return summary;
+        }
+        // Add the summary to the result of the test running on this thread, replacing any earlier one of the same name
+        void report(const std::string& name) const;
+        void report() const { report(m_name); }
+
+    private:
+        static constexpr size_t SUB_BUCKETS = size_t(1) << (LATENCY_PRECISION_BITS - 1);
+        static constexpr size_t BUCKET_COUNT = (64 - LATENCY_PRECISION_BITS + 2) * SUB_BUCKETS;
 
-        MsgWriter(const char* fn, const char* func, uint_least32_t line)
-            : m_fn(fn), m_func(func), m_line(line)
+        // Values below 2^LATENCY_PRECISION_BITS are their own bucket.  Above that, with the value shifted down so that
+        // it has LATENCY_PRECISION_BITS bits, the bucket is shift * SUB_BUCKETS + what's left, which carries on from
+        // where the buckets of the previous shift left off
+        static size_t bucket(uint64_t value) noexcept
         {
+            const int shift = std::max(0, static_cast<int>(std::bit_width(value)) - LATENCY_PRECISION_BITS);
+            return (static_cast<size_t>(shift) * SUB_BUCKETS) + static_cast<size_t>(value >> shift);
         }
-        void operator=(Msg& str)
+        static uint64_t highestInBucket(size_t index) noexcept
         {
-            m_Str = str.getString();
-            str.clear();
+            if (index < 2 * SUB_BUCKETS)
+                return index;
+            const auto shift = index / SUB_BUCKETS - 1;
+            const auto lowest = static_cast<uint64_t>(index - shift * SUB_BUCKETS) << shift;
+            return lowest + ((uint64_t(1) << shift) - 1);
         }
-        ~MsgWriter()
+        static std::chrono::nanoseconds nanoseconds(uint64_t ns)
         {
+            return std::chrono::nanoseconds(static_cast<std::chrono::nanoseconds::rep>(std::min<uint64_t>(ns, std::numeric_limits<std::chrono::nanoseconds::rep>::max())));
+        }
+
+        std::string m_name;
+        std::vector<uint64_t> m_counts;
+        uint64_t m_count = 0;
+        uint64_t m_total = 0;
+        uint64_t m_min = std::numeric_limits<uint64_t>::max();
+        uint64_t m_max = 0;
+    };
+
+    // A whole file mapped read only into memory, so that it can be compared without being copied.  If the file can't be
+    // opened valid() is false and error() says why.  An empty file is valid, with no bytes
+    class MappedFile
+    {
+    public:
+        explicit MappedFile(const std::string& path);
+        ~MappedFile();
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        [[nodiscard]] bool valid() const { return m_valid; }
+        [[nodiscard]] const std::string& error() const { return m_error; }
+        [[nodiscard]] std::span<const unsigned char> bytes() const { return { m_data, m_data ? m_size : 0 }; }
+
+    private:
+        const unsigned char* m_data = nullptr;
+        size_t m_size = 0;
+        bool m_valid = false;
+        std::string m_error;
+        // the file and mapping HANDLEs on Windows
+        void* m_file = nullptr;
+        void* m_mapping = nullptr;
+    };
+
+    // Whether the file and snapshot checks are to write their expected files rather than compare them, with
+    // --update-snapshots
+    [[nodiscard]] static bool updatingSnapshots() { return s_updateSnapshots; }
+
+    // The outcome of running one test
+    struct TestResult
+    {
+        std::string m_name;
+        int m_fails = 0;
+        // the test killed the process it was running in (only possible with --isolate).  m_failures says how
+        bool m_crashed = false;
+        std::chrono::nanoseconds m_duration{};
+        std::vector<Failure> m_failures;
+        // only with --perf-counters, and when at least one counter could be read
+        std::optional<PerfCounters> m_counters;
+        // only with PINTTEST_TRACK_ALLOCATIONS
+        std::optional<AllocationCounts> m_allocations;
+        // only with --resource-usage, where getrusage is available
+        std::optional<ResourceUsage> m_resources;
+        // each of the PintTest::stress runs the test made
+        std::vector<StressResult> m_stress;
+        // each LatencyRecorder the test checked or reported
+        std::vector<LatencySummary> m_latencies;
+        [[nodiscard]] bool passed() const { return m_fails == 0 && !m_crashed; }
+    };
+
+    // The totals for a whole run
+    struct RunSummary
+    {
+        int m_testsRan = 0;
+        int m_testsFailed = 0;
+        int m_fails = 0;
+        std::chrono::nanoseconds m_duration{};
+        // the slowest tests of the run, slowest first, if --slowest= was given
+        std::vector<std::pair<std::string, std::chrono::nanoseconds>> m_slowest;
+        // how many times the tests were run, with --repeat= or --until-fail
+        unsigned m_iterations = 1;
+        // what the order of the tests was shuffled with, with --shuffle
+        std::optional<uint64_t> m_seed;
+        // the iterations (counting from 1) in which a test failed, each with the seed that its order was shuffled with
+        std::vector<std::pair<unsigned, uint64_t>> m_failedIterations;
+        // the totals of the tests' resource usage, with --resource-usage
+        std::optional<ResourceUsage> m_resources;
+    };
+
+    // Passed to each BENCHMARK body, which should loop over the code being measured with
+    //     while (state.keepRunning()) { ... }
+    // Anything before the loop is setup and isn't timed
+    class BenchmarkState
+    {
+    public:
+        explicit BenchmarkState(uint64_t iterations) : m_iterations(iterations) {}
+
+        bool keepRunning()
+        {
+            if (m_remaining != 0) [[likely]]
+            {
+                --m_remaining;
+                return true;
+            }
+            return startOrStop();
+        }
+        [[nodiscard]] uint64_t iterations() const { return m_iterations; }
+        [[nodiscard]] std::chrono::nanoseconds elapsed() const { return m_elapsed; }
+        // whether the loop ran to the end, which is when elapsed is set
+        [[nodiscard]] bool finished() const { return m_finished; }
+
+    private:
+        bool startOrStop()
+        {
+            if (!m_running)
+            {
+                m_running = true;
+                m_remaining = m_iterations - 1;
+                m_start = std::chrono::steady_clock::now();
+                return true;
+            }
+            m_elapsed = std::chrono::steady_clock::now() - m_start;
+            m_running = false;
+            m_finished = true;
+            return false;
+        }
+
+        uint64_t m_iterations;
+        uint64_t m_remaining = 0;
+        bool m_running = false;
+        bool m_finished = false;
+        std::chrono::steady_clock::time_point m_start;
+        std::chrono::nanoseconds m_elapsed{};
+    };
+
+    // The timings of one benchmark, all in nanoseconds per iteration
+    struct BenchmarkResult
+    {
+        std::string m_name;
+        uint64_t m_iterationsPerSample = 0;
+        std::vector<double> m_samples;
+        double m_mean = 0;
+        double m_median = 0;
+        double m_stddev = 0;
+        double m_min = 0;
+        // any checks in the benchmark that failed, in which case there are no timings
+        std::vector<Failure> m_failures;
+        [[nodiscard]] bool passed() const { return m_failures.empty(); }
+    };
+
+    // Receives the results as a run progresses, and writes them out in some form.  Calls are never made concurrently,
+    // and with --jobs or --isolate a test's testStarting is only called once it has finished.
+    // Derive from this and pass it to addReporter to get the results in some other form
+    class Reporter
+    {
+    public:
+        virtual ~Reporter() = default;
+        virtual void testStarting(const std::string& /*name*/) {}
+        virtual void testFinished(const TestResult& /*result*/) {}
+        virtual void benchmarkStarting(const std::string& /*name*/) {}
+        virtual void benchmarkFinished(const BenchmarkResult& /*result*/) {}
+        virtual void runFinished(const RunSummary& /*summary*/) {}
+    };
+
+    // Add a reporter to be used by every subsequent runAllTests2, as well as those picked with --output=
+    static void addReporter(std::shared_ptr<Reporter> reporter);
+
+    // Stop the compiler from optimising away the calculation of value
+    template <class T>
+    static void DoNotOptimize(const T& value)
+    {
+#if defined(__GNUC__) || defined(__clang__)
+        asm volatile("" : : "r,m"(value) : "memory");
+#else
+        static const volatile void* sink;
+        sink = &value;
+        _ReadWriteBarrier();
+#endif
+    }
+    template <class T>
+    static void DoNotOptimize(T& value)
+    {
+#if defined(__GNUC__) || defined(__clang__)
+        asm volatile("" : "+r,m"(value) : : "memory");
+#else
+        static volatile void* sink;
+        sink = &value;
+        _ReadWriteBarrier();
+#endif
+    }
+    // Force any pending writes to memory to actually happen
+    static void ClobberMemory()
+    {
+#if defined(__GNUC__) || defined(__clang__)
+        asm volatile("" : : : "memory");
+#else
+        _ReadWriteBarrier();
+#endif
+    }
+
+    // Run fn as a trial, whose failed checks are counted, and the count returned, but aren't reported and don't count
+    // against the test or the run.  For checking that a check of your own fails, or timing how long failing takes
+    static int runTrial(const std::function<void()>& fn);
+
+    // How close the elements must be for {EXPECT|ASSERT}_RANGE_NEAR.  Relative is a fraction of the larger of the two
+    // magnitudes, and ulps the number of representable values between them
+    struct Tolerance
+    {
+        enum Kind { ABSOLUTE, RELATIVE, ULPS };
+        Kind m_kind = ABSOLUTE;
+        double m_value = 0;
+        uint64_t m_ulps = 0;
+
+        static Tolerance absolute(double value) { return { ABSOLUTE, value, 0 }; }
+        static Tolerance relative(double value) { return { RELATIVE, value, 0 }; }
+        static Tolerance ulps(uint64_t value) { return { ULPS, 0, value }; }
+    };
+
+    // The base for TEST_F fixtures.  Each hides whichever of these it needs
+    class Fixture
+    {
+    public:
+        static void SetUpSuite() {}
+        static void TearDownSuite() {}
+        void SetUp() {}
+        void TearDown() {}
+    };
+
+    // Run a TEST_F's test on its fixture: SetUp, the body, then TearDown, which is run however the body ends, even when
+    // --max-failures stops it or it throws.  A SetUp that fails leaves the fixture unfit for the body, which is skipped,
+    // the test having failed already
+    template <class Test>
+    static void runFixtureTest(Test& test)
+    {
+        try
+        {
+            const int failsBefore = currentFails();
+            test.SetUp();
+            if (currentFails() == failsBefore)
+                test.TestBody();
+        }
+        catch (...)
+        {
+            // once the test has reached --max-failures TearDown's own failures stop it too, but it's what the body ended
+            // with that is passed on
+            try
+            {
+                test.TearDown();
+            }
+            catch (const TestAborted&)
+            {
+            }
+            throw;
+        }
+        test.TearDown();
+    }
+
+    // What the tests of a suite share: the functions run before the first and after the last of them
+    struct Suite
+    {
+        std::function<void()> m_setUp;
+        std::function<void()> m_tearDown;
+    };
+
+    // The suite of TEST_F(Fixture, ...), which is the same object in every translation unit
+    template <class F>
+    static const Suite* suite()
+    {
+        static const Suite fixtureSuite{ &F::SetUpSuite, &F::TearDownSuite };
+        return &fixtureSuite;
+    }
+
+    // A suite for tests registered at run time with registerTestFn
+    static const Suite* registerSuite(std::function<void()> setUpSuite, std::function<void()> tearDownSuite);
+
+    // What a TEST_ASYNC body returns, as can any coroutine that it co_awaits.  A task doesn't start until it is awaited
+    // (or the runner starts it), and when it finishes it carries straight on with whatever awaited it, passing on any
+    // exception it ended with
+    class Task
+    {
+    public:
+        struct promise_type
+        {
+            Task get_return_object() { return Task(std::coroutine_handle<promise_type>::from_promise(*this)); }
+            std::suspend_always initial_suspend() noexcept { return {}; }
+            auto final_suspend() noexcept
+            {
+                struct ContinueAwaiting
+                {
+                    bool await_ready() noexcept { return false; }
+                    std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> handle) noexcept
+                    {
+                        const auto awaiting = handle.promise().m_awaiting;
+                        return awaiting ? awaiting : std::noop_coroutine();
+                    }
+                    void await_resume() noexcept {}
+                };
+                return ContinueAwaiting{};
+            }
+            void return_void() {}
+            void unhandled_exception() { m_exception = std::current_exception(); }
+
+            std::coroutine_handle<> m_awaiting;
+            std::exception_ptr m_exception;
+        };
+
+        Task(Task&& other) noexcept
+            : m_handle(std::exchange(other.m_handle, {}))
+        {
+        }
+        Task& operator=(Task&&) = delete;
+        ~Task()
+        {
+            if (m_handle)
+                m_handle.destroy();
+        }
+
+        bool await_ready() const noexcept { return false; }
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept
+        {
+            m_handle.promise().m_awaiting = awaiting;
+            return m_handle;
+        }
+        void await_resume() const
+        {
+            if (m_handle.promise().m_exception)
+                std::rethrow_exception(m_handle.promise().m_exception);
+        }
+
+    private:
+        friend class PintTest;
+        friend class PintTestNS::Runner;
+        explicit Task(std::coroutine_handle<promise_type> handle)
+            : m_handle(handle)
+        {
+        }
+        std::coroutine_handle<promise_type> m_handle;
+    };
+
+    // co_await in a TEST_ASYNC to let the other tests on the event loop run until the time has come
+    struct SleepUntil
+    {
+        std::chrono::steady_clock::time_point m_deadline;
+        [[nodiscard]] bool await_ready() const { return m_deadline <= std::chrono::steady_clock::now(); }
+        bool await_suspend(std::coroutine_handle<> handle) const { return awaitTimer(handle, m_deadline); }
+        void await_resume() const {}
+    };
+    template <class Rep, class Period>
+    static SleepUntil sleepFor(std::chrono::duration<Rep, Period> duration)
+    {
+        return { std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(duration) };
+    }
+    static SleepUntil sleepUntil(std::chrono::steady_clock::time_point deadline)
+    {
+        return { deadline };
+    }
+
+    // co_await in a TEST_ASYNC to let the other tests run until the fd can be read (or written) without blocking, or
+    // has hung up or failed.  Waiting on fds needs epoll, so is Linux only
+    struct FdReady
+    {
+        int m_fd;
+        bool m_write;
+        [[nodiscard]] bool await_ready() const { return false; }
+        bool await_suspend(std::coroutine_handle<> handle) const { return awaitFd(handle, m_fd, m_write); }
+        void await_resume() const {}
+    };
+    static FdReady readable(int fd)
+    {
+        return { fd, false };
+    }
+    static FdReady writable(int fd)
+    {
+        return { fd, true };
+    }
+
+    // Run a TEST_ASYNC body to the end, on an event loop of its own on this thread, as part of the current test.  This
+    // is how one runs when it is run on its own, rather than with the others on the runner's loop
+    static void runTask(Task (*body)());
+
+    // A registered test (or benchmark).  TEST and BENCHMARK each define one of these as a static, whose constructor
+    // appends it to an intrusive list, so registration is a few pointer writes and allocates nothing.  The list head
+    // and tail are constant initialised, so registering from any translation unit's static initialisers is safe.
+    // Duplicate names are only looked for when the tests are run
+    template <class... Args>
+    class Registration
+    {
+    public:
+        using Fn = void (*)(Args...);
+        using AsyncFn = Task (*)();
+
+        Registration(const char* name, Fn fn, const Suite* suite = nullptr)
+            : m_name(name), m_fn(fn), m_suite(suite)
+        {
+            append();
+        }
+        // For TEST_ASYNC, whose fn runs the coroutine that async starts to the end with runTask, when the test isn't run
+        // along with the others on the runner's event loop
+        Registration(const char* name, Fn fn, AsyncFn async)
+            : m_name(name), m_fn(fn), m_async(async)
+        {
+            append();
+        }
+        // For registerTestFn/registerBenchmarkFn, which can take any callable
+        Registration(const char* name, const std::function<void(Args...)>* function, const Suite* suite = nullptr)
+            : m_name(name), m_function(function), m_suite(suite)
+        {
+            append();
+        }
+        Registration(const Registration&) = delete;
+        Registration& operator=(const Registration&) = delete;
+
+        void run(Args... args) const
+        {
+            if (m_fn)
+                m_fn(args...);
+            else
+                (*m_function)(args...);
+        }
+        [[nodiscard]] const char* name() const { return m_name; }
+        // null if the test isn't in a suite
+        [[nodiscard]] const Suite* suite() const { return m_suite; }
+        // null unless the test is a TEST_ASYNC
+        [[nodiscard]] AsyncFn async() const { return m_async; }
+        [[nodiscard]] const Registration* next() const { return m_next; }
+        static const Registration* first() { return s_head; }
+        static size_t count() { return s_count; }
+        // changes whenever a registration is added or removed, to tell whether anything worked out from them is stale
+        static uint64_t generation() { return s_generation; }
+
+    private:
+        friend class PintTestNS::Runner;
+
+        void append()
+        {
+            *s_tail = this;
+            s_tail = &m_next;
+            ++s_count;
+            ++s_generation;
+        }
+        // Take the registrations that unregister(registration) is true of out of the list, keeping the rest in order.
+        // For the tests of a library that --serve is about to unload
+        template <class Pred>
+        static void removeIf(Pred unregister)
+        {
+            Registration* registration = s_head;
+            s_head = nullptr;
+            s_tail = &s_head;
+            s_count = 0;
+            ++s_generation;
+            while (registration)
+            {
+                Registration* const next = std::exchange(registration->m_next, nullptr);
+                if (!unregister(static_cast<const Registration*>(registration)))
+                    registration->append();
+                registration = next;
+            }
+        }
+
+        const char* m_name;
+        Fn m_fn = nullptr;
+        const std::function<void(Args...)>* m_function = nullptr;
+        const Suite* m_suite = nullptr;
+        AsyncFn m_async = nullptr;
+        Registration* m_next = nullptr;
+
+        static inline Registration* s_head = nullptr;
+        static inline Registration** s_tail = &s_head;
+        static inline size_t s_count = 0;
+        static inline uint64_t s_generation = 0;
+    };
+    using TestNode = Registration<>;
+    using BenchmarkNode = Registration<BenchmarkState&>;
+
+    // Register a test at run time (or from a static initialiser), optionally in a suite from registerSuite.  Unlike
+    // TEST this allocates, to keep a copy of the name and the function
+    static bool registerTestFn(const char* name, std::function<void()> test, const Suite* suite = nullptr);
+    static bool registerBenchmarkFn(const char* name, std::function<void(BenchmarkState&)> benchmark);
+
+    static void selfTest();
+
+    // Called by the operator new replacements from PINTTEST_TRACK_ALLOCATIONS, so must not allocate
+    static void countAllocation(size_t bytes) noexcept
+    {
+        ++s_threadAllocations.m_allocations;
+        s_threadAllocations.m_bytes += bytes;
+    }
+    static void allocationTrackingInstalled() noexcept
+    {
+        s_trackingAllocations = true;
+    }
+    [[nodiscard]] static bool trackingAllocations() noexcept
+    {
+        return s_trackingAllocations;
+    }
+    // All the allocations made on this thread so far
+    [[nodiscard]] static AllocationCounts threadAllocations() noexcept
+    {
+        return s_threadAllocations;
+    }
+
+    // The process's resident set and its peak now, or null where /proc/self/status can't be read (Linux only)
+    [[nodiscard]] static std::optional<MemoryUsage> memoryUsage();
+    // Reset the peak resident set to what is resident now, so that the next peak read is of what has happened since.
+    // Not done while tests run concurrently, as it would spoil their peaks.  The peak that is cleared still counts
+    // towards the test's own, with --resource-usage.  Returns whether the peak was reset
+    static bool resetPeakMemory();
+
+private:
+
+    // The state of the test running on a thread, and the failures it has collected, which only the runner needs the
+    // insides of
+    struct Site;
+    struct SiteHash;
+    struct SiteFailures;
+    struct ThreadFailures;
+    struct TestState;
+
+    static inline std::atomic<unsigned> s_failuresPerSite = DEFAULT_FAILURES_PER_SITE;
+    static inline std::atomic<unsigned> s_maxFailures = 0;
+    static inline std::atomic<bool> s_updateSnapshots = false;
+    static inline std::atomic<uint64_t> s_testIds = 0;
+    static inline thread_local TestState* s_currentTest = nullptr;
+    // the test that this thread has been attached to with AttachToTest
+    static inline thread_local TestState* s_attachedTest = nullptr;
+    // the test that a thread which hasn't been attached belongs to, which is only known when tests aren't being run
+    // concurrently
+    static inline std::atomic<TestState*> s_soleTest = nullptr;
+    static inline std::atomic<bool> s_concurrentTests = false;
+
+public:
+
+    // The test running on the current thread (or the one it is attached to), to pass to the threads that the test
+    // starts
+    class TestHandle
+    {
+    public:
+        TestHandle() = default;
+    private:
+        friend class PintTest;
+        explicit TestHandle(TestState* state)
+            : m_state(state)
+        {
+        }
+        TestState* m_state = nullptr;
+    };
+    [[nodiscard]] static TestHandle currentTest()
+    {
+        return TestHandle(s_currentTest ? s_currentTest : s_attachedTest);
+    }
+
+    // Attributes the checks made on this thread, for as long as it exists, to a test from currentTest().  The thread must
+    // finish with the test (be joined) before the test ends
+    class AttachToTest
+    {
+    public:
+        explicit AttachToTest(TestHandle test)
+            : m_outer(std::exchange(s_attachedTest, test.m_state))
+        {
+        }
+        ~AttachToTest()
+        {
+            s_attachedTest = m_outer;
+        }
+        AttachToTest(const AttachToTest&) = delete;
+        AttachToTest& operator=(const AttachToTest&) = delete;
+    private:
+        TestState* m_outer;
+    };
+
+    // Call fn(threadIndex) repeatedly on each of threads threads (0 for one per core) for the duration, with the
+    // threads pinned to CPUs and released together.  The checks fn makes count against the current test, and the
+    // result is added to the test's
+    template <class Rep, class Period, class Fn>
+    static StressResult stress(unsigned threads, std::chrono::duration<Rep, Period> duration, Fn&& fn)
+    {
+        return runStress(threads, std::chrono::duration_cast<std::chrono::nanoseconds>(duration), std::numeric_limits<uint64_t>::max(), fn);
+    }
+    // As above, but each thread makes iterations calls
+    template <class Fn>
+    static StressResult stress(unsigned threads, uint64_t iterations, Fn&& fn)
+    {
+        return runStress(threads, std::chrono::nanoseconds::max(), iterations, fn);
+    }
+
+    // splitmix64, so that a seed gives the same sequence on every platform, which the standard engines' distributions
+    // don't promise
+    static uint64_t nextRandom(uint64_t& state)
+    {
+        uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        return z ^ (z >> 31);
+    }
+
+    // xoshiro256**, seeded with splitmix64, which the property generators draw from.  A few ns per number, and nothing
+    // to allocate, so a generator can make a new one for each case
+    class Random
+    {
+    public:
+        explicit Random(uint64_t seed)
+        {
+            for (auto& word : m_state)
+                word = nextRandom(seed);
+        }
+        uint64_t next()
+        {
+            const uint64_t result = std::rotl(m_state[1] * 5, 7) * 9;
+            const uint64_t shifted = m_state[1] << 17;
+            m_state[2] ^= m_state[0];
+            m_state[3] ^= m_state[1];
+            m_state[1] ^= m_state[2];
+            m_state[0] ^= m_state[3];
+            m_state[2] ^= shifted;
+            m_state[3] = std::rotl(m_state[3], 45);
+            return result;
+        }
+        // Uniform in [0, bound), or any value if bound is 0.  Values below 2^64 % bound are rejected, so that every
+        // remainder is equally likely
+        uint64_t below(uint64_t bound)
+        {
+            if (bound == 0)
+                return next();
+            const uint64_t threshold = (0 - bound) % bound;
+            while (true)
+            {
+                const uint64_t value = next();
+                if (value >= threshold)
+                    return value % bound;
+            }
+        }
+        // Uniform in [0, 1)
+        double unit()
+        {
+            return static_cast<double>(next() >> 11) * 0x1.0p-53;
+        }
+    private:
+        std::array<uint64_t, 4> m_state{};
+    };
+
+    // The generators that the arguments of a property are made by (see PROPERTY)
+    struct Gen;
+
+    // The name of a property, and where it is, for the failure that checkProperty reports.  Made from the name, so that
+    // the location is of the code that passed the name in
+    struct PropertyName
+    {
+        PropertyName(const char* name, std::source_location location = std::source_location::current())
+            : m_name(name), m_location(location)
+        {
+        }
+        const char* m_name;
+        std::source_location m_location;
+    };
+
+    // Check that body passes for --property-cases cases, each called with a value from each of the generators.  The
+    // first case that fails is shrunk, by trying simpler values for it that still fail, and only the smallest is
+    // reported, with the run's seed, as a failure of the current test
+    template <class Body, class... Gens>
+    static void checkProperty(PropertyName name, const Body& body, const Gens&... generators);
+
+    // Register a property at run time, as a test that checks it.  Like registerTestFn this allocates
+    template <class Body, class... Gens>
+    static bool registerProperty(PropertyName name, Body body, Gens... generators)
+    {
+        return registerTestFn(name.m_name, [name = std::string(name.m_name), location = name.m_location, body = std::move(body), generators...]()
+            {
+                checkProperty(PropertyName(name.c_str(), location), body, generators...);
+            });
+    }
+
+    // The seed of the run, from --seed= or picked afresh, which each property's cases are generated from
+    [[nodiscard]] static uint64_t seed() { return s_seed; }
+
+    // Thrown by a check to stop the test, with --max-failures
+    struct TestAborted
+    {
+    };
+
+    // Called by the expects and asserts when a check fails
+    static void recordFailure();
+
+    // As above, for the check at location.  Returns whether the failure should be reported, which it isn't once the
+    // check has failed s_failuresPerSite times in the test - the check then skips formatting the message, and the
+    // failures are only counted, for leaveTest to summarise.  With --max-failures, stops the test once it has failed
+    // that many checks
+    static bool recordFailure(const std::source_location& location);
+
+    // Called by MsgWriter with the details of a failed check.  If the check was made on a thread that isn't running a
+    // test, and can't be attributed to one, then there's nothing to attach it to, so it is written straight out
+    static void recordFailureMessage(Failure failure);
+
+    // Create from argc/argv as follows: std::vector<std::string_view> args(argv, argv + argc);
+    // returns a pair of ints - the number of tests ran, and the number of tests failed.  If first is negative, then the arguments
+    // (or the registered test names) are invalid
+    static std::pair<int,int> runAllTests2(const std::vector<std::string_view>& args);
+
+    // Create from argc/argv as follows: std::vector<std::string_view> args(argv, argv + argc);
+    static int runAllTests(const std::vector<std::string_view>& args)
+    {
+        auto [_, failed] = runAllTests2(args);
+        return failed;
+    }
+    /** UB if argv doesn't contain argc strings.  Which is why the version taking a vector is better.  This just makes it easier to use */
+    static int runAllTests(int argc, const char* argv[])
+    {
+        return runAllTests(std::vector<std::string_view>(argv, argv + argc));
+    }
+
+    // Run a single test, writing the results to std::cout
+    static void runTest(std::function<void()> testFn, const std::string& testCase);
+
+    // Run a single test and return the result, without writing anything out
+    static TestResult executeTest(const TestNode& test);
+    static TestResult executeTest(const std::function<void()>& testFn, const std::string& testCase);
+
+private:
+
+    // Whether executeTest reads the hardware counters, from --perf-counters
+    static inline std::atomic<bool> s_perfCounters = false;
+    // Whether executeTest measures the tests' resource usage, from --resource-usage
+    static inline std::atomic<bool> s_resourceUsage = false;
+
+    // Counted by countAllocation.  Defined after the class as constinit, so that operator new doesn't go through a
+    // thread_local initialiser
+    static thread_local AllocationCounts s_threadAllocations;
+    static inline std::atomic<bool> s_trackingAllocations = false;
+
+    // Each thread stops once it has made iterations calls, or the duration has passed
+    template <class Fn>
+    static StressResult runStress(unsigned threads, std::chrono::nanoseconds duration, uint64_t iterations, Fn& fn)
+    {
+        return runStressThreads(threads, duration, [&fn, iterations](unsigned t, StressThread& thread, const std::chrono::steady_clock::time_point& deadline)
+            {
+                auto batchStart = std::chrono::steady_clock::now();
+                const auto start = batchStart;
+                while (thread.m_operations < iterations)
+                {
+                    const uint64_t batch = std::min(STRESS_BATCH, iterations - thread.m_operations);
+                    for (uint64_t i = 0; i < batch; ++i)
+                        fn(t);
+                    const auto batchEnd = std::chrono::steady_clock::now();
+                    thread.m_operations += batch;
+                    thread.m_maxLatency = std::max(thread.m_maxLatency, std::chrono::duration_cast<std::chrono::nanoseconds>(batchEnd - batchStart) / static_cast<int64_t>(batch));
+                    batchStart = batchEnd;
+                    if (batchEnd >= deadline)
+                        break;
+                }
+                thread.m_elapsed = batchStart - start;
+            });
+    }
+    // Start the threads, pinned to CPUs, and once they are all ready release them together to each call
+    // body(threadIndex, thread, deadline).  The result is added to the current test's
+    static StressResult runStressThreads(unsigned threads, std::chrono::nanoseconds duration,
+        const std::function<void(unsigned, StressThread&, const std::chrono::steady_clock::time_point&)>& body);
+
+    static constexpr unsigned DEFAULT_PROPERTY_CASES = 1000;
+    // Property cases are checked this many at a time, which is what --property-jobs shares out between the threads
+    static constexpr uint64_t PROPERTY_CHUNK = 1024;
+    // The sizes that a case's containers are limited to go round from 0 up to this, so that the first cases are small
+    static constexpr size_t PROPERTY_MAX_SIZE = 100;
+    // Give up shrinking after this many steps, each to a simpler case that still fails
+    static constexpr unsigned PROPERTY_MAX_SHRINKS = 1000;
+
+    static inline std::atomic<uint64_t> s_seed = 0;
+    // The --repeat iteration (from 0) of the test running on this thread.  Its properties are checked with the run's
+    // seed plus this, so that every iteration checks new cases, which --seed= alone makes again
+    static inline thread_local unsigned s_iteration = 0;
+    static inline std::atomic<unsigned> s_propertyCases = DEFAULT_PROPERTY_CASES;
+    static inline std::atomic<unsigned> s_propertyJobs = 1;
+
+    // The number of checks that have failed so far in the test (or trial) running on this thread
+    static int currentFails();
+    // Note that the test has reached --max-failures, at the check in file and line, and stop it by throwing TestAborted
+    [[noreturn]] static void stopTest(std::string file, uint_least32_t line);
+    // Call run(first, last, current) for chunks of the cases [0, cases) of a property, on --property-jobs threads,
+    // each chunk as a trial, which stops at the first case that fails, with current set to it.  Returns the first case
+    // that failed, or cases if none did
+    static uint64_t runPropertyCases(uint64_t cases, const std::function<void(uint64_t, uint64_t, uint64_t&)>& run);
+
+    // Have this thread's event loop resume handle at the deadline, or once the fd is ready, as part of the test that is
+    // current now.  Return whether handle is to be suspended until then: a timer with no event loop to go on just sleeps,
+    // and an fd that can't be waited on fails the test
+    static bool awaitTimer(std::coroutine_handle<> handle, std::chrono::steady_clock::time_point deadline);
+    static bool awaitFd(std::coroutine_handle<> handle, int fd, bool write);
+};
+
+namespace PintTestNS
+{
+    // Calls write to stream value into a std::ostringstream, and returns what it wrote.  Part of the runner, so that
+    // formatting a value only needs <ostream>
+    PINTTEST_RUNNER_INLINE std::string streamToString(void (*write)(std::ostream&, const void*), const void* value);
+
+    // GetString returns the stream version of the object if streaming is supported, otherwise just returns the address
+    //@todo - maybe do something about const char*
+    template <typename T> concept Streamable = requires(std::ostream& os, T value) { { os << value }; };
+    template <typename T> requires (Streamable<T>)
+        inline auto constexpr GetString(const T& value)
+    {
+        return streamToString([](std::ostream& os, const void* streamed) { os << *static_cast<const T*>(streamed); }, &value);
+    }
+    template <typename T> requires (!Streamable<T>)
+        inline auto constexpr GetString(const T& value)
+    {
+        return to_string(&value);
+    }
+
+    // A value as a property's failure reports it: quoted if it's text, and as {a, b, ...} if it's a range that can't be
+    // streamed
+    template <class T>
+    std::string describeValue(const T& value)
+    {
+        if constexpr (std::is_same_v<T, char>)
+            return std::string("'") + value + "'";
+        else if constexpr (std::is_convertible_v<const T&, std::string_view>)
+            return "\"" + std::string(std::string_view(value)) + "\"";
+        else if constexpr (!Streamable<T> && std::ranges::input_range<const T>)
+        {
+            std::string text = "{";
+            for (const auto& element : value)
+                text += (text.size() > 1 ? ", " : "") + describeValue(element);
+            return text + "}";
+        }
+        else
+            return GetString(value);
+    }
+
+    // The function type of a PROPERTY's body, given the type of a tuple of its generators: each parameter is a value
+    // of its generator's, numbers by value and everything else by const reference
+    template <class T>
+    using PropertyParameter = std::conditional_t<std::is_arithmetic_v<T>, T, const T&>;
+    template <class Generators>
+    struct PropertyFunctionOf;
+    template <class... Gens>
+    struct PropertyFunctionOf<std::tuple<Gens...>>
+    {
+        using type = void(PropertyParameter<typename Gens::value_type>...);
+    };
+    template <class Generators>
+    using PropertyFunction = typename PropertyFunctionOf<Generators>::type;
+
+    // Captures the error msessage, for when the test fails.
+    // A passing check returns a default constructed Msg, which is just an empty string (no allocation) and a flag, so
+    // that the compiler can reduce a pass to the comparison and a branch.  Nothing is formatted unless the check fails,
+    // and that includes anything streamed in with <<, as the macros only evaluate that on failure
+    class Msg
+    {
+    public:
+        Msg() = default;
+        Msg(std::string value)
+            : m_Empty(value.empty()), m_Str(std::move(value))
+        {
+        }
+        // A failure that is only to be counted, not reported, so nothing streamed into it is formatted
+        static Msg unreportedFailure()
+        {
+            Msg msg;
+            msg.m_Empty = false;
+            msg.m_Unreported = true;
+            return msg;
+        }
+        template <class T>
+        Msg& operator<<(const T& value)
+        {
+            if (!m_Unreported)
+                m_Str += GetString(value);
+            return *this;
+        }
+        friend std::ostream& operator<<(std::ostream& ss, const Msg& value)
+        {
+            ss << value.m_Str;
+            return ss;
+        }
+        void clear()
+        {
+            m_Str.clear();
+        }
+        [[nodiscard]] std::string getString() const { return m_Str; }
+        [[nodiscard]] std::string takeString() { return std::move(m_Str); }
+        [[nodiscard]] bool empty() const { return m_Empty; }
+        [[nodiscard]] bool unreported() const { return m_Unreported; }
+    private:
+        bool m_Empty = true;
+        bool m_Unreported = false;
+        std::string m_Str;
+    };
+
+    // function to create the error string (not including any extra values passed in via <<).  Kept out of line so
+    // that the passing path of each check stays small enough to inline
+    // Each check takes the location it's made at as a defaulted last parameter, so that the failures of each check can be
+    // counted, and only the first few formatted
+    template<class L, class R>
+    PINTTEST_NOINLINE Msg createFailureString(const char* prefix, const L& l, const R& r, const char* pL, const char* pR, const std::source_location& location)
+    {
+        if (!PintTest::recordFailure(location))
+            return Msg::unreportedFailure();
+        return std::string("\n") + pL + " " + prefix + " " + pR + "\nExpected: " + GetString(l) + "\n" + "Actual: " + GetString(r) + "\n";
+    }
+
+    template<class L, class R>
+    Msg createCompareString(bool pass, const char* prefix, const L& l, const R& r, const char* pL, const char* pR, const std::source_location& location)
+    {
+        if (pass) [[likely]]
+            return {};
+        return createFailureString(prefix, l, r, pL, pR, location);
+    }
+
+    PINTTEST_RUNNER_COLD Msg createFailureStringNear(double l, double r, const char* pL, const char* pR, const char* pTolerance, const std::source_location& location);
+
+    inline Msg createCompareStringNear(bool pass, double l, double r, const char* pL, const char* pR, const char* pTolerance, const std::source_location& location)
+    {
+        if (pass) [[likely]]
+            return {};
+        return createFailureStringNear(l, r, pL, pR, pTolerance, location);
+    }
+
+    // Test true - return an empty Msg if true, or a Msg with the error message in it if false
+    template<class T>
+    Msg compTrue(const T& t, const char* pT, std::source_location location = std::source_location::current())
+    {
+        return createCompareString((t), "is true", t, true, pT, "true", location);
+    }
+    // Test false - return an empty Msg if false, or a Msg with the error message in it if true
+    template<class T>
+    Msg compFalse(const T& t, const char* pT, std::source_location location = std::source_location::current())
+    {
+        return createCompareString(!(t), "is false", t, false, pT, "false", location);
+    }
+
+    // Test equals - return an empty Msg if pass, or a Msg with the error message in it if failed
+    template<class L, class R>
+    Msg compEq(const L& l, const R& r, const char* pL, const char* pR, std::source_location location = std::source_location::current())
+    {
+        return createCompareString((l == r), "==", l, r, pL, pR, location);
+    }
+    // Test not equals - return an empty Msg if pass, or a Msg with the error message in it if failed
+    template<class L, class R>
+    Msg compNe(const L& l, const R& r, const char* pL, const char* pR, std::source_location location = std::source_location::current())
+    {
+        return createCompareString(!(l == r), "!=", l, r, pL, pR, location);
+    }
+
+    // Test geater than - return an empty Msg if pass, or a Msg with the error message in it if failed
+    template<class L, class R>
+    Msg compGt(const L& l, const R& r, const char* pL, const char* pR, std::source_location location = std::source_location::current())
+    {
+        return createCompareString((l > r), ">", l, r, pL, pR, location);
+    }
+    // Test less than - return an empty Msg if pass, or a Msg with the error message in it if failed
+    template<class L, class R>
+    Msg compLt(const L& l, const R& r, const char* pL, const char* pR, std::source_location location = std::source_location::current())
+    {
+        return createCompareString((l < r), "<", l, r, pL, pR, location);
+    }
+    // Test geater than or equal to - return an empty Msg if pass, or a Msg with the error message in it if failed
+    template<class L, class R>
+    Msg compGe(const L& l, const R& r, const char* pL, const char* pR, std::source_location location = std::source_location::current())
+    {
+        return createCompareString((l >= r), ">=", l, r, pL, pR, location);
+    }
+    // Test less than or equal to - return an empty Msg if pass, or a Msg with the error message in it if failed
+    template<class L, class R>
+    Msg compLe(const L& l, const R& r, const char* pL, const char* pR, std::source_location location = std::source_location::current())
+    {
+        return createCompareString((l <= r), "<=", l, r, pL, pR, location);
+    }
+
+    // Test for nearness with doubles/floats - return an empty Msg if pass, or a Msg with the error message in it if failed
+    inline Msg compNear(double l, double r, double tolerance, const char* pL, const char* pR, const char* pTolerance, std::source_location location = std::source_location::current())
+    {
+        const double diff = l > r ? l - r : r - l;
+        return createCompareStringNear(diff < tolerance, l, r, pL, pR, pTolerance, location);
+    }
+
+    // Check that the percentile of the latencies in a LatencyRecorder (100 for the max) is below limit, reporting the
+    // recorder with the test either way.  The recorder is reported by its own name, or if it hasn't got one, as written
+    PINTTEST_RUNNER_COLD Msg createFailureStringLatency(const PintTest::LatencyRecorder& recorder, double percentile, std::chrono::nanoseconds actual,
+        std::chrono::nanoseconds limit, const char* pRecorder, const char* pLimit, const std::source_location& location);
+
+    template <class Rep, class Period>
+    Msg compLatencyLt(const PintTest::LatencyRecorder& recorder, double percentile, std::chrono::duration<Rep, Period> limit, const char* pRecorder, const char* pLimit, std::source_location location = std::source_location::current())
+    {
+        recorder.report(recorder.name().empty() ? std::string(pRecorder) : recorder.name());
+        const auto actual = recorder.percentile(percentile);
+        const auto limitNs = std::chrono::duration_cast<std::chrono::nanoseconds>(limit);
+        if (actual < limitNs) [[likely]]
+            return {};
+        return createFailureStringLatency(recorder, percentile, actual, limitNs, pRecorder, pLimit, location);
+    }
+
+    // The range checks.  The passing path is kept to a single pass over the data, in blocks with no early out within a
+    // block so that the compiler can vectorise it: contiguous ranges of integers (anything whose value is its bytes) are
+    // just memcmp'd.  Only when something doesn't match is the data gone over again to work out what to report
+    constexpr size_t RANGE_BLOCK_SIZE = 1024;
+    constexpr size_t RANGE_WINDOW_BEFORE = 2;
+    constexpr size_t RANGE_WINDOW_AFTER = 5;
+
+    // The type the range checks do their arithmetic in: the wider of two floating point types, otherwise double
+    template <class A, class B>
+    using RangeCompute = std::conditional_t<std::is_floating_point_v<std::common_type_t<A, B>>, std::common_type_t<A, B>, double>;
+
+    // The index of the first pair of elements that isn't within(a, b), or the size of the shorter range if they all are.
+    // Whole blocks are checked with a fixed trip count and no branch, which the compiler will vectorise even at -O2.
+    // The count of elements outside is kept in the same floating point type as the elements, as with SSE2 a comparison
+    // of doubles only vectorises if its result stays the same width, and in four separate counts, as floating point
+    // sums can't be reordered so a single count would make every addition wait for the one before
+    template <class A, class B, class Within>
+    size_t rangeFirstMismatch(const A& a, const B& b, const Within& within)
+    {
+        if constexpr (std::ranges::contiguous_range<const A> && std::ranges::contiguous_range<const B>
+            && std::ranges::sized_range<const A> && std::ranges::sized_range<const B>)
+        {
+            const auto* const aData = std::ranges::data(a);
+            const auto* const bData = std::ranges::data(b);
+            const auto size = static_cast<size_t>(std::min<uint64_t>(std::ranges::size(a), std::ranges::size(b)));
+            using AValue = std::ranges::range_value_t<const A>;
+            using BValue = std::ranges::range_value_t<const B>;
+            using Count = std::conditional_t<std::is_floating_point_v<AValue> && std::is_floating_point_v<BValue>, RangeCompute<AValue, BValue>, unsigned>;
+            static_assert(RANGE_BLOCK_SIZE % 4 == 0);
+            size_t start = 0;
+            for (; start + RANGE_BLOCK_SIZE <= size; start += RANGE_BLOCK_SIZE)
+            {
+                Count outside0 = 0;
+                Count outside1 = 0;
+                Count outside2 = 0;
+                Count outside3 = 0;
+                for (size_t i = start; i < start + RANGE_BLOCK_SIZE; i += 4)
+                {
+                    outside0 += within(aData[i], bData[i]) ? Count(0) : Count(1);
+                    outside1 += within(aData[i + 1], bData[i + 1]) ? Count(0) : Count(1);
+                    outside2 += within(aData[i + 2], bData[i + 2]) ? Count(0) : Count(1);
+                    outside3 += within(aData[i + 3], bData[i + 3]) ? Count(0) : Count(1);
+                }
+                if (outside0 + outside1 + outside2 + outside3 != 0) [[unlikely]]
+                    break;
+            }
+            for (; start < size; ++start)
+                if (!within(aData[start], bData[start]))
+                    return start;
+            return size;
+        }
+        else
+        {
+            size_t index = 0;
+            auto bIt = std::ranges::begin(b);
+            for (auto aIt = std::ranges::begin(a); aIt != std::ranges::end(a) && bIt != std::ranges::end(b); ++aIt, ++bIt, ++index)
+                if (!within(*aIt, *bIt))
+                    break;
+            return index;
+        }
+    }
+
+    template <class R>
+    uint64_t rangeSize(const R& r)
+    {
+        if constexpr (std::ranges::sized_range<const R>)
+            return static_cast<uint64_t>(std::ranges::size(r));
+        else
+            return static_cast<uint64_t>(std::ranges::distance(r));
+    }
+
+    // Floating point values are written with enough digits to tell apart values that are only an ulp or two apart
+    template <class T>
+    std::string rangeValueString(const T& value)
+    {
+        if constexpr (std::is_floating_point_v<T>)
+        {
+            char buffer[64];
+            const auto result = std::to_chars(buffer, buffer + sizeof(buffer), value);
+            return std::string(buffer, result.ptr);
+        }
+        else
+        {
+            return GetString(value);
+        }
+    }
+
+    // The failure message: the sizes if they differ, how many elements don't match, and the elements around the first
+    // one that doesn't, marked with a *
+    template <class A, class B, class Within, class Describe>
+    PINTTEST_NOINLINE Msg createRangeFailure(const A& a, const B& b, const Within& within, const Describe& describe, const std::string& check, const std::source_location& location)
+    {
+        if (!PintTest::recordFailure(location))
+            return Msg::unreportedFailure();
+        const auto aSize = rangeSize(a);
+        const auto bSize = rangeSize(b);
+        uint64_t mismatches = 0;
+        uint64_t first = std::min(aSize, bSize);
+        {
+            uint64_t index = 0;
+            auto bIt = std::ranges::begin(b);
+            for (auto aIt = std::ranges::begin(a); aIt != std::ranges::end(a) && bIt != std::ranges::end(b); ++aIt, ++bIt, ++index)
+            {
+                if (!within(*aIt, *bIt))
+                {
+                    first = std::min(first, index);
+                    ++mismatches;
+                }
+            }
+        }
+
+        std::string message = "\n" + check + "\n";
+        if (aSize != bSize)
+            message += "Sizes: " + std::to_string(aSize) + " and " + std::to_string(bSize) + "\n";
+        if (mismatches == 0)
+            return message;
+        message += std::to_string(mismatches) + " of " + std::to_string(std::min(aSize, bSize)) + " elements differ, the first at index " + std::to_string(first) + ":\n";
+        const auto windowStart = first > RANGE_WINDOW_BEFORE ? first - RANGE_WINDOW_BEFORE : 0;
+        uint64_t index = 0;
+        auto bIt = std::ranges::begin(b);
+        for (auto aIt = std::ranges::begin(a); aIt != std::ranges::end(a) && bIt != std::ranges::end(b) && index <= first + RANGE_WINDOW_AFTER; ++aIt, ++bIt, ++index)
+        {
+            if (index < windowStart)
+                continue;
+            message += within(*aIt, *bIt) ? "  [" : "* [";
+            message += std::to_string(index) + "] " + rangeValueString(*aIt) + " vs " + rangeValueString(*bIt) + describe(*aIt, *bIt) + "\n";
+        }
+        return message;
+    }
+
+    template <class A, class B>
+    Msg compRangeEq(const A& a, const B& b, const char* pA, const char* pB, std::source_location location = std::source_location::current())
+    {
+        const auto equal = [](const auto& l, const auto& r) { return l == r; };
+        using AValue = std::ranges::range_value_t<const A>;
+        using BValue = std::ranges::range_value_t<const B>;
+        bool pass = false;
+        if constexpr (std::ranges::contiguous_range<const A> && std::ranges::contiguous_range<const B>
+            && std::ranges::sized_range<const A> && std::ranges::sized_range<const B>
+            && std::is_same_v<AValue, BValue> && std::has_unique_object_representations_v<AValue>)
+        {
+            pass = std::ranges::size(a) == std::ranges::size(b)
+                && (std::ranges::size(a) == 0 || std::memcmp(std::ranges::data(a), std::ranges::data(b), std::ranges::size(a) * sizeof(AValue)) == 0);
+        }
+        else
+        {
+            const auto aSize = rangeSize(a);
+            pass = aSize == rangeSize(b) && rangeFirstMismatch(a, b, equal) == aSize;
+        }
+        if (pass) [[likely]]
+            return {};
+        return createRangeFailure(a, b, equal, [](const auto&, const auto&) { return std::string(); }, std::string(pA) + " == " + pB + " (ranges)", location);
+    }
+
+    // The distance in ulps between two floats or doubles, by mapping their bits onto integers that are in the same
+    // order as the values
+    template <class T>
+    uint64_t ulpDistance(T l, T r)
+    {
+        using Int = std::conditional_t<sizeof(T) == sizeof(int32_t), int32_t, int64_t>;
+        using UInt = std::make_unsigned_t<Int>;
+        const auto ordered = [](T value)
+            {
+                const auto bits = std::bit_cast<Int>(value);
+                return bits < 0 ? static_cast<Int>(std::numeric_limits<Int>::min() - bits) : bits;
+            };
+        const auto lBits = ordered(l);
+        const auto rBits = ordered(r);
+        return lBits > rBits ? static_cast<UInt>(lBits) - static_cast<UInt>(rBits) : static_cast<UInt>(rBits) - static_cast<UInt>(lBits);
+    }
+
+    template <class A, class B, class Tol>
+    Msg compRangeNear(const A& a, const B& b, const Tol& tol, const char* pA, const char* pB, const char* pTolerance, std::source_location location = std::source_location::current())
+    {
+        using AValue = std::ranges::range_value_t<const A>;
+        using BValue = std::ranges::range_value_t<const B>;
+        static_assert(std::is_arithmetic_v<AValue> && std::is_arithmetic_v<BValue>, "RANGE_NEAR compares ranges of numbers");
+        using Compute = RangeCompute<AValue, BValue>;
+        PintTest::Tolerance tolerance;
+        if constexpr (std::is_arithmetic_v<Tol>)
+            tolerance = PintTest::Tolerance::absolute(static_cast<double>(tol));
+        else
+            tolerance = tol;
+
+        const auto check = [&] { return std::string(pA) + " == " + pB + " (ranges, within " + pTolerance + ")"; };
+        const auto aSize = rangeSize(a);
+        const auto compare = [&](const auto& within, const auto& describe) -> Msg
+            {
+                if (aSize == rangeSize(b) && rangeFirstMismatch(a, b, within) == aSize) [[likely]]
+                    return {};
+                return createRangeFailure(a, b, within, describe, check(), location);
+            };
+        const auto describeDiff = [](const auto& l, const auto& r) { return " (diff " + rangeValueString(static_cast<double>(l) - static_cast<double>(r)) + ")"; };
+        switch (tolerance.m_kind)
+        {
+        case PintTest::Tolerance::ABSOLUTE:
+        {
+            const auto absolute = static_cast<Compute>(tolerance.m_value);
+            return compare([absolute](const auto& l, const auto& r)
+                {
+                    const auto cl = static_cast<Compute>(l);
+                    const auto cr = static_cast<Compute>(r);
+                    return (cl == cr) | (std::abs(cl - cr) <= absolute);
+                }, describeDiff);
+        }
+        case PintTest::Tolerance::RELATIVE:
+        {
+            const auto relative = static_cast<Compute>(tolerance.m_value);
+            return compare([relative](const auto& l, const auto& r)
+                {
+                    const auto cl = static_cast<Compute>(l);
+                    const auto cr = static_cast<Compute>(r);
+                    return (cl == cr) | (std::abs(cl - cr) <= relative * std::max(std::abs(cl), std::abs(cr)));
+                }, describeDiff);
+        }
+        case PintTest::Tolerance::ULPS:
+        {
+            if constexpr (std::is_same_v<AValue, BValue> && (std::is_same_v<AValue, float> || std::is_same_v<AValue, double>))
+            {
+                const auto ulps = tolerance.m_ulps;
+                return compare([ulps](AValue l, AValue r) { return (l == r) | ((l == l) & (r == r) & (ulpDistance(l, r) <= ulps)); },
+                    [](AValue l, AValue r) { return " (" + (l == l && r == r ? std::to_string(ulpDistance(l, r)) : std::string("NaN")) + " ulps)"; });
+            }
+            else
+            {
+                if (!PintTest::recordFailure(location))
+                    return Msg::unreportedFailure();
+                return "\n" + check() + "\nulps can only be compared between ranges of the same floating point type\n";
+            }
+        }
+        }
+        return {};
+    }
+
+    // The file checks take anything that a std::filesystem::path can be made from, and pass it on as a string, so that
+    // only the runner needs <filesystem>
+    template <class Path>
+    std::string pathString(const Path& path)
+    {
+        if constexpr (requires { path.string(); })
+            return path.string();
+        else
+            return std::string(path);
+    }
+
+    PINTTEST_RUNNER_INLINE Msg compFileEqPaths(const std::string& expected, const std::string& actual, const char* pExpected, const char* pActual,
+        const std::source_location& location);
+    PINTTEST_RUNNER_INLINE Msg compSnapshotBytes(std::string_view name, std::span<const unsigned char> bytes, const char* pName, const char* pBytes,
+        const std::source_location& location);
+
+    template <class Expected, class Actual>
+    Msg compFileEq(const Expected& expected, const Actual& actual, const char* pExpected, const char* pActual,
+        std::source_location location = std::source_location::current())
+    {
+        return compFileEqPaths(pathString(expected), pathString(actual), pExpected, pActual, location);
+    }
+
+    template <class Bytes>
+    Msg compSnapshot(std::string_view name, const Bytes& bytes, const char* pName, const char* pBytes, std::source_location location = std::source_location::current())
+    {
+        static_assert(std::ranges::contiguous_range<const Bytes> && std::ranges::sized_range<const Bytes>
+            && std::is_trivially_copyable_v<std::ranges::range_value_t<const Bytes>>, "SNAPSHOT compares a contiguous range of trivially copyable values");
+        const std::span<const unsigned char> actual(reinterpret_cast<const unsigned char*>(std::ranges::data(bytes)),
+            std::ranges::size(bytes) * sizeof(std::ranges::range_value_t<const Bytes>));
+        return compSnapshotBytes(name, actual, pName, pBytes, location);
+    }
+
+    // Reports the failure of the check made at location, with the message it built, unless it is only to be counted
+    PINTTEST_RUNNER_COLD void reportFailure(const std::source_location& location, Msg& message);
+
+    // The failure path of the checks, which is kept to a call, as there is one of these for every check
+    class MsgWriter
+    {
+    public:
+
+        explicit MsgWriter(const std::source_location& location)
+            : m_location(location)
+        {
+        }
+        void operator=(Msg& str)
+        {
+            reportFailure(m_location, str);
+        }
+    private:
+        std::source_location m_location;
+    };
+    class AllocationScope
+    {
+    public:
+        AllocationScope(uint64_t limit, const char* pLimit, std::source_location location = std::source_location::current())
+            : m_limit(limit), m_pLimit(pLimit), m_location(location)
+        {
+        }
+        // A block left early, by break or return, is checked here instead, unless an exception is leaving it
+        ~AllocationScope() noexcept(false)
+        {
+            if (m_pass != 1 || std::uncaught_exceptions() != m_exceptions)
+                return;
+            next();
+            if (auto message = check(); !message.empty())
+                reportFailure(m_location, message);
+        }
+        AllocationScope(const AllocationScope&) = delete;
+        AllocationScope& operator=(const AllocationScope&) = delete;
+        bool next()
+        {
+            ++m_pass;
+            if (m_pass == 1)
+                m_before = PintTest::threadAllocations();
+            else if (m_pass == 2)
+                m_after = PintTest::threadAllocations();
+            return m_pass <= 2;
+        }
+        [[nodiscard]] bool inBlock() const { return m_pass == 1; }
+        Msg check() const
+        {
+            if (!PintTest::trackingAllocations())
+            {
+                if (!PintTest::recordFailure(m_location))
+                    return Msg::unreportedFailure();
+                return std::string("\nAllocations can't be checked: define PINTTEST_TRACK_ALLOCATIONS in one translation unit to count them\n");
+            }
+            const auto allocations = m_after.m_allocations - m_before.m_allocations;
+            if (allocations <= m_limit) [[likely]]
+                return {};
+            return createFailure(allocations, m_after.m_bytes - m_before.m_bytes);
+        }
+    private:
+        PINTTEST_NOINLINE Msg createFailure(uint64_t allocations, uint64_t bytes) const
+        {
+            if (!PintTest::recordFailure(m_location))
+                return Msg::unreportedFailure();
+            return "\nallocations <= " + std::string(m_pLimit) + "\nExpected: at most " + std::to_string(m_limit) + "\nActual: "
+                + std::to_string(allocations) + " (" + std::to_string(bytes) + " bytes)\n";
+        }
+
+        uint64_t m_limit;
+        const char* m_pLimit;
+        std::source_location m_location;
+        int m_exceptions = std::uncaught_exceptions();
+        int m_pass = 0;
+        PintTest::AllocationCounts m_before;
+        PintTest::AllocationCounts m_after;
+    };
+    // The growth of the peak resident set over a block.  The peak is reset before the block where it can be, and where
+    // it can't, growth that doesn't take the process above its earlier peak isn't seen
+    class MemoryScope
+    {
+    public:
+        MemoryScope(uint64_t limit, const char* pLimit, std::source_location location = std::source_location::current())
+            : m_limit(limit), m_pLimit(pLimit), m_location(location)
+        {
+        }
+        bool next()
+        {
+            ++m_pass;
+            if (m_pass == 1)
+            {
+                PintTest::resetPeakMemory();
+                m_before = PintTest::memoryUsage();
+            }
+            else if (m_pass == 2)
+            {
+                m_after = PintTest::memoryUsage();
+            }
+            return m_pass <= 2;
+        }
+        [[nodiscard]] bool inBlock() const { return m_pass == 1; }
+        Msg check() const
+        {
+            if (!m_before || !m_after)
+            {
+                if (!PintTest::recordFailure(m_location))
+                    return Msg::unreportedFailure();
+                return std::string("\nThe resident set can't be checked: it's read from /proc/self/status, which is Linux only\n");
+            }
+            const auto growth = m_after->m_peakRss > m_before->m_peakRss ? m_after->m_peakRss - m_before->m_rss : 0;
+            if (growth <= m_limit) [[likely]]
+                return {};
+            return createFailure(growth);
+        }
+    private:
+        PINTTEST_NOINLINE Msg createFailure(uint64_t growth) const
+        {
+            if (!PintTest::recordFailure(m_location))
+                return Msg::unreportedFailure();
+            return "\npeak RSS growth <= " + std::string(m_pLimit) + "\nExpected: at most " + std::to_string(m_limit) + " bytes\nActual: "
+                + std::to_string(growth) + " bytes (from " + std::to_string(m_before->m_rss) + " to a peak of " + std::to_string(m_after->m_peakRss) + ")\n";
+        }
+
+        uint64_t m_limit;
+        const char* m_pLimit;
+        std::source_location m_location;
+        int m_pass = 0;
+        std::optional<PintTest::MemoryUsage> m_before;
+        std::optional<PintTest::MemoryUsage> m_after;
+    };
+}
+
+// The generators of the arguments of a property.  Each has a value_type, and
+//     void generate(PintTest::Random& random, value_type& value, size_t size) const
+// which overwrites value with a new one, reusing what value has already allocated, so that once the first few cases
+// have grown them the cases don't allocate at all, with containers no longer than size, and
+//     template <class Fails> bool shrink(value_type& value, const Fails& fails) const
+// which tries values simpler than value, simplest first, and replaces value with the first one that fails(simpler)
+// says still fails, returning whether there was one.  Generators of your own that do the same can be used with these
+struct PintTest::Gen
+{
+    // Integers in [min, max], which shrink towards origin (or the nearer end, if it's outside).  The ends and the origin
+    // are picked more often than the rest, as that's where the bugs usually are
+    template <class T>
+    class Integers
+    {
+        static_assert(std::is_integral_v<T> && !std::is_same_v<T, bool>, "Gen::integers is for integer types");
+        using Unsigned = std::make_unsigned_t<T>;
+
+    public:
+        using value_type = T;
+
+        Integers(T min, T max, T origin)
+            : m_min(min), m_max(std::max(min, max)), m_origin(std::clamp(origin, m_min, m_max))
+        {
+        }
+        void generate(Random& random, T& value, size_t /*size*/) const
+        {
+            if (random.below(EDGE_ONE_IN) == 0)
+            {
+                const std::array<T, 3> edges{ m_min, m_max, m_origin };
+                value = edges[random.below(edges.size())];
+                return;
+            }
+            // in unsigned arithmetic, which wraps, so that the span of the whole range of a signed type fits
+            const auto span = static_cast<uint64_t>(static_cast<Unsigned>(static_cast<Unsigned>(m_max) - static_cast<Unsigned>(m_min)));
+            value = static_cast<T>(static_cast<Unsigned>(static_cast<Unsigned>(m_min) + static_cast<Unsigned>(random.below(span + 1))));
+        }
+        // The origin, then halfway there, a quarter of the way, ... and last one closer
+        template <class Fails>
+        bool shrink(T& value, const Fails& fails) const
+        {
+            const bool above = value > m_origin;
+            const auto distance = static_cast<Unsigned>(above ? static_cast<Unsigned>(value) - static_cast<Unsigned>(m_origin)
+                : static_cast<Unsigned>(m_origin) - static_cast<Unsigned>(value));
+            for (Unsigned step = distance; step != 0; step /= 2)
+            {
+                const auto candidate = static_cast<T>(above ? static_cast<Unsigned>(value) - step : static_cast<Unsigned>(value) + step);
+                if (fails(candidate))
+                {
+                    value = candidate;
+                    return true;
+                }
+            }
+            return false;
+        }
+
+    private:
+        static constexpr uint64_t EDGE_ONE_IN = 8;
+        T m_min;
+        T m_max;
+        T m_origin;
+    };
+
+    // Floating point numbers in [min, max], which shrink towards 0 (or the nearer end, if it's outside), and to whole
+    // numbers.  The ends and 0 are picked more often than the rest
+    template <class T>
+    class Reals
+    {
+        static_assert(std::is_floating_point_v<T>, "Gen::reals is for floating point types");
+
+    public:
+        using value_type = T;
+
+        Reals(T min, T max)
+            : m_min(min), m_max(std::max(min, max)), m_origin(std::clamp(T(0), m_min, m_max))
+        {
+        }
+        void generate(Random& random, T& value, size_t /*size*/) const
+        {
+            if (random.below(EDGE_ONE_IN) == 0)
+            {
+                const std::array<T, 3> edges{ m_min, m_max, m_origin };
+                value = edges[random.below(edges.size())];
+                return;
+            }
+            // interpolated this way round, so that a range as wide as the type's doesn't overflow
+            const auto t = static_cast<T>(random.unit());
+            value = std::clamp(m_min * (1 - t) + m_max * t, m_min, m_max);
+        }
+        // The origin, the value without its fraction, then halfway to the origin
+        template <class Fails>
+        bool shrink(T& value, const Fails& fails) const
+        {
+            const std::array<T, 3> candidates{ m_origin, std::trunc(value), value / 2 + m_origin / 2 };
+            for (const T candidate : candidates)
+            {
+                if (candidate != value && candidate >= m_min && candidate <= m_max && fails(candidate))
+                {
+                    value = candidate;
+                    return true;
+                }
+            }
+            return false;
+        }
+
+    private:
+        static constexpr uint64_t EDGE_ONE_IN = 8;
+        T m_min;
+        T m_max;
+        T m_origin;
+    };
+
+    // Containers (anything with resize and erase, such as std::vector and std::string) of between minSize and maxSize
+    // elements from another generator, but no more than the case's size.  They shrink by dropping runs of elements,
+    // halves first, then quarters, ... then single elements, and then by shrinking the elements one at a time
+    template <class C, class Element>
+    class Containers
+    {
+        static_assert(std::is_same_v<typename C::value_type, typename Element::value_type>, "the element generator must make the container's elements");
+
+    public:
+        using value_type = C;
+
+        Containers(Element element, size_t minSize, size_t maxSize)
+            : m_element(std::move(element)), m_minSize(minSize), m_maxSize(std::max(minSize, maxSize))
+        {
+        }
+        void generate(Random& random, C& value, size_t size) const
+        {
+            const auto limit = std::clamp(size, m_minSize, m_maxSize);
+            value.resize(m_minSize + static_cast<size_t>(random.below(limit - m_minSize + 1)));
+            for (auto& element : value)
+                m_element.generate(random, element, size);
+        }
+        template <class Fails>
+        bool shrink(C& value, const Fails& fails) const
+        {
+            for (size_t run = value.size() - std::min(m_minSize, value.size()); run > 0; run /= 2)
+            {
+                for (size_t start = 0; start + run <= value.size(); start += run)
+                {
+                    C candidate = value;
+                    candidate.erase(candidate.begin() + static_cast<std::ptrdiff_t>(start), candidate.begin() + static_cast<std::ptrdiff_t>(start + run));
+                    if (fails(candidate))
+                    {
+                        value = std::move(candidate);
+                        return true;
+                    }
+                }
+            }
+            for (size_t i = 0; i < value.size(); ++i)
+            {
+                typename C::value_type element = value[i];
+                const auto elementFails = [&value, &fails, i](const typename C::value_type& simpler)
+                    {
+                        C candidate = value;
+                        candidate[i] = simpler;
+                        return fails(candidate);
+                    };
+                if (m_element.shrink(element, elementFails))
+                {
+                    value[i] = std::move(element);
+                    return true;
+                }
+            }
+            return false;
+        }
+
+    private:
+        Element m_element;
+        size_t m_minSize;
+        size_t m_maxSize;
+    };
+
+    // Any value of T, or one in [min, max]
+    template <class T = int>
+    static Integers<T> integers(T min = std::numeric_limits<T>::lowest(), T max = std::numeric_limits<T>::max())
+    {
+        return { min, max, T(0) };
+    }
+    template <class T = double>
+    static Reals<T> reals(T min, T max)
+    {
+        return { min, max };
+    }
+    // Printable ASCII by default, shrinking towards 'a'
+    static Integers<char> chars(char min = ' ', char max = '~')
+    {
+        return { min, max, 'a' };
+    }
+    static Containers<std::string, Integers<char>> strings(size_t maxLength = PROPERTY_MAX_SIZE, Integers<char> characters = chars())
+    {
+        return { characters, 0, maxLength };
+    }
+    template <class Element>
+    static Containers<std::vector<typename Element::value_type>, Element> vectors(Element element, size_t maxSize = PROPERTY_MAX_SIZE, size_t minSize = 0)
+    {
+        return { std::move(element), minSize, maxSize };
+    }
+    template <class C, class Element>
+    static Containers<C, Element> containers(Element element, size_t maxSize = PROPERTY_MAX_SIZE, size_t minSize = 0)
+    {
+        return { std::move(element), minSize, maxSize };
+    }
+};
+
+// Each case has a Random of its own, seeded from the property's seed (the iteration's, mixed with the property's name)
+// and the case's index, so that any case can be made again on its own, on any thread, and a run with the same --seed=
+// makes the same cases
+template <class Body, class... Gens>
+void PintTest::checkProperty(PropertyName name, const Body& body, const Gens&... generators)
+{
+    using Values = std::tuple<typename Gens::value_type...>;
+    const uint64_t seed = s_seed + s_iteration;
+    uint64_t state = seed;
+    for (const char* c = name.m_name; *c; ++c)
+        state = (state ^ static_cast<unsigned char>(*c)) * 0x100000001B3ull;
+    const uint64_t propertySeed = nextRandom(state);
+
+    const auto generate = [&generators..., propertySeed](Values& values, uint64_t index)
+        {
+            uint64_t caseState = propertySeed + index;
+            Random random(nextRandom(caseState));
+            const auto size = static_cast<size_t>(index % (PROPERTY_MAX_SIZE + 1));
+            std::apply([&](auto&... value) { (generators.generate(random, value, size), ...); }, values);
+        };
+    const auto check = [&body](const Values& values)
+        {
+            std::apply([&body](const auto&... value) { body(value...); }, values);
+        };
+
+    const uint64_t cases = s_propertyCases;
+    const uint64_t failing = runPropertyCases(cases, [&generate, &check](uint64_t first, uint64_t last, uint64_t& current)
+        {
+            Values values{};
+            for (current = first; current < last; ++current)
+            {
+                generate(values, current);
+                check(values);
+                if (currentFails() != 0)
+                    return;
+            }
+        });
+    if (failing == cases)
+        return;
+
+    // Shrink each argument in turn for as long as it will go, and go round them all again until none of them will
+    Values values{};
+    generate(values, failing);
+    const auto fails = [&check](const Values& candidate) { return runTrial([&] { check(candidate); }) != 0; };
+    unsigned steps = 0;
+    bool shrunk = true;
+    while (shrunk && steps < PROPERTY_MAX_SHRINKS)
+    {
+        shrunk = false;
+        const auto shrinkArgument = [&](auto index)
+            {
+                constexpr size_t I = decltype(index)::value;
+                const auto& generator = std::get<I>(std::tie(generators...));
+                const auto argumentFails = [&values, &fails](const auto& simpler)
+                    {
+                        Values candidate = values;
+                        std::get<I>(candidate) = simpler;
+                        return fails(candidate);
+                    };
+                while (steps < PROPERTY_MAX_SHRINKS && generator.shrink(std::get<I>(values), argumentFails))
+                {
+                    ++steps;
+                    shrunk = true;
+                }
+            };
+        [&]<size_t... I>(std::index_sequence<I...>) { (shrinkArgument(std::integral_constant<size_t, I>{}), ...); }(std::index_sequence_for<Gens...>{});
+    }
+
+    std::string message = "\nfailed on case " + std::to_string(failing + 1) + " of " + std::to_string(cases) + " (with --seed="
+        + std::to_string(seed) + "), shrunk in " + std::to_string(steps) + " steps to the arguments:";
+    std::apply([&message](const auto&... value) { ((message += "\n    " + PintTestNS::describeValue(value)), ...); }, values);
+    message += "\n";
+    recordFailureMessage({ name.m_location.file_name(), name.m_location.line(), std::move(message) });
+
+    // Check the smallest case for real, so that the checks it fails are reported as usual
+    const int failsBefore = currentFails();
+    check(values);
+    if (currentFails() == failsBefore && recordFailure(name.m_location))
+        recordFailureMessage({ name.m_location.file_name(), name.m_location.line(), "\nthe case passed when it was checked again, so the property isn't deterministic\n" });
+}
+
+inline constinit thread_local PintTest::AllocationCounts PintTest::s_threadAllocations{};
+
+// Macro to generate a test case
+#define TEST(TestCase) \
+    namespace \
+    { \
+        struct TestStruct##TestCase \
+        { \
+            static void TestBody(); \
+        }; \
+        PintTest::TestNode sTestNode##TestCase{ #TestCase, &TestStruct##TestCase::TestBody }; \
+    } \
+    void ::TestStruct##TestCase::TestBody()
+
+// Macro to generate a test in the suite of a fixture class (see PintTest::Fixture).  The test body is a member of a
+// class derived from the fixture, so can use its members directly
+#define TEST_F(Fixture, TestCase) \
+    namespace \
+    { \
+        struct Fixture##_##TestCase##_Test : Fixture \
+        { \
+            void TestBody(); \
+            static void Run() \
+            { \
+                Fixture##_##TestCase##_Test test; \
+                PintTest::runFixtureTest(test); \
+            } \
+        }; \
+        PintTest::TestNode sTestNode##Fixture##_##TestCase{ #Fixture "." #TestCase, &Fixture##_##TestCase##_Test::Run, PintTest::suite<Fixture>() }; \
+    } \
+    void ::Fixture##_##TestCase##_Test::TestBody()
+
+// Macro to generate a benchmark.  The body is passed a PintTest::BenchmarkState called state, and should loop over the
+// code to be timed with while (state.keepRunning())
+#define BENCHMARK(BenchmarkCase) \
+    namespace \
+    { \
+        struct BenchmarkStruct##BenchmarkCase \
+        { \
+            static void BenchmarkBody(PintTest::BenchmarkState& state); \
+        }; \
+        PintTest::BenchmarkNode sBenchmarkNode##BenchmarkCase{ #BenchmarkCase, &BenchmarkStruct##BenchmarkCase::BenchmarkBody }; \
+    } \
+    void ::BenchmarkStruct##BenchmarkCase::BenchmarkBody([[maybe_unused]] PintTest::BenchmarkState& state)
+
+// Macro to generate an async test, whose body is a coroutine (see PintTest::Task) that can co_await
+// PintTest::sleepFor, readable and writable.  The runner runs them all together on an event loop.  ASSERT_s return, which
+// a coroutine can't, so use the CO_ASSERT_s instead
+#define TEST_ASYNC(TestCase) \
+    namespace \
+    { \
+        struct TestStruct##TestCase \
+        { \
+            static PintTest::Task TestBody(); \
+            static void Run() \
+            { \
+                PintTest::runTask(&TestBody); \
+            } \
+        }; \
+        PintTest::TestNode sTestNode##TestCase{ #TestCase, &TestStruct##TestCase::Run, &TestStruct##TestCase::TestBody }; \
+    } \
+    auto ::TestStruct##TestCase::TestBody() -> PintTest::Task
+
+// Macro to generate a property: a test that checks the body (whose parameter list follows the macro) with arguments
+// made by the generators (see PintTest::Gen and PintTest::checkProperty).  Each parameter is a value of its
+// generator's type, taken by value if it's a number and by const reference otherwise
+#define PROPERTY(PropertyCase, ...) \
+    namespace \
+    { \
+        struct PropertyStruct##PropertyCase \
+        { \
+            using Function = PintTestNS::PropertyFunction<decltype(std::make_tuple(__VA_ARGS__))>; \
+            static Function PropertyBody; \
+            static void TestBody() \
+            { \
+                PintTest::checkProperty(#PropertyCase, &PropertyBody, __VA_ARGS__); \
+            } \
+        }; \
+        PintTest::TestNode sTestNode##PropertyCase{ #PropertyCase, &PropertyStruct##PropertyCase::TestBody }; \
+    } \
+    void ::PropertyStruct##PropertyCase::PropertyBody
+
+// Supporting macros for the expects and asserts to extract the commonality
+#define CONSTRUCT_WRITER \
+    PintTestNS::MsgWriter(std::source_location::current())
+
+#define PREAMBLE \
+    if (auto utestMsg = 
+
+#define POSTAMBLE_EXPECT \
+     ; utestMsg.empty()) ; /*no op*/ else CONSTRUCT_WRITER = utestMsg
+
+#define POSTAMBLE_ASSERT \
+     ; utestMsg.empty()) ; /*no op*/ else return CONSTRUCT_WRITER = utestMsg
+
+#define POSTAMBLE_CO_ASSERT \
+     ; utestMsg.empty()) ; /*no op*/ else co_return CONSTRUCT_WRITER = utestMsg
+
+//
+//
+// These are the expects and asserts that the test code actuals calls
+//
+//
+
+#define EXPECT_TRUE(a) \
+    PREAMBLE PintTestNS::compTrue((a), #a) POSTAMBLE_EXPECT
+
+#define EXPECT_FALSE(a) \
+    PREAMBLE PintTestNS::compFalse((a), #a) POSTAMBLE_EXPECT
+
+#define EXPECT_EQ(a,b) \
+    PREAMBLE PintTestNS::compEq((a), (b), #a, #b) POSTAMBLE_EXPECT
+
+#define EXPECT_NE(a,b) \
+    PREAMBLE PintTestNS::compNe((a), (b), #a, #b) POSTAMBLE_EXPECT
+
+#define EXPECT_GT(a,b) \
+    PREAMBLE PintTestNS::compGt((a), (b), #a, #b) POSTAMBLE_EXPECT
+
+#define EXPECT_LT(a,b) \
+    PREAMBLE PintTestNS::compLt((a), (b), #a, #b) POSTAMBLE_EXPECT
+
+#define EXPECT_GE(a,b) \
+    PREAMBLE PintTestNS::compGe((a), (b), #a, #b) POSTAMBLE_EXPECT
+
+#define EXPECT_LE(a,b) \
+    PREAMBLE PintTestNS::compLe((a), (b), #a, #b) POSTAMBLE_EXPECT
+
+#define EXPECT_NEAR(a, b, tol) \
+    PREAMBLE PintTestNS::compNear((a), (b), (tol), #a, #b, #tol) POSTAMBLE_EXPECT
+
+
+#define ASSERT_TRUE(a) \
+    PREAMBLE PintTestNS::compTrue((a), #a) POSTAMBLE_ASSERT
+
+#define ASSERT_FALSE(a) \
+    PREAMBLE PintTestNS::compFalse((a), #a) POSTAMBLE_ASSERT
+
+#define ASSERT_EQ(a,b) \
+    PREAMBLE PintTestNS::compEq((a), (b), #a, #b) POSTAMBLE_ASSERT
+
+#define ASSERT_NE(a,b) \
+    PREAMBLE PintTestNS::compNe((a), (b), #a, #b) POSTAMBLE_ASSERT
+
+#define ASSERT_GT(a,b) \
+    PREAMBLE PintTestNS::compGt((a), (b), #a, #b) POSTAMBLE_ASSERT
+
+#define ASSERT_LT(a,b) \
+    PREAMBLE PintTestNS::compLt((a), (b), #a, #b) POSTAMBLE_ASSERT
+
+#define ASSERT_GE(a,b) \
+    PREAMBLE PintTestNS::compGe((a), (b), #a, #b) POSTAMBLE_ASSERT
+
+#define ASSERT_LE(a,b) \
+    PREAMBLE PintTestNS::compLe((a), (b), #a, #b) POSTAMBLE_ASSERT
+
+#define ASSERT_NEAR(a, b, tol) \
+    PREAMBLE PintTestNS::compNear((a), (b), (tol), #a, #b, #tol) POSTAMBLE_ASSERT
+
+#define EXPECT_RANGE_EQ(a, b) \
+    PREAMBLE PintTestNS::compRangeEq((a), (b), #a, #b) POSTAMBLE_EXPECT
+
+#define EXPECT_RANGE_NEAR(a, b, tol) \
+    PREAMBLE PintTestNS::compRangeNear((a), (b), (tol), #a, #b, #tol) POSTAMBLE_EXPECT
+
+#define ASSERT_RANGE_EQ(a, b) \
+    PREAMBLE PintTestNS::compRangeEq((a), (b), #a, #b) POSTAMBLE_ASSERT
+
+#define ASSERT_RANGE_NEAR(a, b, tol) \
+    PREAMBLE PintTestNS::compRangeNear((a), (b), (tol), #a, #b, #tol) POSTAMBLE_ASSERT
+
+#define EXPECT_FILE_EQ(expected, actual) \
+    PREAMBLE PintTestNS::compFileEq((expected), (actual), #expected, #actual) POSTAMBLE_EXPECT
+
+#define ASSERT_FILE_EQ(expected, actual) \
+    PREAMBLE PintTestNS::compFileEq((expected), (actual), #expected, #actual) POSTAMBLE_ASSERT
+
+#define EXPECT_SNAPSHOT(name, bytes) \
+    PREAMBLE PintTestNS::compSnapshot((name), (bytes), #name, #bytes) POSTAMBLE_EXPECT
+
+#define ASSERT_SNAPSHOT(name, bytes) \
+    PREAMBLE PintTestNS::compSnapshot((name), (bytes), #name, #bytes) POSTAMBLE_ASSERT
+
+#define EXPECT_PERCENTILE_LT(recorder, percentile, limit) \
+    PREAMBLE PintTestNS::compLatencyLt((recorder), (percentile), (limit), #recorder, #limit) POSTAMBLE_EXPECT
+
+#define EXPECT_P99_LT(recorder, limit) \
+    EXPECT_PERCENTILE_LT(recorder, 99.0, limit)
+
+#define EXPECT_MAX_LT(recorder, limit) \
+    EXPECT_PERCENTILE_LT(recorder, 100.0, limit)
+
+#define ASSERT_PERCENTILE_LT(recorder, percentile, limit) \
+    PREAMBLE PintTestNS::compLatencyLt((recorder), (percentile), (limit), #recorder, #limit) POSTAMBLE_ASSERT
+
+#define ASSERT_P99_LT(recorder, limit) \
+    ASSERT_PERCENTILE_LT(recorder, 99.0, limit)
+
+#define ASSERT_MAX_LT(recorder, limit) \
+    ASSERT_PERCENTILE_LT(recorder, 100.0, limit)
+
+// The asserts for the coroutines of TEST_ASYNC, which co_return rather than return
+#define CO_ASSERT_TRUE(a) \
+    PREAMBLE PintTestNS::compTrue((a), #a) POSTAMBLE_CO_ASSERT
+
+#define CO_ASSERT_FALSE(a) \
+    PREAMBLE PintTestNS::compFalse((a), #a) POSTAMBLE_CO_ASSERT
+
+#define CO_ASSERT_EQ(a,b) \
+    PREAMBLE PintTestNS::compEq((a), (b), #a, #b) POSTAMBLE_CO_ASSERT
+
+#define CO_ASSERT_NE(a,b) \
+    PREAMBLE PintTestNS::compNe((a), (b), #a, #b) POSTAMBLE_CO_ASSERT
+
+#define CO_ASSERT_GT(a,b) \
+    PREAMBLE PintTestNS::compGt((a), (b), #a, #b) POSTAMBLE_CO_ASSERT
+
+#define CO_ASSERT_LT(a,b) \
+    PREAMBLE PintTestNS::compLt((a), (b), #a, #b) POSTAMBLE_CO_ASSERT
+
+#define CO_ASSERT_GE(a,b) \
+    PREAMBLE PintTestNS::compGe((a), (b), #a, #b) POSTAMBLE_CO_ASSERT
+
+#define CO_ASSERT_LE(a,b) \
+    PREAMBLE PintTestNS::compLe((a), (b), #a, #b) POSTAMBLE_CO_ASSERT
+
+#define CO_ASSERT_NEAR(a, b, tol) \
+    PREAMBLE PintTestNS::compNear((a), (b), (tol), #a, #b, #tol) POSTAMBLE_CO_ASSERT
+
+#define CO_ASSERT_RANGE_EQ(a, b) \
+    PREAMBLE PintTestNS::compRangeEq((a), (b), #a, #b) POSTAMBLE_CO_ASSERT
+
+#define CO_ASSERT_RANGE_NEAR(a, b, tol) \
+    PREAMBLE PintTestNS::compRangeNear((a), (b), (tol), #a, #b, #tol) POSTAMBLE_CO_ASSERT
+
+// Check the number of allocations made on this thread by the block that follows, e.g.
+//     EXPECT_NO_ALLOC { hotPath(); }
+// The block is the body of a loop, so break and continue in it leave the block (which is still checked), not a loop
+// around it
+#define EXPECT_ALLOCS_LE(n) \
+    for (PintTestNS::AllocationScope utestAllocs((n), #n); utestAllocs.next(); ) \
+        if (!utestAllocs.inBlock()) { PREAMBLE utestAllocs.check() POSTAMBLE_EXPECT; } else
+
+#define EXPECT_NO_ALLOC \
+    EXPECT_ALLOCS_LE(0)
+
+// Check how far the process's peak resident set rises, in bytes, over the block that follows, e.g.
+//     EXPECT_RSS_GROWTH_LE(64 << 20) { loadIndex(); }
+#define EXPECT_RSS_GROWTH_LE(bytes) \
+    for (PintTestNS::MemoryScope utestMemory((bytes), #bytes); utestMemory.next(); ) \
+        if (!utestMemory.inBlock()) { PREAMBLE utestMemory.check() POSTAMBLE_EXPECT; } else
+
+//
+//
+// End of expects and asserts
+//
+//
+
+#ifdef PINTTEST_RUNNER
+
+// A check, by where it is.  The file name is compared by address, which is the same every time a check is made
+struct PintTest::Site
+{
+    const char* m_file = nullptr;
+    uint_least32_t m_line = 0;
+    bool operator==(const Site&) const = default;
+};
+
+struct PintTest::SiteHash
+{
+    size_t operator()(const Site& site) const noexcept
+    {
+        return std::hash<const void*>()(site.m_file) ^ (static_cast<size_t>(site.m_line) * 0x9E3779B97F4A7C15ull);
+    }
+};
+// How many times each check has failed, with the last one looked up kept, as it's usually the next one too
+struct PintTest::SiteFailures
+{
+    std::unordered_map<Site, uint64_t, SiteHash> m_counts;
+    Site m_last;
+    uint64_t* m_lastCount = nullptr;
+
+    uint64_t add(const Site& site)
+    {
+        if (!m_lastCount || !(site == m_last))
+        {
+            m_last = site;
+            m_lastCount = &m_counts[site];
+        }
+        return ++*m_lastCount;
+    }
+};
+
+// The failures of a test made on one of the other threads it started, which only that thread writes to until the
+// test finishes and merges them in
+struct PintTest::ThreadFailures
+{
+    int m_fails = 0;
+    std::vector<Failure> m_failures;
+    SiteFailures m_sites;
+    ThreadFailures* m_next = nullptr;
+};
+
+// The per-test state of the test running on the current thread.  Failures are counted here as well as in s_fails,
+// and their messages collected in m_failures, so that tests running on different threads don't interfere.  Other
+// threads each add a buffer of their own to m_otherThreads, so they don't need to synchronise with each other
+struct PintTest::TestState
+{
+    int m_fails = 0;
+    std::vector<Failure>* m_failures = nullptr;
+    // null for a benchmark
+    TestResult* m_result = nullptr;
+    uint64_t m_id = ++s_testIds;
+    std::atomic<ThreadFailures*> m_otherThreads = nullptr;
+    SiteFailures m_sites{};
+    // a trial of some of a property's cases (see runTrial), whose failures aren't counted in s_fails
+    bool m_trial = false;
+    // the check that has reached --max-failures, to stop the test once the check's own message is recorded
+    std::optional<std::source_location> m_stopAfter = std::nullopt;
+};
+
+// The runner, which is only compiled in the translation unit that defines PINTTEST_IMPLEMENTATION, or in every one
+// that includes the header, if it is used header only
+namespace PintTestNS
+{
+    class Runner : PintTest
+    {
+        friend class PintTest;
+
+        // The duration of each test the last time it ran, by name
+        using Timings = std::unordered_map<std::string, std::chrono::nanoseconds>;
+
+        static inline std::mutex s_outputMutex;
+
+        // The first --repeat iteration of the batch being run, and the number of tests in each of its iterations
+        static inline unsigned s_batchIteration = 0;
+        static inline size_t s_batchTestsPerIteration = 1;
+
+        // The compiled form of all the --filter= patterns.  A name passes if it matches any of the include patterns (or
+        // there aren't any) and none of the exclude patterns.  Plain patterns match any substring of the name, and are all
+        // matched together in a single pass over the name by an Aho-Corasick automaton.  Patterns containing * or ? are
+        // globs which must match the whole name (a glob of the form *text* is just a substring, so it goes in the
+        // automaton too).  Patterns written as /regex/ are ECMAScript regular expressions searched for in the name
+        class NameFilter
+        {
+        public:
+            // Returns an error message if the pattern is invalid.  Once all the patterns have been added, compile must be
+            // called before matches
+            std::optional<std::string> add(std::string_view pattern, bool exclude)
+            {
+                m_hasIncludes = m_hasIncludes || !exclude;
+                if (pattern.size() >= 2 && pattern.front() == '/' && pattern.back() == '/')
+                {
+                    try
+                    {
+                        m_regexes.push_back({ std::regex(std::string(pattern.substr(1, pattern.size() - 2)), std::regex::ECMAScript | std::regex::optimize), exclude });
+                    }
+                    catch (const std::regex_error& e)
+                    {
+                        return std::string("invalid regex ") + std::string(pattern) + ": " + e.what();
+                    }
+                    return std::nullopt;
+                }
+                const auto isWildcard = [](char c) { return c == '*' || c == '?'; };
+                if (std::none_of(pattern.begin(), pattern.end(), isWildcard))
+                {
+                    m_substrings.emplace_back(pattern, exclude);
+                    return std::nullopt;
+                }
+                if (pattern.size() > 2 && pattern.front() == '*' && pattern.back() == '*' && std::none_of(pattern.begin() + 1, pattern.end() - 1, isWildcard))
+                {
+                    m_substrings.emplace_back(pattern.substr(1, pattern.size() - 2), exclude);
+                    return std::nullopt;
+                }
+                m_globs.push_back({ std::string(pattern), exclude });
+                return std::nullopt;
+            }
+
+            // Build the automaton of all the substring patterns, in one go
+            void compile()
+            {
+                if (m_substrings.empty())
+                    return;
+                m_nodes.assign(1, Node{});
+                m_nodes[0].m_next.fill(-1);
+                for (const auto& [substring, isExclude] : m_substrings)
+                {
+                    int32_t state = 0;
+                    for (const unsigned char c : substring)
+                    {
+                        if (m_nodes[state].m_next[c] < 0)
+                        {
+                            m_nodes[state].m_next[c] = static_cast<int32_t>(m_nodes.size());
+                            m_nodes.push_back(Node{});
+                            m_nodes.back().m_next.fill(-1);
+                        }
+                        state = m_nodes[state].m_next[c];
+                    }
+                    (isExclude ? m_nodes[state].m_exclude : m_nodes[state].m_include) = true;
+                }
+
+                // Breadth first, so that a node's failure link is complete before its children need it.  Missing
+                // transitions are filled in from the failure link, making the automaton a DFA
+                std::vector<int32_t> queue;
+                for (auto& next : m_nodes[0].m_next)
+                {
+                    if (next < 0)
+                        next = 0;
+                    else
+                        queue.push_back(next);
+                }
+                for (size_t q = 0; q < queue.size(); ++q)
+                {
+                    const auto state = queue[q];
+                    const auto fail = m_nodes[state].m_fail;
+                    m_nodes[state].m_include = m_nodes[state].m_include || m_nodes[fail].m_include;
+                    m_nodes[state].m_exclude = m_nodes[state].m_exclude || m_nodes[fail].m_exclude;
+                    for (int c = 0; c < 256; ++c)
+                    {
+                        const auto child = m_nodes[state].m_next[c];
+                        if (child < 0)
+                        {
+                            m_nodes[state].m_next[c] = m_nodes[fail].m_next[c];
+                        }
+                        else
+                        {
+                            m_nodes[child].m_fail = m_nodes[fail].m_next[c];
+                            queue.push_back(child);
+                        }
+                    }
+                }
+            }
+
+            [[nodiscard]] bool matches(std::string_view name) const
+            {
+                bool included = !m_hasIncludes;
+                if (!m_nodes.empty())
+                {
+                    int32_t state = 0;
+                    for (const unsigned char c : name)
+                    {
+                        state = m_nodes[state].m_next[c];
+                        if (m_nodes[state].m_exclude)
+                            return false;
+                        included = included || m_nodes[state].m_include;
+                    }
+                }
+                for (const auto& glob : m_globs)
+                {
+                    if ((glob.m_exclude || !included) && globMatch(glob.m_pattern, name))
+                    {
+                        if (glob.m_exclude)
+                            return false;
+                        included = true;
+                    }
+                }
+                for (const auto& regex : m_regexes)
+                {
+                    if ((regex.m_exclude || !included) && std::regex_search(name.begin(), name.end(), regex.m_regex))
+                    {
+                        if (regex.m_exclude)
+                            return false;
+                        included = true;
+                    }
+                }
+                return included;
+            }
+
+        private:
+            struct Node
+            {
+                std::array<int32_t, 256> m_next;
+                int32_t m_fail = 0;
+                // an include/exclude pattern ends here, or at one of the suffixes of the text that leads here
+                bool m_include = false;
+                bool m_exclude = false;
+            };
+            struct Glob
+            {
+                std::string m_pattern;
+                bool m_exclude;
+            };
+            struct Regex
+            {
+                std::regex m_regex;
+                bool m_exclude;
+            };
+
+            // * matches any run of characters and ? any one character, backtracking to the last * on a mismatch
+            static bool globMatch(std::string_view pattern, std::string_view name)
+            {
+                size_t p = 0;
+                size_t n = 0;
+                size_t starP = std::string_view::npos;
+                size_t starN = 0;
+                while (n < name.size())
+                {
+                    if (p < pattern.size() && (pattern[p] == '?' || pattern[p] == name[n]))
+                    {
+                        ++p;
+                        ++n;
+                    }
+                    else if (p < pattern.size() && pattern[p] == '*')
+                    {
+                        starP = p++;
+                        starN = n;
+                    }
+                    else if (starP != std::string_view::npos)
+                    {
+                        p = starP + 1;
+                        n = ++starN;
+                    }
+                    else
+                    {
+                        return false;
+                    }
+                }
+                while (p < pattern.size() && pattern[p] == '*')
+                    ++p;
+                return p == pattern.size();
+            }
+
+            std::vector<std::pair<std::string, bool>> m_substrings;
+            std::vector<Node> m_nodes;
+            std::vector<Glob> m_globs;
+            std::vector<Regex> m_regexes;
+            bool m_hasIncludes = false;
+        };
+
+        // The run time parameters, as parsed from the args passed to runAllTests2
+        struct Options
+        {
+            NameFilter m_filter;
+            unsigned m_jobs = 1;
+            bool m_isolate = false;
+            unsigned m_shardIndex = 0;
+            unsigned m_totalShards = 1;
+            std::string m_resultsFile;
+            std::vector<std::string> m_mergeFiles;
+            bool m_benchmark = false;
+            std::vector<std::string> m_outputs;
+            // "--filter=" was given, so only the self test is run
+            bool m_nothingToDo = false;
+            std::string m_timingDb;
+            unsigned m_slowest = 0;
+            bool m_listTests = false;
+            bool m_perfCounters = false;
+            bool m_resourceUsage = false;
+            std::string m_saveBaseline;
+            std::string m_compareBaseline;
+            double m_regressionThreshold = 10.0;
+            unsigned m_failuresPerSite = DEFAULT_FAILURES_PER_SITE;
+            unsigned m_maxFailures = 0;
+            bool m_updateSnapshots = false;
+            std::string m_snapshotDirectory = "snapshots";
+            bool m_shuffle = false;
+            std::optional<uint64_t> m_seed;
+            // UINT_MAX for --until-fail without --repeat=
+            unsigned m_repeat = 1;
+            bool m_untilFail = false;
+            unsigned m_propertyCases = DEFAULT_PROPERTY_CASES;
+            unsigned m_propertyJobs = 1;
+            // the socket to serve runs on, and the test libraries to load first
+            std::string m_serve;
+            std::vector<std::string> m_loads;
+        };
+
+        // set before the tests run, and only read while they do
+        static inline std::string s_snapshotDirectory = "snapshots";
+        // this thread's buffer for the test with id m_testId
+        struct ThreadBuffer
+        {
+            uint64_t m_testId = 0;
+            ThreadFailures* m_failures = nullptr;
+        };
+        static thread_local ThreadBuffer s_threadBuffer;
+
+
+        static std::pair<int,int> runAllTests2(const std::vector<std::string_view>& args)
+        {
+            // a client of --serve only passes its arguments on, and leaves this process's tests alone
+            const std::string_view connectArg = "--connect=";
+            if (const auto connect = std::find_if(args.begin(), args.end(), [&connectArg](std::string_view arg) { return arg.starts_with(connectArg); });
+                connect != args.end())
+                return runRemotely(std::string(connect->substr(connectArg.size())), args);
+
+            s_fails = 0;
+            s_tests_failed = 0;
+            s_tests_ran = 0;
+            s_unattributedFails = 0;
+
+            if (const auto duplicate = findDuplicateName())
+            {
+                std::cout << RED_TEXT_START << *duplicate << " has already been registered" << COLOUR_TEXT_END << "\n";
+                return { -1, 11 };
+            }
+
+            Options options;
+            if (const auto earlyReturn = parseArgs(args, options))
+                return *earlyReturn;
+
+            if (!options.m_serve.empty())
+                return serve(options);
+
+            if (!options.m_mergeFiles.empty())
+                return mergeResults(options.m_mergeFiles);
+
+            if (options.m_listTests)
+            {
+                listTests(options);
+                return { 0, 0 };
+            }
+
+            const auto reporter = createReporter(options);
+            if (!reporter)
+                return { -1, 8 };
+
+            s_failuresPerSite = options.m_failuresPerSite;
+            s_maxFailures = options.m_maxFailures;
+            s_updateSnapshots = options.m_updateSnapshots;
+            s_snapshotDirectory = options.m_snapshotDirectory;
+            s_perfCounters = false;
+            if (options.m_perfCounters)
+            {
+                std::string reason;
+                s_perfCounters = PerfCounterGroup::available(reason);
+                if (!s_perfCounters)
+                    std::cerr << "\"--perf-counters\": the hardware performance counters are unavailable (" << reason << "), running without them\n";
+            }
+            s_resourceUsage = options.m_resourceUsage;
+
+            // without --seed= a new one is picked, and reported, so that the order and the property cases can be repeated
+            auto clockState = static_cast<uint64_t>(std::chrono::system_clock::now().time_since_epoch().count());
+            s_seed = options.m_seed ? *options.m_seed : nextRandom(clockState) >> 32;
+            s_propertyCases = options.m_propertyCases;
+            s_propertyJobs = options.m_propertyJobs;
+            std::optional<uint64_t> seed;
+            if (options.m_shuffle)
+                seed = s_seed.load();
+            unsigned iterationsRan = 0;
+            std::vector<std::pair<unsigned, uint64_t>> failedIterations;
+
+            const auto start = std::chrono::steady_clock::now();
+            std::vector<TestResult> results;
+            // the summary's slowest tests and resource totals are kept up to date batch by batch, as --until-fail only
+            // keeps the results of its last batch
+            std::vector<std::pair<std::string, std::chrono::nanoseconds>> slowest;
+            std::optional<ResourceUsage> resources;
+            const auto addToSummary = [&options, &slowest, &resources](const std::vector<TestResult>& batchResults)
+            {
+                if (options.m_slowest > 0)
+                {
+                    for (const auto& result : batchResults)
+                        slowest.emplace_back(result.m_name, result.m_duration);
+                    std::stable_sort(slowest.begin(), slowest.end(), [](const auto& l, const auto& r) { return l.second > r.second; });
+                    if (slowest.size() > options.m_slowest)
+                        slowest.resize(options.m_slowest);
+                }
+                for (const auto& result : batchResults)
+                {
+                    if (!result.m_resources)
+                        continue;
+                    if (!resources)
+                        resources.emplace();
+                    *resources += *result.m_resources;
+                }
+            };
+            const auto finish = [&reporter, &start, &slowest, &resources, &seed, &iterationsRan, &failedIterations]()
+            {
+                reporter->runFinished({ s_tests_ran, s_tests_failed, s_fails, std::chrono::steady_clock::now() - start, slowest, iterationsRan, seed, failedIterations, resources });
+                return std::pair<int, int>{ s_tests_ran, s_fails };
+            };
+
+            reporter->testStarting("PintTest::selfTest");
+            reporter->testFinished(executeTest(PintTest::selfTest, "PintTest::selfTest"));
+            if (s_fails > 0 || options.m_nothingToDo)
+                return finish();
+
+            std::optional<Baseline> baseline;
+            if (!options.m_compareBaseline.empty())
+            {
+                baseline.emplace();
+                if (!loadBaseline(options.m_compareBaseline, *baseline))
+                {
+                    std::cerr << "Unable to read the baseline \"" << options.m_compareBaseline << "\", terminating\n";
+                    finish();
+                    return { -1, 12 };
+                }
+            }
+
+            auto timings = options.m_timingDb.empty() ? Timings{} : loadTimings(options.m_timingDb);
+            auto toRun = selectTests(options, timings);
+
+            // The work is scheduled in groups - each suite's tests together, and every other test on its own
+            auto groups = groupBySuite(toRun);
+
+            // With more than one worker the order decides how long the run takes, so start the longest groups first and
+            // leave the short ones to fill in the gaps at the end.  Tests that haven't been timed yet might be long, so
+            // they go first of all
+            if (options.m_isolate || options.m_jobs > 1)
+            {
+                std::vector<std::pair<std::chrono::nanoseconds, size_t>> byDuration;
+                for (size_t g = 0; g + 1 < groups.size(); ++g)
+                {
+                    std::chrono::nanoseconds duration{};
+                    for (size_t i = groups[g]; i < groups[g + 1]; ++i)
+                    {
+                        const auto timing = timings.find(toRun[i]->name());
+                        duration = timing == timings.end() || duration + timing->second < duration ? std::chrono::nanoseconds::max() : duration + timing->second;
+                    }
+                    byDuration.emplace_back(duration, g);
+                }
+                std::stable_sort(byDuration.begin(), byDuration.end(), [](const auto& l, const auto& r) { return l.first > r.first; });
+                std::vector<const TestNode*> sorted;
+                std::vector<size_t> sortedGroups{ 0 };
+                for (const auto& [duration, g] : byDuration)
+                {
+                    sorted.insert(sorted.end(), toRun.begin() + static_cast<std::ptrdiff_t>(groups[g]), toRun.begin() + static_cast<std::ptrdiff_t>(groups[g + 1]));
+                    sortedGroups.push_back(sorted.size());
+                }
+                toRun = std::move(sorted);
+                groups = std::move(sortedGroups);
+            }
+
+            // With --repeat= or --until-fail the tests are run over and over, and with --shuffle in a new order each time.
+            // Each iteration is shuffled with a seed of its own, the run's seed plus the iteration, so that the seed of an
+            // iteration that failed, given to --seed=, runs the tests in the same order straight away.  With --jobs or
+            // --isolate a batch of iterations is run at once, so that repeating a single test spreads it over the cores
+            const unsigned batchSize = options.m_isolate || options.m_jobs > 1 ? std::max(1u, options.m_jobs) : 1;
+            while (iterationsRan < options.m_repeat && !(options.m_untilFail && !failedIterations.empty()))
+            {
+                const unsigned batch = std::min(batchSize, options.m_repeat - iterationsRan);
+                std::vector<const TestNode*> batchRun;
+                std::vector<size_t> batchGroups{ 0 };
+                for (unsigned b = 0; b < batch; ++b)
+                {
+                    auto order = toRun;
+                    auto orderGroups = groups;
+                    if (seed)
+                        shuffleGroups(order, orderGroups, *seed + iterationsRan + b);
+                    for (size_t g = 1; g < orderGroups.size(); ++g)
+                        batchGroups.push_back(batchRun.size() + orderGroups[g]);
+                    batchRun.insert(batchRun.end(), order.begin(), order.end());
+                }
+
+                // for executeInSuite to tell which iteration each of the batch's tests is part of, and for the TEST_ASYNCs,
+                // which are only run together when there's one iteration at a time
+                s_batchIteration = iterationsRan;
+                s_batchTestsPerIteration = std::max<size_t>(1, toRun.size());
+                s_iteration = iterationsRan;
+                std::vector<TestResult> batchResults(batchRun.size());
+                std::optional<TestResult> unattributedResult;
+                if (options.m_isolate)
+                {
+                    runIsolated(batchRun, batchGroups, options.m_jobs, batchResults, *reporter);
+                }
+                else if (options.m_jobs <= 1)
+                {
+                    // the TEST_ASYNCs go first, all together, and then the rest one by one
+                    runAsyncTests(batchRun, batchResults, *reporter);
+                    SuiteInProgress current;
+                    for (size_t i = 0; i < batchRun.size(); ++i)
+                    {
+                        if (batchRun[i]->async())
+                            continue;
+                        reporter->testStarting(batchRun[i]->name());
+                        batchResults[i] = executeInSuite(batchRun, batchGroups, i, current);
+                        reporter->testFinished(batchResults[i]);
+                    }
+                }
+                else
+                {
+                    // a suite's SetUpSuite and TearDownSuite may well share state, so no two iterations run the same
+                    // suite at once
+                    std::map<const Suite*, std::mutex> suiteMutexes;
+                    for (const auto* test : batchRun)
+                        if (test->suite())
+                            suiteMutexes[test->suite()];
+                    const auto unattributedBefore = s_unattributedFails.load();
+                    s_concurrentTests = true;
+                    parallelFor(batchGroups.size() - 1, options.m_jobs, [&batchRun, &batchGroups, &batchResults, &reporter, &suiteMutexes](size_t group)
+                        {
+                            const auto* const suite = batchRun[batchGroups[group]]->suite();
+                            std::unique_lock<std::mutex> suiteLock;
+                            if (suite)
+                                suiteLock = std::unique_lock(suiteMutexes.at(suite));
+                            SuiteInProgress current;
+                            for (size_t index = batchGroups[group]; index < batchGroups[group + 1]; ++index)
+                            {
+                                batchResults[index] = executeInSuite(batchRun, batchGroups, index, current);
+                                std::lock_guard lock(s_outputMutex);
+                                reporter->testStarting(batchRun[index]->name());
+                                reporter->testFinished(batchResults[index]);
+                            }
+                        });
+                    s_concurrentTests = false;
+                    if (const int unattributed = s_unattributedFails - unattributedBefore; unattributed > 0)
+                        unattributedResult = reportUnattributed(unattributed, *reporter);
+                }
+
+                for (unsigned b = 0; b < batch; ++b)
+                {
+                    const auto first = batchResults.begin() + static_cast<std::ptrdiff_t>(b * toRun.size());
+                    if (std::any_of(first, first + static_cast<std::ptrdiff_t>(toRun.size()), [](const TestResult& result) { return !result.passed(); }))
+                        failedIterations.emplace_back(iterationsRan + b + 1, seed ? *seed + iterationsRan + b : 0);
+                }
+                // which of the batch's iterations an unattributed failure was in isn't known, so it counts against the last
+                if (unattributedResult)
+                {
+                    if (failedIterations.empty() || failedIterations.back().first <= iterationsRan)
+                        failedIterations.emplace_back(iterationsRan + batch, seed ? *seed + iterationsRan + batch - 1 : 0);
+                    batchResults.push_back(std::move(*unattributedResult));
+                }
+                addToSummary(batchResults);
+                // --until-fail may run for as long as it takes, so it only keeps the last batch, the one that failed if any did
+                if (options.m_untilFail)
+                    results = std::move(batchResults);
+                else
+                    results.insert(results.end(), std::make_move_iterator(batchResults.begin()), std::make_move_iterator(batchResults.end()));
+                iterationsRan += batch;
+            }
+            s_iteration = 0;
+
+            // a sharded run leaves the database alone, as the shards that run after it, or alongside it, must split the
+            // tests by the same timings
+            if (!options.m_timingDb.empty() && options.m_totalShards <= 1)
+            {
+                for (const auto& result : results)
+                    if (!result.m_crashed)
+                        timings[result.m_name] = result.m_duration;
+                if (!saveTimings(options.m_timingDb, timings))
+                    std::cerr << "Unable to save the test timings to \"" << options.m_timingDb << "\"\n";
+            }
+
+            if (!options.m_resultsFile.empty() && !writeResults(options.m_resultsFile, results))
+            {
+                std::cerr << "Unable to write the results to \"" << options.m_resultsFile << "\", terminating\n";
+                finish();
+                return { -1, 7 };
+            }
+
+            if (baseline)
+            {
+                reporter->testStarting("PintTest::compareBaseline");
+                reporter->testFinished(executeTest([&]
+                    {
+                        const auto current = baselineOf(results, {});
+                        for (const auto& [name, samples] : current.m_tests)
+                        {
+                            if (const auto before = baseline->m_tests.find(name); before != baseline->m_tests.end())
+                                checkRegression(name, before->second, samples, options);
+                        }
+                    }, "PintTest::compareBaseline"));
+            }
+
+            std::vector<BenchmarkResult> benchmarkResults;
+            if (options.m_benchmark)
+                benchmarkResults = runBenchmarks(options, *reporter, baseline ? &*baseline : nullptr);
+
+            if (!options.m_saveBaseline.empty())
+            {
+                Baseline saved;
+                loadBaseline(options.m_saveBaseline, saved);
+                const auto current = baselineOf(results, benchmarkResults);
+                for (const auto& [samples, currentSamples] : { std::pair{ &saved.m_tests, &current.m_tests }, std::pair{ &saved.m_benchmarks, &current.m_benchmarks } })
+                {
+                    for (const auto& [name, latest] : *currentSamples)
+                    {
+                        auto& kept = (*samples)[name];
+                        kept.insert(kept.end(), latest.begin(), latest.end());
+                        if (kept.size() > BASELINE_SAMPLES)
+                            kept.erase(kept.begin(), kept.end() - BASELINE_SAMPLES);
+                    }
+                }
+                if (!saveBaseline(options.m_saveBaseline, saved))
+                    std::cerr << "Unable to save the baseline to \"" << options.m_saveBaseline << "\"\n";
+            }
+
+            return finish();
+        }
+
+        // The result of PintTest::unattributed, for the failures made on threads that weren't attached to a test while
+        // the tests ran concurrently.  Their messages were written out as they happened
+        static TestResult reportUnattributed(int fails, Reporter& reporter)
+        {
+            TestResult result;
+            result.m_name = "PintTest::unattributed";
+            result.m_fails = fails;
+            ++PintTest::s_tests_ran;
+            ++PintTest::s_tests_failed;
+            reporter.testStarting(result.m_name);
+            reporter.testFinished(result);
+            return result;
+        }
+
+        // The suite that a caller of executeInSuite last set up, and if its SetUpSuite failed, the failure of each of its
+        // tests, which aren't run
+        struct SuiteInProgress
+        {
+            const Suite* m_suite = nullptr;
+            std::optional<Failure> m_notRun;
+        };
+
+        // Run toRun[index] as executeTest does, but first set up its suite if current (the suite last set up by the caller)
+        // isn't it, and tear the suite down after the suite's last test.  A suite's tests must be together in toRun, in
+        // one of the groups (as returned by groupBySuite), and a suite can have more than one group when it is repeated
+        static TestResult executeInSuite(const std::vector<const TestNode*>& toRun, const std::vector<size_t>& groups, size_t index, SuiteInProgress& current)
+        {
+            s_iteration = s_batchIteration + static_cast<unsigned>(index / s_batchTestsPerIteration);
+            const auto* const suite = toRun[index]->suite();
+            TestResult setUp;
+            if (suite && suite != current.m_suite)
+            {
+                runSuiteFunction(suite->m_setUp, setUp);
+                current = { suite, std::nullopt };
+                if (!setUp.passed())
+                {
+                    // the suite's tests aren't run, and each fails, at the first of SetUpSuite's failures if it has one
+                    current.m_notRun = Failure{ {}, 0, "\nnot run, as the suite's SetUpSuite failed" };
+                    if (!setUp.m_failures.empty())
+                    {
+                        current.m_notRun->m_file = setUp.m_failures.front().m_file;
+                        current.m_notRun->m_line = setUp.m_failures.front().m_line;
+                    }
+                }
+            }
+            // the first test fails with SetUpSuite's failures, and the rest with a failure of their own
+            auto result = suite && current.m_notRun ? executeTest([&current, first = !setUp.passed()]
+                {
+                    if (!first)
+                        recordFailure();
+                    recordFailureMessage(*current.m_notRun);
+                }, toRun[index]->name()) : executeTest(*toRun[index]);
+            const bool passed = result.passed();
+            if (!setUp.m_failures.empty() || setUp.m_fails)
+            {
+                result.m_fails += setUp.m_fails;
+                result.m_failures.insert(result.m_failures.begin(), setUp.m_failures.begin(), setUp.m_failures.end());
+            }
+            if (suite && index + 1 == *std::upper_bound(groups.begin(), groups.end(), index))
+            {
+                current = {};
+                runSuiteFunction(suite->m_tearDown, result);
+            }
+            if (passed && !result.passed())
+                ++s_tests_failed;
+            return result;
+        }
+
+        // Run a single test and return the result, without writing anything out
+        static TestResult executeTest(const TestNode& test)
+        {
+            return executeTest([&test] { test.run(); }, test.name());
+        }
+        static TestResult executeTest(const std::function<void()>& testFn, const std::string& testCase)
+        {
+            ++PintTest::s_tests_ran;
+            TestResult result;
+            result.m_name = testCase;
+            TestState state{ 0, &result.m_failures, &result };
+            const auto outerTest = enterTest(state);
+            const auto currentUnattributedFails = s_unattributedFails.load();
+            PerfCounterGroup* const counters = s_perfCounters ? &PerfCounterGroup::forThisThread() : nullptr;
+            if (counters)
+                counters->start();
+            ResourceSample resourcesBefore;
+            bool resources = false;
+            if (s_resourceUsage)
+            {
+                // the peak resident set is reset first, so that the sample after the test has the test's own peak
+                resetPeakMemory();
+                s_clearedPeakRss = 0;
+                resources = resourcesBefore.take();
+            }
+            const auto allocationsBefore = s_threadAllocations;
+            const auto start = std::chrono::steady_clock::now();
+            runStoppable(testFn);
+            result.m_duration = std::chrono::steady_clock::now() - start;
+            const auto allocationsAfter = s_threadAllocations;
+            if (ResourceSample resourcesAfter; resources && resourcesAfter.take())
+                result.m_resources = resourcesAfter.since(resourcesBefore);
+            if (counters)
+                result.m_counters = counters->stop();
+            if (s_trackingAllocations)
+                result.m_allocations = AllocationCounts{ allocationsAfter.m_allocations - allocationsBefore.m_allocations, allocationsAfter.m_bytes - allocationsBefore.m_bytes };
+            leaveTest(state, outerTest);
+
+            // with one test at a time any failure on a thread that isn't attached is this test's, but with --jobs it
+            // could be any running test's, so runAllTests2 reports those once for the batch instead
+            result.m_fails = state.m_fails + (s_concurrentTests ? 0 : s_unattributedFails - currentUnattributedFails);
+            if (!result.passed())
+                ++PintTest::s_tests_failed;
+            return result;
+        }
+
+        // This thread's failure buffer for the test that it is attached to, adding one to the test if it doesn't have one
+        // yet.  Null if the thread can't be attributed to a test
+        static ThreadFailures* threadFailures()
+        {
+            TestState* const test = s_attachedTest ? s_attachedTest : s_soleTest.load(std::memory_order_acquire);
+            if (!test)
+                return nullptr;
+            if (s_threadBuffer.m_testId != test->m_id)
+            {
+                auto* const buffer = new ThreadFailures;
+                buffer->m_next = test->m_otherThreads.load(std::memory_order_relaxed);
+                while (!test->m_otherThreads.compare_exchange_weak(buffer->m_next, buffer, std::memory_order_release, std::memory_order_relaxed))
+                    ;
+                s_threadBuffer = { test->m_id, buffer };
+            }
+            return s_threadBuffer.m_failures;
+        }
+
+        // Make state the current test, which is also the test of any threads which haven't been attached to one, unless
+        // tests are running concurrently.  Returns what to pass to leaveTest
+        static std::pair<TestState*, TestState*> enterTest(TestState& state)
+        {
+            return { std::exchange(s_currentTest, &state), s_soleTest.exchange(s_concurrentTests ? nullptr : &state) };
+        }
+
+        // Undo enterTest, and merge in the failures from the test's other threads, which must have finished with it
+        // The failures that were only counted are summarised, one per check
+        static void leaveTest(TestState& state, std::pair<TestState*, TestState*> outer)
+        {
+            s_currentTest = outer.first;
+            s_soleTest = outer.second;
+            const auto perSite = s_failuresPerSite.load();
+            std::map<std::pair<std::string_view, uint_least32_t>, uint64_t> unreported;
+            const auto countUnreported = [perSite, &unreported](const SiteFailures& sites)
+                {
+                    for (const auto& [site, count] : sites.m_counts)
+                        if (perSite && count > perSite)
+                            unreported[{ site.m_file, site.m_line }] += count - perSite;
+                };
+            countUnreported(state.m_sites);
+            auto* buffer = state.m_otherThreads.exchange(nullptr, std::memory_order_acquire);
+            while (buffer)
+            {
+                state.m_fails += buffer->m_fails;
+                if (state.m_failures)
+                    state.m_failures->insert(state.m_failures->end(), std::make_move_iterator(buffer->m_failures.begin()), std::make_move_iterator(buffer->m_failures.end()));
+                countUnreported(buffer->m_sites);
+                delete std::exchange(buffer, buffer->m_next);
+            }
+            if (state.m_failures)
+            {
+                for (const auto& [site, count] : unreported)
+                    state.m_failures->push_back({ std::string(site.first), site.second, "\nfailed " + withThousands(count) + " more times" });
+            }
+        }
+
+        // A TEST_ASYNC's coroutine, and the test that it is resumed as
+        struct AsyncTest
+        {
+            Task m_task;
+            TestState* m_state = nullptr;
+            // where the test is in the runner's list
+            size_t m_index = 0;
+        };
+
+        // The loop that TEST_ASYNCs run on, on one thread.  Timers are kept in a heap, and fds are waited on with epoll,
+        // each for only as long as something is waiting on it, so a wait costs the same however many tests are waiting.
+        // Whatever was waiting is resumed as the test it is part of, so that its checks count against that test
+        class EventLoop
+        {
+        public:
+            struct Waiter
+            {
+                std::coroutine_handle<> m_handle;
+                AsyncTest* m_test = nullptr;
+            };
+
+            EventLoop()
+                : m_outer(std::exchange(s_eventLoop, this))
+            {
+    #ifdef __linux__
+                m_epoll = ::epoll_create1(EPOLL_CLOEXEC);
+    #endif
+            }
+            ~EventLoop()
+            {
+                s_eventLoop = m_outer;
+    #ifdef __linux__
+                if (m_epoll >= 0)
+                    ::close(m_epoll);
+    #endif
+            }
+            EventLoop(const EventLoop&) = delete;
+            EventLoop& operator=(const EventLoop&) = delete;
+
+            // Resume the waiter on the next pass of the loop
+            void post(Waiter waiter)
+            {
+                m_ready.push_back(waiter);
+            }
+            void addTimer(std::chrono::steady_clock::time_point deadline, Waiter waiter)
+            {
+                m_timers.push_back({ deadline, m_timerSequence++, waiter });
+                std::push_heap(m_timers.begin(), m_timers.end(), std::greater<>());
+            }
+            // Returns false, with why in error, if the fd can't be waited on (it isn't open, is a regular file, or already
+            // has something waiting on it the same way)
+            bool addFd(int fd, bool write, Waiter waiter, std::string& error)
+            {
+    #ifdef __linux__
+                if (m_epoll < 0)
+                {
+                    error = "epoll is unavailable";
+                    return false;
+                }
+                auto& waiters = m_fds[fd];
+                auto& slot = write ? waiters.m_writer : waiters.m_reader;
+                if (slot.m_handle)
+                {
+                    error = std::string("something is already waiting for it to be ") + (write ? "writable" : "readable");
+                    return false;
+                }
+                slot = waiter;
+                if (!updateFd(fd, waiters))
+                {
+                    error = std::strerror(errno);
+                    slot = {};
+                    if (!waiters.m_reader.m_handle && !waiters.m_writer.m_handle)
+                        m_fds.erase(fd);
+                    return false;
+                }
+                return true;
+    #else
+                (void)fd;
+                (void)write;
+                (void)waiter;
+                error = "waiting on fds needs epoll, which is Linux only";
+                return false;
+    #endif
+            }
+
+            // Run until nothing is ready or waiting, calling finished with each test whose coroutine has finished
+            void run(const std::function<void(AsyncTest&)>& finished)
+            {
+                while (true)
+                {
+                    while (!m_ready.empty())
+                    {
+                        const Waiter waiter = m_ready.front();
+                        m_ready.pop_front();
+                        resume(waiter, finished);
+                    }
+                    if (m_timers.empty() && m_fds.empty())
+                        return;
+                    wait();
+                }
+            }
+
+        private:
+            struct Timer
+            {
+                std::chrono::steady_clock::time_point m_deadline;
+                // so that timers with the same deadline fire in the order they were set
+                uint64_t m_sequence = 0;
+                Waiter m_waiter;
+                bool operator>(const Timer& other) const
+                {
+                    return m_deadline != other.m_deadline ? m_deadline > other.m_deadline : m_sequence > other.m_sequence;
+                }
+            };
+            struct FdWaiters
+            {
+                Waiter m_reader;
+                Waiter m_writer;
+                bool m_added = false;
+            };
+
+            static void resume(const Waiter& waiter, const std::function<void(AsyncTest&)>& finished)
+            {
+                AsyncTest& test = *waiter.m_test;
+                TestState* const outerTest = std::exchange(s_currentTest, test.m_state);
+                AsyncTest* const outerAsync = std::exchange(s_currentAsync, &test);
+                waiter.m_handle.resume();
+                const bool done = test.m_task.m_handle.done();
+                if (done && test.m_task.m_handle.promise().m_exception)
+                    recordException(test.m_task.m_handle.promise().m_exception);
+                s_currentAsync = outerAsync;
+                s_currentTest = outerTest;
+                if (done)
+                    finished(test);
+            }
+
+            // Sleep until the first timer is due, or an fd is ready, and make whatever was waiting for them ready
+            void wait()
+            {
+                auto timeout = std::chrono::milliseconds(-1);
+                if (!m_timers.empty())
+                {
+                    const auto remaining = m_timers.front().m_deadline - std::chrono::steady_clock::now();
+                    timeout = std::max(std::chrono::milliseconds(0), std::chrono::ceil<std::chrono::milliseconds>(remaining));
+                }
+    #ifdef __linux__
+                std::array<epoll_event, 64> events{};
+                const int count = ::epoll_wait(m_epoll, events.data(), static_cast<int>(events.size()), static_cast<int>(std::min<std::chrono::milliseconds::rep>(timeout.count(), INT32_MAX)));
+                for (int i = 0; i < count; ++i)
+                {
+                    const int fd = events[static_cast<size_t>(i)].data.fd;
+                    const auto happened = events[static_cast<size_t>(i)].events;
+                    auto& waiters = m_fds.at(fd);
+                    if ((happened & (EPOLLIN | EPOLLHUP | EPOLLERR)) && waiters.m_reader.m_handle)
+                        m_ready.push_back(std::exchange(waiters.m_reader, {}));
+                    if ((happened & (EPOLLOUT | EPOLLHUP | EPOLLERR)) && waiters.m_writer.m_handle)
+                        m_ready.push_back(std::exchange(waiters.m_writer, {}));
+                    if (!waiters.m_reader.m_handle && !waiters.m_writer.m_handle)
+                    {
+                        ::epoll_ctl(m_epoll, EPOLL_CTL_DEL, fd, nullptr);
+                        m_fds.erase(fd);
+                    }
+                    else
+                    {
+                        updateFd(fd, waiters);
+                    }
+                }
+    #else
+                std::this_thread::sleep_for(timeout);
+    #endif
+                const auto now = std::chrono::steady_clock::now();
+                while (!m_timers.empty() && m_timers.front().m_deadline <= now)
+                {
+                    std::pop_heap(m_timers.begin(), m_timers.end(), std::greater<>());
+                    m_ready.push_back(m_timers.back().m_waiter);
+                    m_timers.pop_back();
+                }
+            }
+
+    #ifdef __linux__
+            // Have epoll report what the fd's waiters are waiting for
+            bool updateFd(int fd, FdWaiters& waiters) const
+            {
+                epoll_event event{};
+                event.events = (waiters.m_reader.m_handle ? EPOLLIN : 0u) | (waiters.m_writer.m_handle ? EPOLLOUT : 0u);
+                event.data.fd = fd;
+                if (::epoll_ctl(m_epoll, waiters.m_added ? EPOLL_CTL_MOD : EPOLL_CTL_ADD, fd, &event) != 0)
+                    return false;
+                waiters.m_added = true;
+                return true;
+            }
+
+            int m_epoll = -1;
+    #endif
+            EventLoop* m_outer;
+            std::deque<Waiter> m_ready;
+            std::vector<Timer> m_timers;
+            uint64_t m_timerSequence = 0;
+            std::unordered_map<int, FdWaiters> m_fds;
+        };
+
+        // the loop running on this thread, and the test it is resuming
+        static inline thread_local EventLoop* s_eventLoop = nullptr;
+        static inline thread_local AsyncTest* s_currentAsync = nullptr;
+
+        // A coroutine that ended by throwing fails its test, unless it was stopped by --max-failures
+        static void recordException(const std::exception_ptr& exception)
+        {
+            std::string what = "an exception";
+            try
+            {
+                std::rethrow_exception(exception);
+            }
+            catch (const TestAborted&)
+            {
+                return;
+            }
+            catch (const std::exception& e)
+            {
+                what = e.what();
+            }
+            catch (...)
+            {
+            }
+            recordFailure();
+            recordFailureMessage({ {}, 0, "\nthe test threw " + what + "\n" });
+        }
+
+        // Run the TEST_ASYNCs among tests all at once, on an event loop on this thread, so that while one waits on a
+        // timer or an fd the others carry on.  Each is reported as it finishes, as with --jobs
+        static void runAsyncTests(const std::vector<const TestNode*>& tests, std::vector<TestResult>& results, Reporter& reporter)
+        {
+            struct Running
+            {
+                TestResult m_result;
+                TestState m_state{ 0, &m_result.m_failures, &m_result };
+                std::chrono::steady_clock::time_point m_start;
+            };
+            std::vector<std::unique_ptr<Running>> running(tests.size());
+            std::vector<std::unique_ptr<AsyncTest>> asyncTests;
+            EventLoop loop;
+            for (size_t i = 0; i < tests.size(); ++i)
+            {
+                if (!tests[i]->async())
+                    continue;
+                running[i] = std::make_unique<Running>();
+                running[i]->m_result.m_name = tests[i]->name();
+                asyncTests.push_back(std::make_unique<AsyncTest>(AsyncTest{ tests[i]->async()(), &running[i]->m_state, i }));
+                loop.post({ asyncTests.back()->m_task.m_handle, asyncTests.back().get() });
+                ++PintTest::s_tests_ran;
+                running[i]->m_start = std::chrono::steady_clock::now();
+            }
+            loop.run([&](AsyncTest& test)
+                {
+                    auto& finished = *running[test.m_index];
+                    finished.m_result.m_duration = std::chrono::steady_clock::now() - finished.m_start;
+                    leaveTest(finished.m_state, { s_currentTest, s_soleTest.load() });
+                    finished.m_result.m_fails = finished.m_state.m_fails;
+                    if (!finished.m_result.passed())
+                        ++PintTest::s_tests_failed;
+                    results[test.m_index] = std::move(finished.m_result);
+                    reporter.testStarting(results[test.m_index].m_name);
+                    reporter.testFinished(results[test.m_index]);
+                });
+        }
+
+        // e.g. 9,999,871
+        static std::string withThousands(uint64_t value)
+        {
+            auto text = std::to_string(value);
+            for (auto i = static_cast<std::ptrdiff_t>(text.size()) - 3; i > 0; i -= 3)
+                text.insert(static_cast<size_t>(i), 1, ',');
+            return text;
+        }
+
+        // Run a test body, stopping it if it fails too many checks
+        template <class Fn>
+        static void runStoppable(const Fn& fn)
+        {
+            try
+            {
+                fn();
+            }
+            catch (const TestAborted&)
+            {
+            }
+        }
+
+        // The CPUs that this process may run on, to pin the threads of a stress run to.  Empty if they can't be found
+        static std::vector<int> allowedCpus()
+        {
+            std::vector<int> cpus;
+    #ifdef __linux__
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            if (::sched_getaffinity(0, sizeof(set), &set) == 0)
+            {
+                for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+                    if (CPU_ISSET(cpu, &set))
+                        cpus.push_back(cpu);
+            }
+    #elif defined(_WIN32)
+            DWORD_PTR processMask = 0;
+            DWORD_PTR systemMask = 0;
+            if (GetProcessAffinityMask(GetCurrentProcess(), &processMask, &systemMask))
+            {
+                for (int cpu = 0; cpu < static_cast<int>(sizeof(DWORD_PTR) * 8); ++cpu)
+                    if ((processMask >> cpu) & 1)
+                        cpus.push_back(cpu);
+            }
+    #endif
+            return cpus;
+        }
+
+        // Pin the calling thread to cpu, returning false if it can't be
+        static bool pinThisThread(int cpu)
+        {
+    #ifdef __linux__
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            CPU_SET(cpu, &set);
+            return ::sched_setaffinity(0, sizeof(set), &set) == 0;
+    #elif defined(_WIN32)
+            return SetThreadAffinityMask(GetCurrentThread(), DWORD_PTR(1) << cpu) != 0;
+    #else
+            (void)cpu;
+            return false;
+    #endif
+        }
+
+        // Run a suite's SetUpSuite or TearDownSuite, with any failures going into result
+        static void runSuiteFunction(const std::function<void()>& fn, TestResult& result)
+        {
+            TestState state{ 0, &result.m_failures, &result };
+            const auto outerTest = enterTest(state);
+            runStoppable(fn);
+            leaveTest(state, outerTest);
+            result.m_fails += state.m_fails;
+        }
+
+        // Move each suite's tests together, to where the first of them is, and return the index where each group (a suite,
+        // or a test that isn't in one) starts, followed by the number of tests
+        static std::vector<size_t> groupBySuite(std::vector<const TestNode*>& tests)
+        {
+            std::vector<std::vector<const TestNode*>> groupTests;
+            std::unordered_map<const Suite*, size_t> suiteGroups;
+            for (const auto* test : tests)
+            {
+                if (!test->suite())
+                {
+                    groupTests.push_back({ test });
+                    continue;
+                }
+                const auto [group, added] = suiteGroups.try_emplace(test->suite(), groupTests.size());
+                if (added)
+                    groupTests.emplace_back();
+                groupTests[group->second].push_back(test);
+            }
+            std::vector<size_t> groups{ 0 };
+            tests.clear();
+            for (const auto& group : groupTests)
+            {
+                tests.insert(tests.end(), group.begin(), group.end());
+                groups.push_back(tests.size());
+            }
+            return groups;
+        }
+
+        // Shuffle the groups from groupBySuite, and the tests in each suite, keeping each suite's tests together
+        static void shuffleGroups(std::vector<const TestNode*>& tests, std::vector<size_t>& groups, uint64_t seed)
+        {
+            const auto shuffle = [&seed](auto first, auto last)
+            {
+                for (auto i = last - first - 1; i > 0; --i)
+                    std::iter_swap(first + i, first + static_cast<std::ptrdiff_t>(nextRandom(seed) % static_cast<uint64_t>(i + 1)));
+            };
+            std::vector<std::vector<const TestNode*>> groupTests;
+            for (size_t g = 0; g + 1 < groups.size(); ++g)
+            {
+                groupTests.emplace_back(tests.begin() + static_cast<std::ptrdiff_t>(groups[g]), tests.begin() + static_cast<std::ptrdiff_t>(groups[g + 1]));
+                shuffle(groupTests.back().begin(), groupTests.back().end());
+            }
+            shuffle(groupTests.begin(), groupTests.end());
+            tests.clear();
+            groups.assign(1, 0);
+            for (const auto& group : groupTests)
+            {
+                tests.insert(tests.end(), group.begin(), group.end());
+                groups.push_back(tests.size());
+            }
+        }
+
+        // The hardware counters of one thread, opened as a single perf_event_open group so that they are all counted over
+        // the same instructions.  Each thread that runs tests opens its own group the first time it needs one, and reuses
+        // it for every test after that, so each test only costs a few ioctls
+        class PerfCounterGroup
+        {
+        public:
+            PerfCounterGroup() = default;
+            PerfCounterGroup(const PerfCounterGroup&) = delete;
+            PerfCounterGroup& operator=(const PerfCounterGroup&) = delete;
+            ~PerfCounterGroup() { close(); }
+
+            static PerfCounterGroup& forThisThread()
+            {
+                static thread_local PerfCounterGroup group;
+                return group;
+            }
+
+            // Whether the counters can be used at all.  If not, reason says why
+            static bool available(std::string& reason)
+            {
+    #ifdef __linux__
+                PerfCounterGroup probe;
+                probe.open();
+                if (probe.m_leader < 0)
+                    reason = std::strerror(probe.m_error);
+                return probe.m_leader >= 0;
+    #else
+                reason = "not supported on this platform";
+                return false;
+    #endif
+            }
+
+            void start()
+            {
+    #ifdef __linux__
+                // a forked --isolate worker inherits the parent's group, which counts the parent
+                if (m_pid != getpid())
+                    open();
+                if (m_leader >= 0)
+                {
+                    ioctl(m_leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+                    ioctl(m_leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+                }
+    #endif
+            }
+
+            // Returns nothing if no counter could be read
+            std::optional<PerfCounters> stop()
+            {
+    #ifdef __linux__
+                if (m_leader < 0)
+                    return std::nullopt;
+                ioctl(m_leader, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+
+                // PERF_FORMAT_GROUP: the number of counters, the time enabled and running, then a value per counter
+                std::array<uint64_t, 3 + PerfCounters::COUNTER_COUNT> values{};
+                const auto size = read(m_leader, values.data(), sizeof(values));
+                if (size < static_cast<ssize_t>(3 * sizeof(uint64_t)) || values[2] == 0)
+                    return std::nullopt;
+                // if there were more counters than the PMU could hold they were multiplexed, so scale up to the whole time
+                const double scale = static_cast<double>(values[1]) / static_cast<double>(values[2]);
+                PerfCounters counters;
+                for (size_t i = 0; i < m_counters.size() && i < values[0]; ++i)
+                {
+                    counters.m_values[m_counters[i]] = static_cast<uint64_t>(static_cast<double>(values[3 + i]) * scale + 0.5);
+                    counters.m_available |= 1u << m_counters[i];
+                }
+                return counters;
+    #else
+                return std::nullopt;
+    #endif
+            }
+
+        private:
+    #ifdef __linux__
+            void open()
+            {
+                close();
+                m_pid = getpid();
+                constexpr auto cacheMiss = [](uint64_t cache)
+                    {
+                        return cache | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+                    };
+                const std::array<std::pair<uint32_t, uint64_t>, PerfCounters::COUNTER_COUNT> events{ {
+                    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+                    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+                    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES },
+                    { PERF_TYPE_HW_CACHE, cacheMiss(PERF_COUNT_HW_CACHE_L1D) },
+                    { PERF_TYPE_HW_CACHE, cacheMiss(PERF_COUNT_HW_CACHE_LL) } } };
+                for (size_t i = 0; i < events.size(); ++i)
+                {
+                    perf_event_attr attr{};
+                    attr.size = sizeof(attr);
+                    attr.type = events[i].first;
+                    attr.config = events[i].second;
+                    attr.disabled = m_leader < 0;
+                    attr.exclude_kernel = 1;
+                    attr.exclude_hv = 1;
+                    attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+                    // the first counter that opens leads the group.  Counters the CPU doesn't have are skipped
+                    const auto fd = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, m_leader, PERF_FLAG_FD_CLOEXEC));
+                    if (fd < 0)
+                    {
+                        m_error = errno;
+                        continue;
+                    }
+                    if (m_leader < 0)
+                        m_leader = fd;
+                    m_fds.push_back(fd);
+                    m_counters.push_back(static_cast<PerfCounters::Counter>(i));
+                }
+            }
+            void close()
+            {
+                for (const auto fd : m_fds)
+                    ::close(fd);
+                m_fds.clear();
+                m_counters.clear();
+                m_leader = -1;
+            }
+
+            pid_t m_pid = -1;
+            int m_leader = -1;
+            int m_error = 0;
+            std::vector<int> m_fds;
+            // which counter each fd is, in the order they are read
+            std::vector<PerfCounters::Counter> m_counters;
+    #else
+            void close() {}
+    #endif
+        };
+
+        // What the process has used so far, for --resource-usage, or only this thread while tests run concurrently, as
+        // they would count each other's.  Taken either side of a test, the difference is what the test used
+        class ResourceSample
+        {
+        public:
+            // Returns false where getrusage isn't available
+            bool take()
+            {
+    #ifdef _WIN32
+                return false;
+    #else
+        #ifdef __linux__
+                const int who = s_concurrentTests ? RUSAGE_THREAD : RUSAGE_SELF;
+        #else
+                const int who = RUSAGE_SELF;
+        #endif
+                m_memory = memoryUsage();
+                // the test may have reset the peak itself, with EXPECT_RSS_GROWTH_LE, but what it cleared was its too
+                if (m_memory)
+                    m_memory->m_peakRss = std::max(m_memory->m_peakRss, s_clearedPeakRss.load());
+                return ::getrusage(who, &m_usage) == 0;
+    #endif
+            }
+            [[nodiscard]] ResourceUsage since(const ResourceSample& before) const
+            {
+                ResourceUsage usage;
+    #ifndef _WIN32
+                const auto time = [](const timeval& t) { return std::chrono::seconds(t.tv_sec) + std::chrono::microseconds(t.tv_usec); };
+                const auto count = [](long after, long previous) { return static_cast<uint64_t>(std::max(0L, after - previous)); };
+                usage.m_userTime = time(m_usage.ru_utime) - time(before.m_usage.ru_utime);
+                usage.m_systemTime = time(m_usage.ru_stime) - time(before.m_usage.ru_stime);
+                usage.m_minorFaults = count(m_usage.ru_minflt, before.m_usage.ru_minflt);
+                usage.m_majorFaults = count(m_usage.ru_majflt, before.m_usage.ru_majflt);
+                usage.m_voluntarySwitches = count(m_usage.ru_nvcsw, before.m_usage.ru_nvcsw);
+                usage.m_involuntarySwitches = count(m_usage.ru_nivcsw, before.m_usage.ru_nivcsw);
+    #endif
+                if (m_memory && before.m_memory && m_memory->m_peakRss > before.m_memory->m_peakRss)
+                    usage.m_peakRssGrowth = m_memory->m_peakRss - before.m_memory->m_rss;
+                return usage;
+            }
+
+        private:
+    #ifndef _WIN32
+            rusage m_usage{};
+    #endif
+            std::optional<MemoryUsage> m_memory;
+        };
+
+        // Parse the run time parameters into options.  Returns a value if runAllTests2 should return straight away
+        static std::optional<std::pair<int, int>> parseArgs(const std::vector<std::string_view>& args, Options& options)
+        {
+            const std::string_view filterArg = "--filter=";
+            const std::string_view notFilterArg = "--filter=-";
+            const std::string_view jobsArg = "--jobs=";
+            const std::string_view shardIndexArg = "--shard-index=";
+            const std::string_view totalShardsArg = "--total-shards=";
+            const std::string_view resultsFileArg = "--results-file=";
+            const std::string_view mergeResultsArg = "--merge-results=";
+            const std::string_view outputArg = "--output=";
+            const std::string_view timingDbArg = "--timing-db=";
+            const std::string_view slowestArg = "--slowest=";
+            const std::string_view saveBaselineArg = "--save-baseline=";
+            const std::string_view compareBaselineArg = "--compare-baseline=";
+            const std::string_view regressionThresholdArg = "--regression-threshold=";
+            const std::string_view failuresPerSiteArg = "--failures-per-site=";
+            const std::string_view maxFailuresArg = "--max-failures=";
+            const std::string_view snapshotDirectoryArg = "--snapshot-dir=";
+            const std::string_view seedArg = "--seed=";
+            const std::string_view repeatArg = "--repeat=";
+            const std::string_view propertyCasesArg = "--property-cases=";
+            const std::string_view propertyJobsArg = "--property-jobs=";
+            const std::string_view serveArg = "--serve=";
+            const std::string_view loadArg = "--load=";
+            bool shardIndexGiven = false;
+            bool repeatGiven = false;
+            bool totalShardsGiven = false;
+            for (auto& arg : args)
+            {
+                if (arg.starts_with(filterArg))
+                {
+                    if (arg.size() == filterArg.size())
+                    {
+                        std::cerr << "\"--filter=\" specified without a filter, nothing to do\n";
+                        options.m_nothingToDo = true;
+                        return std::nullopt;
+                    }
+                    if (arg.size() == notFilterArg.size() && arg[arg.size()-1] == '-')
+                    {
+                        std::cerr << "\"--filter=-\" specified without a filter, terminating\n";
+                        return std::pair{ -1, 2 };
+                    }
+                    const bool exclude = arg.starts_with(notFilterArg);
+                    if (const auto error = options.m_filter.add(arg.substr(exclude ? notFilterArg.size() : filterArg.size()), exclude))
+                    {
+                        std::cerr << "\"" << arg << "\": " << *error << ", terminating\n";
+                        return std::pair{ -1, 10 };
+                    }
+                }
+                else if (arg == "--list-tests")
+                {
+                    options.m_listTests = true;
+                }
+                else if (arg.starts_with(jobsArg))
+                {
+                    if (!parseNumber(arg.substr(jobsArg.size()), options.m_jobs))
+                    {
+                        std::cerr << "\"--jobs=\" must be given a number, terminating\n";
+                        return std::pair{ -1, 3 };
+                    }
+                    if (options.m_jobs == 0)
+                        options.m_jobs = std::max(1u, std::thread::hardware_concurrency());
+                }
+                else if (arg == "--isolate")
+                {
+    #ifdef _WIN32
+                    std::cerr << "\"--isolate\" is not supported on this platform, terminating\n";
+                    return std::pair{ -1, 5 };
+    #else
+                    options.m_isolate = true;
+    #endif
+                }
+                else if (arg.starts_with(shardIndexArg))
+                {
+                    shardIndexGiven = parseNumber(arg.substr(shardIndexArg.size()), options.m_shardIndex);
+                    if (!shardIndexGiven)
+                    {
+                        std::cerr << "\"--shard-index=\" must be given a number, terminating\n";
+                        return std::pair{ -1, 4 };
+                    }
+                }
+                else if (arg.starts_with(totalShardsArg))
+                {
+                    totalShardsGiven = parseNumber(arg.substr(totalShardsArg.size()), options.m_totalShards);
+                    if (!totalShardsGiven || options.m_totalShards == 0)
+                    {
+                        std::cerr << "\"--total-shards=\" must be given a positive number, terminating\n";
+                        return std::pair{ -1, 4 };
+                    }
+                }
+                else if (arg.starts_with(resultsFileArg))
+                {
+                    options.m_resultsFile = arg.substr(resultsFileArg.size());
+                }
+                else if (arg.starts_with(mergeResultsArg))
+                {
+                    options.m_mergeFiles.emplace_back(arg.substr(mergeResultsArg.size()));
+                }
+                else if (arg == "--benchmark")
+                {
+                    options.m_benchmark = true;
+                }
+                else if (arg == "--perf-counters")
+                {
+                    options.m_perfCounters = true;
+                }
+                else if (arg == "--resource-usage")
+                {
+                    options.m_resourceUsage = true;
+                }
+                else if (arg == "--update-snapshots")
+                {
+                    options.m_updateSnapshots = true;
+                }
+                else if (arg.starts_with(snapshotDirectoryArg))
+                {
+                    options.m_snapshotDirectory = arg.substr(snapshotDirectoryArg.size());
+                }
+                else if (arg.starts_with(serveArg))
+                {
+                    options.m_serve = arg.substr(serveArg.size());
+                }
+                else if (arg.starts_with(loadArg))
+                {
+                    options.m_loads.emplace_back(arg.substr(loadArg.size()));
+                }
+                else if (arg == "--shuffle")
+                {
+                    options.m_shuffle = true;
+                }
+                else if (arg.starts_with(seedArg))
+                {
+                    const auto value = arg.substr(seedArg.size());
+                    uint64_t seed = 0;
+                    const auto [end, ec] = std::from_chars(value.data(), value.data() + value.size(), seed);
+                    if (value.empty() || ec != std::errc() || end != value.data() + value.size())
+                    {
+                        std::cerr << "\"--seed=\" must be given a number, terminating\n";
+                        return std::pair{ -1, 14 };
+                    }
+                    options.m_seed = seed;
+                }
+                else if (arg.starts_with(repeatArg))
+                {
+                    repeatGiven = parseNumber(arg.substr(repeatArg.size()), options.m_repeat);
+                    if (!repeatGiven || options.m_repeat == 0)
+                    {
+                        std::cerr << "\"--repeat=\" must be given a positive number, terminating\n";
+                        return std::pair{ -1, 14 };
+                    }
+                }
+                else if (arg == "--until-fail")
+                {
+                    options.m_untilFail = true;
+                }
+                else if (arg.starts_with(propertyCasesArg))
+                {
+                    if (!parseNumber(arg.substr(propertyCasesArg.size()), options.m_propertyCases) || options.m_propertyCases == 0)
+                    {
+                        std::cerr << "\"--property-cases=\" must be given a positive number, terminating\n";
+                        return std::pair{ -1, 15 };
+                    }
+                }
+                else if (arg.starts_with(propertyJobsArg))
+                {
+                    if (!parseNumber(arg.substr(propertyJobsArg.size()), options.m_propertyJobs))
+                    {
+                        std::cerr << "\"--property-jobs=\" must be given a number, terminating\n";
+                        return std::pair{ -1, 15 };
+                    }
+                    if (options.m_propertyJobs == 0)
+                        options.m_propertyJobs = std::max(1u, std::thread::hardware_concurrency());
+                }
+                else if (arg.starts_with(outputArg))
+                {
+                    options.m_outputs.emplace_back(arg.substr(outputArg.size()));
+                }
+                else if (arg.starts_with(timingDbArg))
+                {
+                    options.m_timingDb = arg.substr(timingDbArg.size());
+                }
+                else if (arg.starts_with(slowestArg))
+                {
+                    if (!parseNumber(arg.substr(slowestArg.size()), options.m_slowest))
+                    {
+                        std::cerr << "\"--slowest=\" must be given a number, terminating\n";
+                        return std::pair{ -1, 9 };
+                    }
+                }
+                else if (arg.starts_with(saveBaselineArg))
+                {
+                    options.m_saveBaseline = arg.substr(saveBaselineArg.size());
+                }
+                else if (arg.starts_with(compareBaselineArg))
+                {
+                    options.m_compareBaseline = arg.substr(compareBaselineArg.size());
+                }
+                else if (arg.starts_with(regressionThresholdArg))
+                {
+                    const auto value = arg.substr(regressionThresholdArg.size());
+                    const auto [end, ec] = std::from_chars(value.data(), value.data() + value.size(), options.m_regressionThreshold);
+                    if (value.empty() || ec != std::errc() || end != value.data() + value.size() || options.m_regressionThreshold < 0)
+                    {
+                        std::cerr << "\"--regression-threshold=\" must be given a percentage, terminating\n";
+                        return std::pair{ -1, 12 };
+                    }
+                }
+                else if (arg.starts_with(failuresPerSiteArg))
+                {
+                    if (!parseNumber(arg.substr(failuresPerSiteArg.size()), options.m_failuresPerSite))
+                    {
+                        std::cerr << "\"--failures-per-site=\" must be given a number, terminating\n";
+                        return std::pair{ -1, 13 };
+                    }
+                }
+                else if (arg.starts_with(maxFailuresArg))
+                {
+                    if (!parseNumber(arg.substr(maxFailuresArg.size()), options.m_maxFailures))
+                    {
+                        std::cerr << "\"--max-failures=\" must be given a number, terminating\n";
+                        return std::pair{ -1, 13 };
+                    }
+                }
+            }
+            options.m_filter.compile();
+            if (shardIndexGiven != totalShardsGiven || options.m_shardIndex >= options.m_totalShards)
+            {
+                std::cerr << "\"--shard-index=\" and \"--total-shards=\" must be given together, with the index less than the total, terminating\n";
+                return std::pair{ -1, 4 };
+            }
+            if (options.m_untilFail && !repeatGiven)
+                options.m_repeat = std::numeric_limits<unsigned>::max();
+            if (options.m_serve.empty() && !options.m_loads.empty())
+            {
+                std::cerr << "\"--load=\" is only for \"--serve=\", terminating\n";
+                return std::pair{ -1, 16 };
+            }
+            return std::nullopt;
+        }
+
+        // The tests that pass the filter and are in this shard
+        static std::vector<const TestNode*> selectTests(const Options& options, const Timings& timings)
+        {
+            std::vector<const TestNode*> matched;
+            for (auto* test = TestNode::first(); test; test = test->next())
+                if (options.m_filter.matches(test->name()))
+                    matched.push_back(test);
+            return selectShard(matched, options.m_shardIndex, options.m_totalShards, timings);
+        }
+
+        // The storage for the tests and benchmarks registered with registerTestFn and registerBenchmarkFn.  A deque, so that
+        // the names and functions that the registrations point at never move, and a function static, so that it is
+        // constructed before its first use from a static initialiser
+        template <class... Args>
+        struct RegisteredFunction
+        {
+            RegisteredFunction(const char* name, std::function<void(Args...)> fn, const Suite* suite = nullptr)
+                : m_name(name), m_fn(std::move(fn)), m_registration(m_name.c_str(), &m_fn, suite)
+            {
+            }
+            std::string m_name;
+            std::function<void(Args...)> m_fn;
+            Registration<Args...> m_registration;
+        };
+        template <class... Args>
+        static std::deque<RegisteredFunction<Args...>>& registeredFunctions()
+        {
+            static std::deque<RegisteredFunction<Args...>> functions;
+            return functions;
+        }
+
+        // Tests and benchmarks share a namespace.  Rather than look each name up as it is registered, the names are checked
+        // once, when the tests are first run (and again if more are registered), by inserting them into a flat, open
+        // addressed table that is allocated in one go
+        static std::optional<std::string> findDuplicateName()
+        {
+            // the registrations as they were when last found to have no duplicates
+            static std::pair<uint64_t, uint64_t> checked{ 0, 0 };
+            const std::pair generations{ TestNode::generation(), BenchmarkNode::generation() };
+            if (generations == checked)
+                return std::nullopt;
+            const auto count = TestNode::count() + BenchmarkNode::count();
+
+            std::vector<const char*> table(std::bit_ceil(count * 2 + 1), nullptr);
+            const auto mask = table.size() - 1;
+            const auto insert = [&table, mask](const char* name)
+                {
+                    for (auto slot = std::hash<std::string_view>()(name) & mask; ; slot = (slot + 1) & mask)
+                    {
+                        if (!table[slot])
+                        {
+                            table[slot] = name;
+                            return true;
+                        }
+                        if (std::strcmp(table[slot], name) == 0)
+                            return false;
+                    }
+                };
+            for (auto* test = TestNode::first(); test; test = test->next())
+                if (!insert(test->name()))
+                    return std::string(test->name());
+            for (auto* benchmark = BenchmarkNode::first(); benchmark; benchmark = benchmark->next())
+                if (!insert(benchmark->name()))
+                    return std::string(benchmark->name());
+            checked = generations;
+            return std::nullopt;
+        }
+
+        // Write the names of the tests (and benchmarks, with --benchmark) that would be run, one per line
+        static void listTests(const Options& options)
+        {
+            const auto timings = options.m_timingDb.empty() ? Timings{} : loadTimings(options.m_timingDb);
+            std::string names;
+            for (const auto* test : selectTests(options, timings))
+                names.append(test->name()).push_back('\n');
+            if (options.m_benchmark)
+                for (auto* benchmark = BenchmarkNode::first(); benchmark; benchmark = benchmark->next())
+                    if (options.m_filter.matches(benchmark->name()))
+                        names.append(benchmark->name()).push_back('\n');
+            std::cout << names << std::flush;
+        }
+
+        template <class T>
+        static bool parseNumber(std::string_view value, T& number)
+        {
+            const auto [end, ec] = std::from_chars(value.data(), value.data() + value.size(), number);
+            return !value.empty() && ec == std::errc() && end == value.data() + value.size();
+        }
+
+        // Create the reporters picked by --output= (or the console reporter if there aren't any), along with any added by
+        // addReporter.  Returns null if an --output= is invalid
+        static std::unique_ptr<Reporter> createReporter(const Options& options);
+
+        // The timing database is a text file with one line per test: the duration in nanoseconds and the name, separated
+        // by a tab.  A missing file is just an empty database
+        static Timings loadTimings(const std::string& fileName)
+        {
+            Timings timings;
+            std::ifstream file(fileName);
+            std::string line;
+            while (std::getline(file, line))
+            {
+                const auto tab = line.find('\t');
+                if (tab == std::string::npos)
+                    continue;
+                long long durationNs = 0;
+                const auto [end, ec] = std::from_chars(line.data(), line.data() + tab, durationNs);
+                if (ec == std::errc() && end == line.data() + tab)
+                    timings[line.substr(tab + 1)] = std::chrono::nanoseconds(durationNs);
+            }
+            return timings;
+        }
+
+        // Written to a temporary file which then replaces the database, so that a run which is killed part way through
+        // saving doesn't leave it truncated
+        static bool saveTimings(const std::string& fileName, const Timings& timings)
+        {
+            std::vector<std::pair<std::string, std::chrono::nanoseconds>> sorted(timings.begin(), timings.end());
+            std::sort(sorted.begin(), sorted.end());
+            const auto tempName = fileName + ".tmp";
+            {
+                std::ofstream file(tempName);
+                for (const auto& [name, duration] : sorted)
+                    file << duration.count() << '\t' << name << '\n';
+                if (!file.flush())
+                    return false;
+            }
+            std::error_code ec;
+            std::filesystem::rename(tempName, fileName, ec);
+            return !ec;
+        }
+
+        // The timing samples of each test (durations in ns) and benchmark (ns/iter), by name, as saved by --save-baseline
+        using Samples = std::unordered_map<std::string, std::vector<double>>;
+        struct Baseline
+        {
+            Samples m_tests;
+            Samples m_benchmarks;
+        };
+        static constexpr size_t BASELINE_SAMPLES = 20;
+        // the significance level of the comparisons with the baseline
+        static constexpr double BASELINE_ALPHA = 0.05;
+
+        // One line per test or benchmark: "test" or "benchmark", the name, and the samples, separated by tabs
+        static bool loadBaseline(const std::string& fileName, Baseline& baseline)
+        {
+            std::ifstream file(fileName);
+            if (!file)
+                return false;
+            std::string line;
+            while (std::getline(file, line))
+            {
+                const auto kindEnd = line.find('\t');
+                const auto nameEnd = kindEnd == std::string::npos ? std::string::npos : line.find('\t', kindEnd + 1);
+                if (nameEnd == std::string::npos)
+                    continue;
+                const std::string_view kind(line.data(), kindEnd);
+                if (kind != "test" && kind != "benchmark")
+                    continue;
+                auto& samples = (kind == "test" ? baseline.m_tests : baseline.m_benchmarks)[line.substr(kindEnd + 1, nameEnd - kindEnd - 1)];
+                const char* position = line.data() + nameEnd + 1;
+                const char* const end = line.data() + line.size();
+                while (position < end)
+                {
+                    double sample = 0;
+                    const auto [next, ec] = std::from_chars(position, end, sample);
+                    if (ec != std::errc())
+                        break;
+                    samples.push_back(sample);
+                    position = next + (next < end ? 1 : 0);
+                }
+            }
+            return true;
+        }
+
+        // Saved in the same way as the timing database
+        static bool saveBaseline(const std::string& fileName, const Baseline& baseline)
+        {
+            const auto tempName = fileName + ".tmp";
+            {
+                std::ofstream file(tempName);
+                for (const auto& [kind, samples] : { std::pair{ "test", &baseline.m_tests }, std::pair{ "benchmark", &baseline.m_benchmarks } })
+                {
+                    std::vector<std::pair<std::string, std::vector<double>>> sorted(samples->begin(), samples->end());
+                    std::sort(sorted.begin(), sorted.end());
+                    for (const auto& [name, values] : sorted)
+                    {
+                        file << kind << '\t' << name;
+                        char separator = '\t';
+                        for (const auto value : values)
+                        {
+                            std::array<char, 32> text{};
+                            const auto [end, ec] = std::to_chars(text.data(), text.data() + text.size(), value);
+                            file << separator << std::string_view(text.data(), static_cast<size_t>(end - text.data()));
+                            separator = ' ';
+                        }
+                        file << '\n';
+                    }
+                }
+                if (!file.flush())
+                    return false;
+            }
+            std::error_code ec;
+            std::filesystem::rename(tempName, fileName, ec);
+            return !ec;
+        }
+
+        // The samples of a run: the durations of the tests that passed, and the samples of the benchmarks that did.  A
+        // test run more than once has a sample for each time
+        static Baseline baselineOf(const std::vector<TestResult>& results, const std::vector<BenchmarkResult>& benchmarkResults)
+        {
+            Baseline baseline;
+            for (const auto& result : results)
+                if (result.passed())
+                    baseline.m_tests[result.m_name].push_back(static_cast<double>(result.m_duration.count()));
+            for (const auto& result : benchmarkResults)
+                if (result.passed())
+                    baseline.m_benchmarks[result.m_name] = result.m_samples;
+            return baseline;
+        }
+
+        static double median(std::vector<double> samples)
+        {
+            const auto middle = samples.begin() + static_cast<std::ptrdiff_t>(samples.size() / 2);
+            std::nth_element(samples.begin(), middle, samples.end());
+            if (samples.size() % 2)
+                return *middle;
+            return (*middle + *std::max_element(samples.begin(), middle)) / 2;
+        }
+
+        // The one-sided p-value of the Mann-Whitney U test that the current samples tend to be larger than the baseline
+        // ones.  U counts the (current, baseline) pairs where the current sample is larger, with ties counting half.  The
+        // distribution of U is worked out exactly for small samples, as the coefficients of the Gaussian binomial
+        // [n + m choose n], and otherwise approximated by a normal distribution, with the correction for ties
+        static double mannWhitneyP(const std::vector<double>& baseline, const std::vector<double>& current)
+        {
+            const size_t n = current.size();
+            const size_t m = baseline.size();
+            if (n == 0 || m == 0)
+                return 1.0;
+            double u = 0;
+            for (const auto c : current)
+                for (const auto b : baseline)
+                    u += c > b ? 1.0 : c == b ? 0.5 : 0.0;
+
+            if (n * m <= 10000)
+            {
+                // multiply the polynomial by (1 - q^(m+i)) / (1 - q^i) for each i up to n
+                std::vector<double> ways(n * m + 1);
+                ways[0] = 1;
+                for (size_t i = 1; i <= n; ++i)
+                {
+                    // the terms above n * m cancel out in the end, so aren't kept
+                    const size_t shift = m + i;
+                    for (size_t k = std::min(ways.size() - 1, (i - 1) * m + shift); k >= shift; --k)
+                        ways[k] -= ways[k - shift];
+                    for (size_t k = i; k < ways.size(); ++k)
+                        ways[k] += ways[k - i];
+                }
+                double total = 0;
+                double atLeast = 0;
+                // with ties U can be a half, which is rounded down so as not to overstate the significance
+                const auto threshold = static_cast<size_t>(u);
+                for (size_t k = 0; k < ways.size(); ++k)
+                {
+                    total += ways[k];
+                    if (k >= threshold)
+                        atLeast += ways[k];
+                }
+                return atLeast / total;
+            }
+
+            std::vector<double> all(current);
+            all.insert(all.end(), baseline.begin(), baseline.end());
+            std::sort(all.begin(), all.end());
+            double ties = 0;
+            for (size_t i = 0; i < all.size(); )
+            {
+                size_t j = i;
+                while (j < all.size() && all[j] == all[i])
+                    ++j;
+                const auto t = static_cast<double>(j - i);
+                ties += t * t * t - t;
+                i = j;
+            }
+            const auto dn = static_cast<double>(n);
+            const auto dm = static_cast<double>(m);
+            const auto total = dn + dm;
+            const double variance = dn * dm / 12.0 * ((total + 1) - ties / (total * (total - 1)));
+            if (variance <= 0)
+                return 1.0;
+            const double z = (u - dn * dm / 2 - 0.5) / std::sqrt(variance);
+            return 0.5 * std::erfc(z / std::sqrt(2.0));
+        }
+
+        // Record a failure if the current samples are significantly slower than the baseline ones, by more than the threshold
+        static void checkRegression(const std::string& name, const std::vector<double>& baseline, const std::vector<double>& current, const Options& options)
+        {
+            if (baseline.empty() || current.empty())
+                return;
+            const double before = median(baseline);
+            const double after = median(current);
+            if (after <= before * (1 + options.m_regressionThreshold / 100))
+                return;
+            const double p = mannWhitneyP(baseline, current);
+            if (p >= BASELINE_ALPHA)
+                return;
+            std::ostringstream message;
+            message << std::fixed << std::setprecision(1) << "\n" << name << " is slower than the baseline\nExpected: median " << before << "ns (of "
+                << baseline.size() << " samples) + " << options.m_regressionThreshold << "%\nActual: median " << after << "ns (of " << current.size()
+                << " samples), " << (after / before - 1) * 100 << "% slower, p = " << std::defaultfloat << std::setprecision(3) << p << "\n";
+            recordFailure();
+            recordFailureMessage({ options.m_compareBaseline, 0, message.str() });
+        }
+
+        // Pick the tests for this shard.  Without timings the tests are dealt out round robin.  With them, each test
+        // (longest first) goes to the shard with the least total time so far, which balances the shards by time rather
+        // than count.  Tests without a timing are assumed to take the average time.  Every shard does the same sums, so
+        // they all need the same timing database
+        // A suite's tests all go to the same shard
+        static std::vector<const TestNode*> selectShard(std::vector<const TestNode*> matched, unsigned shardIndex, unsigned totalShards, const Timings& timings)
+        {
+            const auto groups = groupBySuite(matched);
+            const auto addGroup = [&matched, &groups](std::vector<const TestNode*>& selected, size_t g)
+                {
+                    selected.insert(selected.end(), matched.begin() + static_cast<std::ptrdiff_t>(groups[g]), matched.begin() + static_cast<std::ptrdiff_t>(groups[g + 1]));
+                };
+            std::vector<const TestNode*> selected;
+            if (totalShards <= 1 || timings.empty())
+            {
+                for (size_t g = 0; g + 1 < groups.size(); ++g)
+                    if (g % totalShards == shardIndex)
+                        addGroup(selected, g);
+                return selected;
+            }
+
+            std::chrono::nanoseconds total{};
+            for (const auto& [name, duration] : timings)
+                total += duration;
+            const std::chrono::nanoseconds average = total / static_cast<long long>(timings.size());
+
+            std::vector<std::pair<std::chrono::nanoseconds, size_t>> byDuration;
+            for (size_t g = 0; g + 1 < groups.size(); ++g)
+            {
+                std::chrono::nanoseconds duration{};
+                for (size_t i = groups[g]; i < groups[g + 1]; ++i)
+                {
+                    const auto timing = timings.find(matched[i]->name());
+                    duration += timing == timings.end() ? average : timing->second;
+                }
+                byDuration.emplace_back(duration, g);
+            }
+            std::stable_sort(byDuration.begin(), byDuration.end(), [&matched, &groups](const auto& l, const auto& r)
+                {
+                    return l.first > r.first || (l.first == r.first && std::strcmp(matched[groups[l.second]]->name(), matched[groups[r.second]]->name()) < 0);
+                });
+
+            std::vector<std::chrono::nanoseconds> shardTotals(totalShards);
+            for (const auto& [duration, g] : byDuration)
+            {
+                const auto shard = static_cast<unsigned>(std::min_element(shardTotals.begin(), shardTotals.end()) - shardTotals.begin());
+                shardTotals[shard] += duration;
+                if (shard == shardIndex)
+                    addGroup(selected, g);
+            }
+            return selected;
+        }
+
+        // One line per test: status, number of failed checks, duration in nanoseconds and name, separated by tabs
+        static bool writeResults(const std::string& fileName, const std::vector<TestResult>& results)
+        {
+            std::ofstream file(fileName);
+            file << "# PintTest results\n";
+            for (const auto& result : results)
+            {
+                const auto status = result.m_crashed ? "CRASHED" : result.passed() ? "PASSED" : "FAILED";
+                file << status << '\t' << result.m_fails << '\t' << result.m_duration.count() << '\t' << result.m_name << '\n';
+            }
+            return static_cast<bool>(file.flush());
+        }
+
+        // Combine the results files written by the shards of a sharded run (via --results-file=) into a single summary
+        static std::pair<int, int> mergeResults(const std::vector<std::string>& fileNames)
+        {
+            s_tests_ran = 0;
+            s_tests_failed = 0;
+            s_fails = 0;
+            for (const auto& fileName : fileNames)
+            {
+                std::ifstream file(fileName);
+                if (!file)
+                {
+                    std::cerr << "Unable to read the results file \"" << fileName << "\", terminating\n";
+                    return { -1, 6 };
+                }
+                std::string line;
+                while (std::getline(file, line))
+                {
+                    if (line.empty() || line[0] == '#')
+                        continue;
+                    std::istringstream fields(line);
+                    std::string status;
+                    int fails = 0;
+                    long long durationNs = 0;
+                    std::string name;
+                    if (!(fields >> status >> fails >> durationNs) || !std::getline(fields >> std::ws, name))
+                    {
+                        std::cerr << "Malformed line in the results file \"" << fileName << "\": " << line << ", terminating\n";
+                        return { -1, 6 };
+                    }
+                    ++s_tests_ran;
+                    if (status != "PASSED")
+                    {
+                        ++s_tests_failed;
+                        s_fails += std::max(fails, 1);
+                        std::cout << RED_TEXT_START << status << " " << name << " (" << fileName << ")" << COLOUR_TEXT_END << "\n";
+                    }
+                }
+            }
+            if (s_fails)
+                std::cout << RED_TEXT_START << "Merged " << fileNames.size() << " results files: ran " << s_tests_ran << " tests and " << s_tests_failed << " failed" << COLOUR_TEXT_END << "\n";
+            else
+                std::cout << GREEN_TEXT_START << "Merged " << fileNames.size() << " results files: ran " << s_tests_ran << " tests and none failed" << COLOUR_TEXT_END << "\n";
+            return { s_tests_ran, s_fails };
+        }
+
+        // Helpers to pass results between processes as a sequence of trivially copyable values and length prefixed strings
+        template <class T>
+        static void serialize(std::string& out, const T& value)
+        {
+            static_assert(std::is_trivially_copyable_v<T>);
+            out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+        }
+        static void serialize(std::string& out, const std::string& value)
+        {
+            serialize(out, static_cast<uint32_t>(value.size()));
+            out += value;
+        }
+        template <class T>
+        static bool deserialize(std::string_view& in, T& value)
+        {
+            static_assert(std::is_trivially_copyable_v<T>);
+            if (in.size() < sizeof(value))
+                return false;
+            std::memcpy(&value, in.data(), sizeof(value));
+            in.remove_prefix(sizeof(value));
+            return true;
+        }
+        static bool deserialize(std::string_view& in, std::string& value)
+        {
+            uint32_t size = 0;
+            if (!deserialize(in, size) || in.size() < size)
+                return false;
+            value.assign(in.data(), size);
+            in.remove_prefix(size);
+            return true;
+        }
+
+        // Everything in a TestResult apart from the name, which the parent process already knows
+        static std::string serializeResult(const TestResult& result)
+        {
+            std::string out;
+            serialize(out, static_cast<int32_t>(result.m_fails));
+            serialize(out, static_cast<int64_t>(result.m_duration.count()));
+            serialize(out, static_cast<uint32_t>(result.m_failures.size()));
+            for (const auto& failure : result.m_failures)
+            {
+                serialize(out, failure.m_file);
+                serialize(out, static_cast<uint32_t>(failure.m_line));
+                serialize(out, failure.m_message);
+            }
+            serialize(out, static_cast<uint8_t>(result.m_counters.has_value()));
+            if (result.m_counters)
+                serialize(out, *result.m_counters);
+            serialize(out, static_cast<uint8_t>(result.m_allocations.has_value()));
+            if (result.m_allocations)
+                serialize(out, *result.m_allocations);
+            serialize(out, static_cast<uint8_t>(result.m_resources.has_value()));
+            if (result.m_resources)
+                serialize(out, *result.m_resources);
+            serialize(out, static_cast<uint32_t>(result.m_stress.size()));
+            for (const auto& stress : result.m_stress)
+            {
+                serialize(out, static_cast<int64_t>(stress.m_elapsed.count()));
+                serialize(out, static_cast<uint32_t>(stress.m_threads.size()));
+                for (const auto& thread : stress.m_threads)
+                    serialize(out, thread);
+            }
+            serialize(out, static_cast<uint32_t>(result.m_latencies.size()));
+            for (const auto& latency : result.m_latencies)
+            {
+                serialize(out, latency.m_name);
+                serialize(out, latency.m_count);
+                serialize(out, latency.m_values);
+            }
+            return out;
+        }
+        static bool deserializeResult(std::string_view in, TestResult& result)
+        {
+            int32_t fails = 0;
+            int64_t durationNs = 0;
+            uint32_t failureCount = 0;
+            if (!deserialize(in, fails) || !deserialize(in, durationNs) || !deserialize(in, failureCount))
+                return false;
+            result.m_fails = fails;
+            result.m_duration = std::chrono::nanoseconds(durationNs);
+            for (uint32_t i = 0; i < failureCount; ++i)
+            {
+                Failure failure;
+                uint32_t line = 0;
+                if (!deserialize(in, failure.m_file) || !deserialize(in, line) || !deserialize(in, failure.m_message))
+                    return false;
+                failure.m_line = line;
+                result.m_failures.push_back(std::move(failure));
+            }
+            uint8_t hasCounters = 0;
+            if (!deserialize(in, hasCounters))
+                return false;
+            if (hasCounters)
+            {
+                PerfCounters counters;
+                if (!deserialize(in, counters))
+                    return false;
+                result.m_counters = counters;
+            }
+            uint8_t hasAllocations = 0;
+            if (!deserialize(in, hasAllocations))
+                return false;
+            if (hasAllocations)
+            {
+                AllocationCounts allocations;
+                if (!deserialize(in, allocations))
+                    return false;
+                result.m_allocations = allocations;
+            }
+            uint8_t hasResources = 0;
+            if (!deserialize(in, hasResources))
+                return false;
+            if (hasResources)
+            {
+                ResourceUsage resources;
+                if (!deserialize(in, resources))
+                    return false;
+                result.m_resources = resources;
+            }
+            uint32_t stressCount = 0;
+            if (!deserialize(in, stressCount))
+                return false;
+            for (uint32_t i = 0; i < stressCount; ++i)
+            {
+                StressResult stress;
+                int64_t elapsedNs = 0;
+                uint32_t threadCount = 0;
+                if (!deserialize(in, elapsedNs) || !deserialize(in, threadCount))
+                    return false;
+                stress.m_elapsed = std::chrono::nanoseconds(elapsedNs);
+                stress.m_threads.resize(threadCount);
+                for (auto& thread : stress.m_threads)
+                    if (!deserialize(in, thread))
+                        return false;
+                result.m_stress.push_back(std::move(stress));
+            }
+            uint32_t latencyCount = 0;
+            if (!deserialize(in, latencyCount))
+                return false;
+            for (uint32_t i = 0; i < latencyCount; ++i)
+            {
+                LatencySummary latency;
+                if (!deserialize(in, latency.m_name) || !deserialize(in, latency.m_count) || !deserialize(in, latency.m_values))
+                    return false;
+                result.m_latencies.push_back(std::move(latency));
+            }
+            return true;
+        }
+
+    #ifndef _WIN32
+        // Returns false if the fd was closed, or failed, before all of it was written
+        static bool writeAll(int fd, const char* data, size_t size)
+        {
+            while (size > 0)
+            {
+                const auto written = ::write(fd, data, size);
+                if (written < 0 && errno == EINTR)
+                    continue;
+                if (written <= 0)
+                    return false;
+                data += written;
+                size -= static_cast<size_t>(written);
+            }
+            return true;
+        }
+    #endif
+
+        // Runs the tests in forked worker processes, so that a test which crashes or calls exit only takes its worker down.
+        // Each of the workers is dealt a slice of the tests round robin, and reports back over a pipe as it starts and
+        // finishes each one.  If a worker dies part way through a test then that test is marked as crashed and a new worker
+        // is forked for the rest of the slice.  The tests of a worker that can't be started fail, as do those of every
+        // worker if they can't be waited for.
+        // groups is as returned by groupBySuite, and each worker is given whole groups
+        static void runIsolated(const std::vector<const TestNode*>& toRun, const std::vector<size_t>& groups, unsigned jobs, std::vector<TestResult>& results, Reporter& reporter)
+        {
+    #ifdef _WIN32
+            (void)toRun; (void)groups; (void)jobs; (void)results; (void)reporter;
+    #else
+            // A worker sends a Started record as it starts each test, and a Finished record followed by the serialized
+            // TestResult when it's done
+            struct Record
+            {
+                uint32_t m_finished;
+                uint32_t m_index;
+                uint32_t m_payloadSize;
+            };
+            struct Worker
+            {
+                std::vector<size_t> m_slice;    // the indices of the worker's tests, in the order it runs them
+                size_t m_next = 0;              // the position in m_slice of the next test that hasn't finished
+                pid_t m_pid = -1;
+                int m_fd = -1;
+                std::string m_buffer;
+            };
+
+            const auto spawn = [&](Worker& worker)
+            {
+                int fds[2];
+                if (::pipe(fds) != 0)
+                {
+                    std::cerr << "Unable to create a pipe for a worker process\n";
+                    return false;
+                }
+                std::cout.flush();
+                std::cerr.flush();
+                const pid_t pid = ::fork();
+                if (pid < 0)
+                {
+                    ::close(fds[0]);
+                    ::close(fds[1]);
+                    std::cerr << "Unable to fork a worker process\n";
+                    return false;
+                }
+                if (pid == 0)
+                {
+                    ::close(fds[0]);
+                    // a worker that replaces one that crashed part way through a suite sets the suite up again
+                    SuiteInProgress current;
+                    for (size_t position = worker.m_next; position < worker.m_slice.size(); ++position)
+                    {
+                        const auto i = worker.m_slice[position];
+                        Record started{ 0, static_cast<uint32_t>(i), 0 };
+                        writeAll(fds[1], reinterpret_cast<const char*>(&started), sizeof(started));
+                        const auto payload = serializeResult(executeInSuite(toRun, groups, i, current));
+                        Record finished{ 1, static_cast<uint32_t>(i), static_cast<uint32_t>(payload.size()) };
+                        writeAll(fds[1], reinterpret_cast<const char*>(&finished), sizeof(finished));
+                        writeAll(fds[1], payload.data(), payload.size());
+                    }
+                    std::cout.flush();
+                    ::_exit(0);
+                }
+                ::close(fds[1]);
+                worker.m_pid = pid;
+                worker.m_fd = fds[0];
+                worker.m_buffer.clear();
+                return true;
+            };
+
+            const auto record = [&results, &reporter](size_t index, TestResult result)
+            {
+                ++s_tests_ran;
+                s_fails += result.m_fails;
+                if (!result.passed())
+                    ++s_tests_failed;
+                reporter.testStarting(result.m_name);
+                reporter.testFinished(result);
+                results[index] = std::move(result);
+            };
+
+            const auto markCrashed = [&](Worker& worker, int status)
+            {
+                const auto index = worker.m_slice[worker.m_next++];
+                TestResult result;
+                result.m_name = toRun[index]->name();
+                result.m_fails = 1;
+                result.m_crashed = true;
+                std::ostringstream reason;
+                if (WIFSIGNALED(status))
+                    reason << "was killed by signal " << WTERMSIG(status);
+                else if (WIFEXITED(status))
+                    reason << "exited with status " << WEXITSTATUS(status);
+                else
+                    reason << "stopped unexpectedly";
+                result.m_failures.push_back({ {}, 0, reason.str() });
+                record(index, std::move(result));
+            };
+
+            // Fail the rest of a worker's slice, which it can't run
+            const auto markNotRun = [&](Worker& worker, const std::string& reason)
+            {
+                for (; worker.m_next < worker.m_slice.size(); ++worker.m_next)
+                {
+                    const auto index = worker.m_slice[worker.m_next];
+                    TestResult result;
+                    result.m_name = toRun[index]->name();
+                    result.m_fails = 1;
+                    result.m_failures.push_back({ {}, 0, reason });
+                    record(index, std::move(result));
+                }
+            };
+
+            ::signal(SIGPIPE, SIG_IGN);
+            jobs = static_cast<unsigned>(std::max<size_t>(1, std::min<size_t>(jobs, groups.size() - 1)));
+            std::vector<Worker> workers(jobs);
+            for (unsigned w = 0; w < jobs; ++w)
+            {
+                for (const auto g : dealRoundRobin(groups.size() - 1, jobs, w))
+                    for (size_t i = groups[g]; i < groups[g + 1]; ++i)
+                        workers[w].m_slice.push_back(i);
+                if (!workers[w].m_slice.empty() && !spawn(workers[w]))
+                    markNotRun(workers[w], "couldn't start a worker process to run the test");
+            }
+
+            while (true)
+            {
+                std::vector<pollfd> fds;
+                std::vector<Worker*> polled;
+                for (auto& worker : workers)
+                {
+                    if (worker.m_fd >= 0)
+                    {
+                        fds.push_back({ worker.m_fd, POLLIN, 0 });
+                        polled.push_back(&worker);
+                    }
+                }
+                if (fds.empty())
+                    break;
+                if (::poll(fds.data(), fds.size(), -1) < 0)
+                {
+                    if (errno == EINTR)
+                        continue;
+                    std::cerr << "poll failed while waiting for the worker processes\n";
+                    for (auto* worker : polled)
+                    {
+                        ::kill(worker->m_pid, SIGKILL);
+                        ::close(worker->m_fd);
+                        worker->m_fd = -1;
+                        while (::waitpid(worker->m_pid, nullptr, 0) < 0 && errno == EINTR)
+                            ;
+                        markNotRun(*worker, "the worker process running the test was stopped, as waiting for it failed");
+                    }
+                    break;
+                }
+                for (size_t f = 0; f < fds.size(); ++f)
+                {
+                    if (fds[f].revents == 0)
+                        continue;
+                    Worker& worker = *polled[f];
+                    char buffer[65536];
+                    const auto bytesRead = ::read(worker.m_fd, buffer, sizeof(buffer));
+                    if (bytesRead < 0 && errno == EINTR)
+                        continue;
+                    if (bytesRead > 0)
+                    {
+                        worker.m_buffer.append(buffer, static_cast<size_t>(bytesRead));
+                        while (worker.m_buffer.size() >= sizeof(Record))
+                        {
+                            Record header;
+                            std::memcpy(&header, worker.m_buffer.data(), sizeof(header));
+                            if (worker.m_buffer.size() < sizeof(header) + header.m_payloadSize)
+                                break;
+                            if (header.m_finished != 0)
+                            {
+                                TestResult result;
+                                result.m_name = toRun[header.m_index]->name();
+                                if (!deserializeResult(std::string_view(worker.m_buffer).substr(sizeof(header), header.m_payloadSize), result))
+                                {
+                                    result.m_fails = std::max(result.m_fails, 1);
+                                    result.m_failures.push_back({ {}, 0, "the result from the worker process was corrupt" });
+                                }
+                                record(header.m_index, std::move(result));
+                                ++worker.m_next;
+                            }
+                            worker.m_buffer.erase(0, sizeof(header) + header.m_payloadSize);
+                        }
+                        continue;
+                    }
+
+                    // The worker has gone - either it finished its slice or it died part way through
+                    ::close(worker.m_fd);
+                    worker.m_fd = -1;
+                    int status = 0;
+                    while (::waitpid(worker.m_pid, &status, 0) < 0 && errno == EINTR)
+                        ;
+                    if (worker.m_next < worker.m_slice.size())
+                    {
+                        markCrashed(worker, status);
+                        if (worker.m_next < worker.m_slice.size() && !spawn(worker))
+                            markNotRun(worker, "couldn't start a worker process to run the test");
+                    }
+                }
+            }
+    #endif
+        }
+
+        // A test library loaded by --serve, and the tests and benchmarks it registered, which are taken out of the lists
+        // before it is unloaded (each list sorted, to be searched)
+        struct LoadedLibrary
+        {
+            std::string m_path;
+            // the file's modification time, size and inode when it was loaded, to tell when it has been rebuilt
+            std::tuple<int64_t, int64_t, uint64_t> m_version{};
+            void* m_handle = nullptr;
+            std::vector<const TestNode*> m_tests;
+            std::vector<const BenchmarkNode*> m_benchmarks;
+        };
+        // to give each copy that is loaded a new name
+        static inline unsigned s_libraryLoads = 0;
+        // the arguments of a request, each ended by a NUL, are ended by an empty one, and the reply's output by a NUL
+        static constexpr size_t MAX_REQUEST_SIZE = 1 << 20;
+        // A client has this long to send its whole request, and the daemon waits this long on each write of the output,
+        // so that a client which stalls can't hold up the ones behind it for longer
+        static constexpr std::chrono::seconds CLIENT_TIMEOUT{ 5 };
+
+    #ifndef _WIN32
+        static std::optional<std::tuple<int64_t, int64_t, uint64_t>> libraryVersion(const std::string& path)
+        {
+            struct stat status{};
+            if (::stat(path.c_str(), &status) != 0)
+                return std::nullopt;
+        #ifdef __APPLE__
+            const auto& modified = status.st_mtimespec;
+        #else
+            const auto& modified = status.st_mtim;
+        #endif
+            return std::tuple{ static_cast<int64_t>(modified.tv_sec) * 1000000000 + modified.tv_nsec, static_cast<int64_t>(status.st_size),
+                static_cast<uint64_t>(status.st_ino) };
+        }
+
+        // The registrations after the first count of a list, sorted
+        template <class Node>
+        static std::vector<const Node*> registeredSince(size_t count)
+        {
+            std::vector<const Node*> added;
+            const Node* node = Node::first();
+            for (size_t i = 0; node && i < count; ++i)
+                node = node->next();
+            for (; node; node = node->next())
+                added.push_back(node);
+            std::sort(added.begin(), added.end(), std::less<const Node*>());
+            return added;
+        }
+
+        // Take the library's tests out of the lists, and unload it
+        static void unloadLibrary(LoadedLibrary& library)
+        {
+            if (!library.m_handle)
+                return;
+            TestNode::removeIf([&library](const TestNode* test) { return std::binary_search(library.m_tests.begin(), library.m_tests.end(), test, std::less<const TestNode*>()); });
+            BenchmarkNode::removeIf([&library](const BenchmarkNode* benchmark)
+                {
+                    return std::binary_search(library.m_benchmarks.begin(), library.m_benchmarks.end(), benchmark, std::less<const BenchmarkNode*>());
+                });
+            ::dlclose(library.m_handle);
+            library.m_handle = nullptr;
+            library.m_tests.clear();
+            library.m_benchmarks.clear();
+        }
+
+        // Load the library, unloading what was loaded from it before if it loads.  dlopen is given a copy with a new name
+        // each time, as given a path it has already loaded it hands back what it loaded rather than load it again (and a
+        // library with STB_GNU_UNIQUE symbols, as g++ makes for inline statics, is never unloaded anyway)
+        static bool loadLibrary(LoadedLibrary& library, std::string& error)
+        {
+            namespace fs = std::filesystem;
+            const auto version = libraryVersion(library.m_path);
+            if (!version)
+            {
+                error = std::strerror(errno);
+                return false;
+            }
+            std::error_code ec;
+            const auto copy = fs::temp_directory_path(ec) / ("pinttest-" + std::to_string(::getpid()) + "-" + std::to_string(++s_libraryLoads) + "-"
+                + fs::path(library.m_path).filename().string());
+            if (ec || !fs::copy_file(library.m_path, copy, fs::copy_options::overwrite_existing, ec))
+            {
+                error = "can't copy it: " + ec.message();
+                return false;
+            }
+            const auto testsBefore = TestNode::count();
+            const auto benchmarksBefore = BenchmarkNode::count();
+            void* const handle = ::dlopen(copy.c_str(), RTLD_NOW | RTLD_LOCAL);
+            fs::remove(copy, ec);
+            if (!handle)
+            {
+                const char* const reason = ::dlerror();
+                error = reason ? reason : "dlopen failed";
+                return false;
+            }
+            auto tests = registeredSince<TestNode>(testsBefore);
+            auto benchmarks = registeredSince<BenchmarkNode>(benchmarksBefore);
+            unloadLibrary(library);
+            library.m_version = *version;
+            library.m_handle = handle;
+            library.m_tests = std::move(tests);
+            library.m_benchmarks = std::move(benchmarks);
+            return true;
+        }
+
+        static bool socketAddress(const std::string& path, sockaddr_un& address)
+        {
+            address = {};
+            address.sun_family = AF_UNIX;
+            if (path.empty() || path.size() >= sizeof(address.sun_path))
+                return false;
+            std::memcpy(address.sun_path, path.data(), path.size());
+            return true;
+        }
+
+        // A socket file left at path by a daemon that was killed would stop the bind, so remove it, but nothing else: not
+        // a file that isn't a socket, nor the socket of a daemon that is still running
+        static bool removeStaleSocket(const std::string& path, std::string& error)
+        {
+            struct stat status{};
+            if (::lstat(path.c_str(), &status) != 0)
+            {
+                if (errno == ENOENT)
+                    return true;
+                error = std::strerror(errno);
+                return false;
+            }
+            if (!S_ISSOCK(status.st_mode))
+            {
+                error = "something other than a socket is there";
+                return false;
+            }
+            sockaddr_un address;
+            const int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+            const bool live = fd >= 0 && socketAddress(path, address) && ::connect(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) == 0;
+            if (fd >= 0)
+                ::close(fd);
+            if (live)
+            {
+                error = "a daemon is already serving on it";
+                return false;
+            }
+            if (::unlink(path.c_str()) != 0 && errno != ENOENT)
+            {
+                error = std::strerror(errno);
+                return false;
+            }
+            return true;
+        }
+
+        // Writes to a --serve client, for the output of its run
+        class SocketStreamBuf : public std::streambuf
+        {
+        public:
+            explicit SocketStreamBuf(int fd)
+                : m_fd(fd)
+            {
+                setp(m_buffer.data(), m_buffer.data() + m_buffer.size());
+            }
+
+        protected:
+            int_type overflow(int_type c) override
+            {
+                sync();
+                if (!traits_type::eq_int_type(c, traits_type::eof()))
+                {
+                    *pptr() = traits_type::to_char_type(c);
+                    pbump(1);
+                }
+                return traits_type::not_eof(c);
+            }
+            // A client that has gone away just misses the rest of the output
+            int sync() override
+            {
+                writeAll(m_fd, pbase(), static_cast<size_t>(pptr() - pbase()));
+                setp(m_buffer.data(), m_buffer.data() + m_buffer.size());
+                return 0;
+            }
+
+        private:
+            int m_fd;
+            std::array<char, 4096> m_buffer{};
+        };
+
+        // Returns false if the client closed the connection, or didn't send the whole request within CLIENT_TIMEOUT, or
+        // sent more than MAX_REQUEST_SIZE
+        static bool readRequest(int fd, std::vector<std::string>& args)
+        {
+            const auto deadline = std::chrono::steady_clock::now() + CLIENT_TIMEOUT;
+            std::string request;
+            std::array<char, 4096> buffer;
+            while (request != std::string_view("\0", 1) && !request.ends_with(std::string_view("\0\0", 2)))
+            {
+                const auto remaining = std::chrono::ceil<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+                pollfd ready{ fd, POLLIN, 0 };
+                const int polled = remaining.count() > 0 ? ::poll(&ready, 1, static_cast<int>(remaining.count())) : 0;
+                if (polled < 0 && errno == EINTR)
+                    continue;
+                if (polled <= 0)
+                    return false;
+                const auto got = ::read(fd, buffer.data(), buffer.size());
+                if (got < 0 && errno == EINTR)
+                    continue;
+                if (got <= 0)
+                    return false;
+                request.append(buffer.data(), static_cast<size_t>(got));
+                if (request.size() > MAX_REQUEST_SIZE)
+                    return false;
+            }
+            request.pop_back();
+            for (size_t start = 0; start < request.size(); )
+            {
+                const auto end = request.find('\0', start);
+                args.push_back(request.substr(start, end - start));
+                start = end + 1;
+            }
+            return true;
+        }
+
+        // Reload the libraries that have been rebuilt, and run the tests with the client's arguments, sending it the
+        // output, and then a NUL and "<ran> <failed>\n"
+        static void serveRun(int client, const std::vector<std::string>& request, std::vector<LoadedLibrary>& libraries)
+        {
+            std::pair<int, int> result{ -1, 16 };
+            {
+                SocketStreamBuf output(client);
+                struct Redirect
+                {
+                    std::streambuf* m_cout;
+                    std::streambuf* m_cerr;
+                    ~Redirect()
+                    {
+                        std::cout.flush();
+                        std::cerr.flush();
+                        std::cout.rdbuf(m_cout);
+                        std::cerr.rdbuf(m_cerr);
+                    }
+                } redirect{ std::cout.rdbuf(&output), std::cerr.rdbuf(&output) };
+
+                for (auto& library : libraries)
+                {
+                    if (libraryVersion(library.m_path) == library.m_version)
+                        continue;
+                    std::string error;
+                    if (loadLibrary(library, error))
+                        std::cout << "Reloaded " << library.m_path << "\n";
+                    else
+                        std::cout << RED_TEXT_START << "Can't reload " << library.m_path << " (" << error << "), running the tests it had" << COLOUR_TEXT_END << "\n";
+                }
+                const std::vector<std::string_view> args(request.begin(), request.end());
+                if (std::any_of(args.begin(), args.end(), [](std::string_view arg) { return arg.starts_with("--serve=") || arg.starts_with("--load="); }))
+                    std::cerr << "\"--serve=\" and \"--load=\" can't be given to a run of the daemon, terminating\n";
+                else
+                    result = runAllTests2(args);
+            }
+            const auto trailer = std::string(1, '\0') + std::to_string(result.first) + " " + std::to_string(result.second) + "\n";
+            writeAll(client, trailer.data(), trailer.size());
+        }
+    #endif
+
+        // --serve=: load the --load= libraries once, then listen on the Unix socket for runs, each with its own arguments,
+        // until one has "--shutdown".  Each run reloads the libraries that have been rebuilt, and then costs no more than
+        // the tests it runs
+        static std::pair<int, int> serve(const Options& options)
+        {
+    #ifdef _WIN32
+            (void)options;
+            std::cerr << "\"--serve=\" needs Unix sockets and dlopen, which this platform doesn't have, terminating\n";
+            return { -1, 16 };
+    #else
+            ::signal(SIGPIPE, SIG_IGN);
+            std::vector<LoadedLibrary> libraries(options.m_loads.size());
+            const auto unloadAll = [&libraries]
+                {
+                    for (auto& library : libraries)
+                        unloadLibrary(library);
+                };
+            for (size_t i = 0; i < libraries.size(); ++i)
+            {
+                libraries[i].m_path = options.m_loads[i];
+                if (std::string error; !loadLibrary(libraries[i], error))
+                {
+                    std::cerr << "\"--load=\": can't load " << options.m_loads[i] << " (" << error << "), terminating\n";
+                    unloadAll();
+                    return { -1, 16 };
+                }
+            }
+
+            sockaddr_un address;
+            std::string error;
+            if (!socketAddress(options.m_serve, address))
+                error = "the path is empty or too long for a socket";
+            else
+                removeStaleSocket(options.m_serve, error);
+            const int listener = error.empty() ? ::socket(AF_UNIX, SOCK_STREAM, 0) : -1;
+            if (error.empty() && (listener < 0 || ::bind(listener, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0
+                || ::listen(listener, SOMAXCONN) != 0))
+                error = std::strerror(errno);
+            if (!error.empty())
+            {
+                std::cerr << "\"--serve=\": can't listen on " << options.m_serve << " (" << error << "), terminating\n";
+                if (listener >= 0)
+                    ::close(listener);
+                unloadAll();
+                return { -1, 16 };
+            }
+            ::fcntl(listener, F_SETFD, FD_CLOEXEC);
+            std::cout << "Serving " << TestNode::count() << " tests on " << options.m_serve << std::endl;
+
+            while (true)
+            {
+                const int client = ::accept(listener, nullptr, nullptr);
+                if (client < 0)
+                {
+                    if (errno == EINTR || errno == ECONNABORTED)
+                        continue;
+                    break;
+                }
+                ::fcntl(client, F_SETFD, FD_CLOEXEC);
+                const timeval sendTimeout{ static_cast<time_t>(CLIENT_TIMEOUT.count()), 0 };
+                ::setsockopt(client, SOL_SOCKET, SO_SNDTIMEO, &sendTimeout, sizeof(sendTimeout));
+                std::vector<std::string> request;
+                const bool received = readRequest(client, request);
+                const bool shutdown = received && std::find(request.begin(), request.end(), "--shutdown") != request.end();
+                if (shutdown)
+                    writeAll(client, "\0" "0 0\n", 5);
+                else if (received)
+                    serveRun(client, request, libraries);
+                ::close(client);
+                if (shutdown)
+                    break;
+            }
+            ::close(listener);
+            ::unlink(options.m_serve.c_str());
+            unloadAll();
+            return { 0, 0 };
+    #endif
+        }
+
+        // --connect=: have the daemon serving on the socket run the tests with the rest of the arguments, and write its
+        // output to std::cout as it comes.  Returns what the run returned in the daemon
+        static std::pair<int, int> runRemotely(const std::string& path, const std::vector<std::string_view>& args)
+        {
+    #ifdef _WIN32
+            (void)path;
+            (void)args;
+            std::cerr << "\"--connect=\" needs Unix sockets, which this platform doesn't have, terminating\n";
+            return { -1, 16 };
+    #else
+            ::signal(SIGPIPE, SIG_IGN);
+            std::string request;
+            for (const auto arg : args)
+            {
+                if (arg.empty() || arg.starts_with("--connect="))
+                    continue;
+                request.append(arg);
+                request.push_back('\0');
+            }
+            request.push_back('\0');
+
+            sockaddr_un address;
+            const int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+            if (fd < 0 || !socketAddress(path, address) || ::connect(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0
+                || !writeAll(fd, request.data(), request.size()))
+            {
+                std::cerr << "\"--connect=\": can't reach a daemon on " << path << " (" << std::strerror(errno) << "), terminating\n";
+                if (fd >= 0)
+                    ::close(fd);
+                return { -1, 16 };
+            }
+
+            std::string trailer;
+            bool inTrailer = false;
+            std::array<char, 4096> buffer;
+            while (true)
+            {
+                const auto got = ::read(fd, buffer.data(), buffer.size());
+                if (got < 0 && errno == EINTR)
+                    continue;
+                if (got <= 0)
+                    break;
+                std::string_view chunk(buffer.data(), static_cast<size_t>(got));
+                if (!inTrailer)
+                {
+                    const auto end = chunk.find('\0');
+                    std::cout.write(chunk.data(), static_cast<std::streamsize>(std::min(end, chunk.size()))).flush();
+                    if (end == std::string_view::npos)
+                        continue;
+                    inTrailer = true;
+                    chunk.remove_prefix(end + 1);
+                }
+                trailer.append(chunk);
+            }
+            ::close(fd);
+
+            int ran = 0;
+            int failed = 0;
+            const auto space = trailer.find(' ');
+            if (!inTrailer || space == std::string::npos || !parseNumber(std::string_view(trailer).substr(0, space), ran)
+                || !parseNumber(std::string_view(trailer).substr(space + 1, trailer.size() - space - 2), failed))
+            {
+                std::cerr << "\"--connect=\": the daemon on " << path << " stopped before the run finished\n";
+                return { -1, 16 };
+            }
+            return { ran, failed };
+    #endif
+        }
+
+        static inline std::vector<std::shared_ptr<Reporter>> s_addedReporters;
+
+        // Each benchmark sample should take about this long, so that the clock's resolution and overhead don't matter
+        static constexpr std::chrono::milliseconds BENCHMARK_SAMPLE_TIME{ 10 };
+        static constexpr int BENCHMARK_SAMPLES = 20;
+        // The warm up stops growing the iterations here, however quick they are
+        static constexpr uint64_t BENCHMARK_MAX_ITERATIONS = uint64_t(1) << 40;
+
+        // Run the benchmarks that pass the filter, one at a time on the calling thread.  A benchmark with failed checks, or
+        // that has regressed from the baseline, is counted as a failed test
+        static std::vector<BenchmarkResult> runBenchmarks(const Options& options, Reporter& reporter, const Baseline* baseline)
+        {
+            std::vector<BenchmarkResult> results;
+            for (auto* benchmark = BenchmarkNode::first(); benchmark; benchmark = benchmark->next())
+            {
+                if (!options.m_filter.matches(benchmark->name()))
+                    continue;
+
+                reporter.benchmarkStarting(benchmark->name());
+                BenchmarkResult result;
+                result.m_name = benchmark->name();
+                TestState state{ 0, &result.m_failures };
+                const auto outerTest = enterTest(state);
+                runStoppable([&] { runBenchmark(*benchmark, result); });
+                if (baseline && state.m_fails == 0)
+                {
+                    if (const auto before = baseline->m_benchmarks.find(result.m_name); before != baseline->m_benchmarks.end())
+                        checkRegression(result.m_name, before->second, result.m_samples, options);
+                }
+                leaveTest(state, outerTest);
+                if (state.m_fails > 0)
+                {
+                    ++s_tests_failed;
+                    if (result.m_failures.empty())
+                        result.m_failures.push_back({ {}, 0, "a check failed on another thread" });
+                }
+                reporter.benchmarkFinished(result);
+                results.push_back(std::move(result));
+            }
+            return results;
+        }
+
+        // Warm up, scaling the number of iterations until a sample takes BENCHMARK_SAMPLE_TIME, then take the samples
+        static void runBenchmark(const BenchmarkNode& benchmark, BenchmarkResult& result)
+        {
+            // a body that returns without running the loop to the end hasn't timed anything, and fails
+            const auto runIterations = [&benchmark](uint64_t iterations) -> std::optional<std::chrono::nanoseconds>
+            {
+                BenchmarkState state(iterations);
+                benchmark.run(state);
+                if (!state.finished())
+                {
+                    recordFailure();
+                    recordFailureMessage({ {}, 0, "\nthe benchmark returned before its while (state.keepRunning()) loop had finished, so nothing was timed\n" });
+                    return std::nullopt;
+                }
+                return state.elapsed();
+            };
+
+            uint64_t iterations = 1;
+            while (true)
+            {
+                const auto elapsed = runIterations(iterations);
+                if (!elapsed || s_currentTest->m_fails > 0)
+                    return;
+                if (*elapsed >= BENCHMARK_SAMPLE_TIME)
+                    break;
+                if (iterations == BENCHMARK_MAX_ITERATIONS)
+                {
+                    if (elapsed->count() > 0)
+                        break;
+                    recordFailure();
+                    recordFailureMessage({ {}, 0, "\nthe benchmark's loop took no measurable time, even at " + std::to_string(iterations) + " iterations\n" });
+                    return;
+                }
+                // aim a little over the target, but don't grow by more than 10x at once as the early timings are noisy
+                const double scale = elapsed->count() > 0 ? 1.4 * std::chrono::nanoseconds(BENCHMARK_SAMPLE_TIME).count() / static_cast<double>(elapsed->count()) : 10.0;
+                iterations = static_cast<uint64_t>(std::min(static_cast<double>(iterations) * std::clamp(scale, 2.0, 10.0), static_cast<double>(BENCHMARK_MAX_ITERATIONS)));
+            }
+
+            result.m_iterationsPerSample = iterations;
+            for (int sample = 0; sample < BENCHMARK_SAMPLES; ++sample)
+            {
+                const auto elapsed = runIterations(iterations);
+                if (!elapsed)
+                    return;
+                result.m_samples.push_back(static_cast<double>(elapsed->count()) / static_cast<double>(iterations));
+            }
+
+            auto sorted = result.m_samples;
+            std::sort(sorted.begin(), sorted.end());
+            const auto count = sorted.size();
+            result.m_min = sorted.front();
+            result.m_median = count % 2 ? sorted[count / 2] : (sorted[count / 2 - 1] + sorted[count / 2]) / 2;
+            double sum = 0;
+            for (const auto sample : sorted)
+                sum += sample;
+            result.m_mean = sum / static_cast<double>(count);
+            double sumSquares = 0;
+            for (const auto sample : sorted)
+                sumSquares += (sample - result.m_mean) * (sample - result.m_mean);
+            result.m_stddev = count > 1 ? std::sqrt(sumSquares / static_cast<double>(count - 1)) : 0;
+        }
+
+        // The indices in [0, count) that worker w of jobs gets when they are dealt out like cards, so that if they are
+        // sorted by decreasing cost each worker gets a similar share of the expensive ones, and starts with its most
+        // expensive
+        static std::vector<size_t> dealRoundRobin(size_t count, unsigned jobs, unsigned w)
+        {
+            std::vector<size_t> dealt;
+            for (size_t index = w; index < count; index += jobs)
+                dealt.push_back(index);
+            return dealt;
+        }
+
+        // Calls fn(i) for every i in [0, count) on a pool of jobs threads (the calling thread being one of them).
+        // Each worker starts with a slice of the indices, dealt round robin, and takes work from the front of it.  When
+        // its own slice is exhausted it steals from the back of another worker's slice.  A slice is packed as begin << 32 | end
+        // into a single atomic so that the owner and the thieves can both update it with a CAS.
+        static void parallelFor(size_t count, unsigned jobs, const std::function<void(size_t)>& fn)
+        {
+            struct alignas(64) Slice
+            {
+                std::atomic<uint64_t> m_range = 0;
+            };
+            const auto pack = [](uint64_t begin, uint64_t end) { return begin << 32 | end; };
+
+            jobs = static_cast<unsigned>(std::min<size_t>(jobs, count));
+            if (jobs <= 1)
+            {
+                for (size_t i = 0; i < count; ++i)
+                    fn(i);
+                return;
+            }
+
+            // Slices are ranges of positions in order, which holds each worker's indices one after the other
+            std::vector<size_t> order;
+            order.reserve(count);
+            std::vector<Slice> slices(jobs);
+            for (unsigned w = 0; w < jobs; ++w)
+            {
+                const auto begin = order.size();
+                for (const auto index : dealRoundRobin(count, jobs, w))
+                    order.push_back(index);
+                slices[w].m_range = pack(begin, order.size());
+            }
+
+            const auto takeFront = [&](Slice& slice, size_t& index)
+            {
+                auto range = slice.m_range.load();
+                while (true)
+                {
+                    const auto begin = range >> 32;
+                    const auto end = range & 0xFFFFFFFF;
+                    if (begin >= end)
+                        return false;
+                    if (slice.m_range.compare_exchange_weak(range, pack(begin + 1, end)))
+                    {
+                        index = begin;
+                        return true;
+                    }
+                }
+            };
+            const auto takeBack = [&](Slice& slice, size_t& index)
+            {
+                auto range = slice.m_range.load();
+                while (true)
+                {
+                    const auto begin = range >> 32;
+                    const auto end = range & 0xFFFFFFFF;
+                    if (begin >= end)
+                        return false;
+                    if (slice.m_range.compare_exchange_weak(range, pack(begin, end - 1)))
+                    {
+                        index = end - 1;
+                        return true;
+                    }
+                }
+            };
+            const auto worker = [&](unsigned self)
+            {
+                size_t index = 0;
+                while (true)
+                {
+                    if (takeFront(slices[self], index))
+                    {
+                        fn(order[index]);
+                        continue;
+                    }
+                    // Nothing is ever added to a slice, so once every slice is empty we are done
+                    bool stole = false;
+                    for (unsigned v = 1; v < jobs && !stole; ++v)
+                        stole = takeBack(slices[(self + v) % jobs], index);
+                    if (!stole)
+                        return;
+                    fn(order[index]);
+                }
+            };
+
+            std::vector<std::thread> threads;
+            for (unsigned w = 1; w < jobs; ++w)
+                threads.emplace_back(worker, w);
+            worker(0);
+            for (auto& thread : threads)
+                thread.join();
+        }
+
+    public:
+
+        // Where EXPECT_SNAPSHOT(name, ...) keeps its snapshot
+        [[nodiscard]] static std::filesystem::path snapshotPath(std::string_view name)
+        {
+            return std::filesystem::path(s_snapshotDirectory) / name;
+        }
+
+        // Replace the file with the bytes, by writing them to a temporary file and renaming it over the file, so that it is
+        // never left half written.  The directory is created if need be.  Returns an empty string, or why it failed
+        static std::string writeFile(const std::filesystem::path& path, std::span<const unsigned char> bytes)
+        {
+            std::error_code ec;
+            if (path.has_parent_path())
+                std::filesystem::create_directories(path.parent_path(), ec);
+            auto tempPath = path;
+            tempPath += ".tmp";
+            {
+                std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+                file.write(reinterpret_cast<const char*>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+                if (!file.flush())
+                    return "can't write " + tempPath.string();
+            }
+            std::filesystem::rename(tempPath, path, ec);
+            return ec ? "can't rename " + tempPath.string() + ", " + ec.message() : std::string();
+        }
+    };
+}
+
+inline constinit thread_local PintTestNS::Runner::ThreadBuffer PintTestNS::Runner::s_threadBuffer{};
+
+PINTTEST_RUNNER_INLINE void PintTest::addReporter(std::shared_ptr<Reporter> reporter)
+{
+    PintTestNS::Runner::s_addedReporters.push_back(std::move(reporter));
+}
+
+PINTTEST_RUNNER_INLINE const PintTest::Suite* PintTest::registerSuite(std::function<void()> setUpSuite, std::function<void()> tearDownSuite)
+{
+    static std::deque<Suite> suites;
+    return &suites.emplace_back(Suite{ std::move(setUpSuite), std::move(tearDownSuite) });
+}
+
+PINTTEST_RUNNER_INLINE bool PintTest::registerTestFn(const char* name, std::function<void()> test, const Suite* suite)
+{
+    PintTestNS::Runner::registeredFunctions<>().emplace_back(name, std::move(test), suite);
+    return true;
+}
+
+PINTTEST_RUNNER_INLINE bool PintTest::registerBenchmarkFn(const char* name, std::function<void(BenchmarkState&)> benchmark)
+{
+    PintTestNS::Runner::registeredFunctions<BenchmarkState&>().emplace_back(name, std::move(benchmark));
+    return true;
+}
+
+PINTTEST_RUNNER_INLINE void PintTest::recordFailure()
+{
+    if (!s_currentTest || !s_currentTest->m_trial)
+        ++s_fails;
+    if (s_currentTest)
+        ++s_currentTest->m_fails;
+    else if (auto* const buffer = PintTestNS::Runner::threadFailures())
+        ++buffer->m_fails;
+    else
+        ++s_unattributedFails;
+}
+
+PINTTEST_RUNNER_INLINE bool PintTest::recordFailure(const std::source_location& location)
+{
+    recordFailure();
+    SiteFailures* sites = nullptr;
+    if (s_currentTest)
+        sites = &s_currentTest->m_sites;
+    else if (auto* const buffer = PintTestNS::Runner::threadFailures())
+        sites = &buffer->m_sites;
+    if (!sites)
+        return true;
+    const auto count = sites->add({ location.file_name(), location.line() });
+    const auto perSite = s_failuresPerSite.load(std::memory_order_relaxed);
+    const bool report = perSite == 0 || count <= perSite;
+    if (s_currentTest && s_maxFailures && static_cast<unsigned>(s_currentTest->m_fails) >= s_maxFailures)
+    {
+        // a check that is reported is stopped by recordFailureMessage, once its message has been recorded
+        if (report)
+        {
+            s_currentTest->m_stopAfter = location;
+            return true;
+        }
+        stopTest(location.file_name(), location.line());
+    }
+    return report;
+}
+
+PINTTEST_RUNNER_INLINE void PintTest::stopTest(std::string file, uint_least32_t line)
+{
+    recordFailureMessage({ std::move(file), line, "\nthe test was stopped after " + std::to_string(s_maxFailures) + " failed checks" });
+    throw TestAborted();
+}
+
+PINTTEST_RUNNER_INLINE void PintTest::recordFailureMessage(Failure failure)
+{
+    // the check that reached --max-failures is recorded like any other, and then the test is stopped
+    if (s_currentTest && s_currentTest->m_stopAfter && failure.m_line == s_currentTest->m_stopAfter->line() &&
+        failure.m_file == s_currentTest->m_stopAfter->file_name())
+    {
+        s_currentTest->m_stopAfter.reset();
+        auto file = failure.m_file;
+        const auto line = failure.m_line;
+        recordFailureMessage(std::move(failure));
+        stopTest(std::move(file), line);
+    }
+    if (s_currentTest && s_currentTest->m_failures)
+    {
+        s_currentTest->m_failures->push_back(std::move(failure));
+        return;
+    }
+    if (!s_currentTest)
+    {
+        if (auto* const buffer = PintTestNS::Runner::threadFailures())
+        {
+            buffer->m_failures.push_back(std::move(failure));
+            return;
+        }
+    }
+    std::lock_guard lock(PintTestNS::Runner::s_outputMutex);
+    std::cout << RED_TEXT_START << "Test failed: " << failure.m_file << "(" << failure.m_line << "): " << failure.m_message << COLOUR_TEXT_END << "\n";
+}
+
+PINTTEST_RUNNER_INLINE std::pair<int, int> PintTest::runAllTests2(const std::vector<std::string_view>& args)
+{
+    return PintTestNS::Runner::runAllTests2(args);
+}
+
+PINTTEST_RUNNER_INLINE PintTest::TestResult PintTest::executeTest(const TestNode& test)
+{
+    return PintTestNS::Runner::executeTest(test);
+}
+
+PINTTEST_RUNNER_INLINE PintTest::TestResult PintTest::executeTest(const std::function<void()>& testFn, const std::string& testCase)
+{
+    return PintTestNS::Runner::executeTest(testFn, testCase);
+}
+
+PINTTEST_RUNNER_INLINE PintTest::StressResult PintTest::runStressThreads(unsigned threads, std::chrono::nanoseconds duration,
+    const std::function<void(unsigned, StressThread&, const std::chrono::steady_clock::time_point&)>& body)
+{
+    if (threads == 0)
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    const auto cpus = PintTestNS::Runner::allowedCpus();
+    const TestHandle test = currentTest();
+    StressResult result;
+    result.m_threads.resize(threads);
+
+    // the threads spin until they have all been started and pinned, and are then released together.  They yield as
+    // they spin, as there may be more of them than CPUs
+    std::atomic<unsigned> ready = 0;
+    std::atomic<bool> go = false;
+    std::chrono::steady_clock::time_point deadline;
+    std::vector<std::thread> workers;
+    workers.reserve(threads);
+    for (unsigned t = 0; t < threads; ++t)
+    {
+        workers.emplace_back([&, t]
+            {
+                AttachToTest attach(test);
+                StressThread& thread = result.m_threads[t];
+                if (!cpus.empty() && PintTestNS::Runner::pinThisThread(cpus[t % cpus.size()]))
+                    thread.m_cpu = cpus[t % cpus.size()];
+                ++ready;
+                while (!go.load(std::memory_order_acquire))
+                    std::this_thread::yield();
+                body(t, thread, deadline);
+            });
+    }
+    while (ready.load() < threads)
+        std::this_thread::yield();
+    const auto start = std::chrono::steady_clock::now();
+    deadline = duration == std::chrono::nanoseconds::max() ? std::chrono::steady_clock::time_point::max() : start + duration;
+    go.store(true, std::memory_order_release);
+    for (auto& worker : workers)
+        worker.join();
+    result.m_elapsed = std::chrono::steady_clock::now() - start;
+
+    if (s_currentTest && s_currentTest->m_result)
+        s_currentTest->m_result->m_stress.push_back(result);
+    return result;
+}
+
+PINTTEST_RUNNER_INLINE int PintTest::currentFails()
+{
+    return s_currentTest ? s_currentTest->m_fails : 0;
+}
+
+// A trial is the current test of its thread while it runs, but isn't the test of any other threads, so that trials can
+// run side by side on the threads of runPropertyCases.  Its failures are collected, so that none are written out, and
+// then thrown away
+PINTTEST_RUNNER_INLINE int PintTest::runTrial(const std::function<void()>& fn)
+{
+    std::vector<Failure> failures;
+    TestState state{ 0, &failures, nullptr };
+    state.m_trial = true;
+    TestState* const outer = std::exchange(s_currentTest, &state);
+    PintTestNS::Runner::runStoppable(fn);
+    s_currentTest = outer;
+    return state.m_fails;
+}
+
+// Chunks after one that has already failed aren't started, but those before it still are, so that the case found is
+// the first to fail, whatever the threads happen to do
+PINTTEST_RUNNER_INLINE uint64_t PintTest::runPropertyCases(uint64_t cases, const std::function<void(uint64_t, uint64_t, uint64_t&)>& run)
+{
+    std::atomic<uint64_t> failing = cases;
+    const auto chunks = static_cast<size_t>((cases + PROPERTY_CHUNK - 1) / PROPERTY_CHUNK);
+    PintTestNS::Runner::parallelFor(chunks, s_propertyJobs, [&failing, &run, cases](size_t chunk)
+        {
+            const uint64_t first = chunk * PROPERTY_CHUNK;
+            if (first >= failing.load())
+                return;
+            uint64_t current = first;
+            if (runTrial([&] { run(first, std::min(cases, first + PROPERTY_CHUNK), current); }) == 0)
+                return;
+            auto earliest = failing.load();
+            while (current < earliest && !failing.compare_exchange_weak(earliest, current))
+                ;
+        });
+    return failing;
+}
+
+PINTTEST_RUNNER_INLINE void PintTest::runTask(Task (*body)())
+{
+    PintTestNS::Runner::EventLoop loop;
+    PintTestNS::Runner::AsyncTest test{ body(), s_currentTest, 0 };
+    loop.post({ test.m_task.m_handle, &test });
+    loop.run([](PintTestNS::Runner::AsyncTest&) {});
+}
+
+PINTTEST_RUNNER_INLINE bool PintTest::awaitTimer(std::coroutine_handle<> handle, std::chrono::steady_clock::time_point deadline)
+{
+    auto* const loop = PintTestNS::Runner::s_eventLoop;
+    if (!loop)
+    {
+        std::this_thread::sleep_until(deadline);
+        return false;
+    }
+    loop->addTimer(deadline, { handle, PintTestNS::Runner::s_currentAsync });
+    return true;
+}
+
+PINTTEST_RUNNER_INLINE bool PintTest::awaitFd(std::coroutine_handle<> handle, int fd, bool write)
+{
+    std::string error = "there's no event loop to wait on";
+    auto* const loop = PintTestNS::Runner::s_eventLoop;
+    if (loop && loop->addFd(fd, write, { handle, PintTestNS::Runner::s_currentAsync }, error))
+        return true;
+    recordFailure();
+    recordFailureMessage({ {}, 0, "\ncan't wait for fd " + std::to_string(fd) + " to be " + (write ? "writable: " : "readable: ") + error + "\n" });
+    return false;
+}
+
+// Read afresh each time, as a /proc/self opened before a fork would be the parent's.  Into a buffer on the stack, as
+// it's sampled around every test with --resource-usage
+PINTTEST_RUNNER_INLINE std::optional<PintTest::MemoryUsage> PintTest::memoryUsage()
+{
+#ifdef __linux__
+    const int fd = ::open("/proc/self/status", O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return std::nullopt;
+    std::array<char, 4096> buffer;
+    const auto size = ::read(fd, buffer.data(), buffer.size());
+    ::close(fd);
+    if (size <= 0)
+        return std::nullopt;
+    const std::string_view status(buffer.data(), static_cast<size_t>(size));
+    // e.g. "VmHWM:\t    2872 kB"
+    const auto kilobytes = [&status](std::string_view name) -> std::optional<uint64_t>
+        {
+            const auto at = status.find(name);
+            if (at == std::string_view::npos)
+                return std::nullopt;
+            const auto* first = status.data() + at + name.size();
+            const auto* const last = status.data() + status.size();
+            while (first != last && (*first == ' ' || *first == '\t'))
+                ++first;
+            uint64_t value = 0;
+            if (std::from_chars(first, last, value).ec != std::errc())
+                return std::nullopt;
+            return value * 1024;
+        };
+    const auto rss = kilobytes("\nVmRSS:");
+    const auto peak = kilobytes("\nVmHWM:");
+    if (!rss || !peak)
+        return std::nullopt;
+    return MemoryUsage{ *rss, *peak };
+#else
+    return std::nullopt;
+#endif
+}
+
+PINTTEST_RUNNER_INLINE bool PintTest::resetPeakMemory()
+{
+#ifdef __linux__
+    if (s_concurrentTests)
+        return false;
+    if (const auto usage = memoryUsage(); usage && usage->m_peakRss > s_clearedPeakRss)
+        s_clearedPeakRss = usage->m_peakRss;
+    // "5" resets the peak, since Linux 4.0
+    const int fd = ::open("/proc/self/clear_refs", O_WRONLY | O_CLOEXEC);
+    if (fd < 0)
+        return false;
+    const bool reset = ::write(fd, "5", 1) == 1;
+    ::close(fd);
+    return reset;
+#else
+    return false;
+#endif
+}
+
+PINTTEST_RUNNER_INLINE PintTest::MappedFile::MappedFile(const std::string& path)
+{
+#ifdef _WIN32
+    const HANDLE file = CreateFileW(std::filesystem::path(path).c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file != INVALID_HANDLE_VALUE)
+        m_file = file;
+    LARGE_INTEGER size{};
+    if (!m_file || !GetFileSizeEx(m_file, &size))
+    {
+        m_error = "can't open, error " + std::to_string(GetLastError());
+        return;
+    }
+    m_size = static_cast<size_t>(size.QuadPart);
+    if (m_size != 0)
+    {
+        m_mapping = CreateFileMappingW(m_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        const void* const view = m_mapping ? MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+        if (!view)
+        {
+            m_error = "can't map, error " + std::to_string(GetLastError());
+            return;
+        }
+        m_data = static_cast<const unsigned char*>(view);
+    }
+#else
+    const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    struct stat status{};
+    if (fd < 0 || ::fstat(fd, &status) != 0)
+    {
+        m_error = std::string("can't open, ") + std::strerror(errno);
+        if (fd >= 0)
+            ::close(fd);
+        return;
+    }
+    m_size = static_cast<size_t>(status.st_size);
+    if (m_size != 0)
+    {
+        void* const mapping = ::mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapping == MAP_FAILED)
+        {
+            m_error = std::string("can't map, ") + std::strerror(errno);
+            ::close(fd);
+            return;
+        }
+        ::madvise(mapping, m_size, MADV_SEQUENTIAL);
+        m_data = static_cast<const unsigned char*>(mapping);
+    }
+    ::close(fd);
+#endif
+    m_valid = true;
+}
+
+PINTTEST_RUNNER_INLINE PintTest::MappedFile::~MappedFile()
+{
+#ifdef _WIN32
+    if (m_data)
+        UnmapViewOfFile(m_data);
+    if (m_mapping)
+        CloseHandle(m_mapping);
+    if (m_file)
+        CloseHandle(m_file);
+#else
+    if (m_data)
+        ::munmap(const_cast<unsigned char*>(m_data), m_size);
+#endif
+}
+
+namespace PintTestNS
+{
+    PINTTEST_RUNNER_INLINE std::string streamToString(void (*write)(std::ostream&, const void*), const void* value)
+    {
+        std::ostringstream ss;
+        write(ss, value);
+        return ss.str();
+    }
+
+    PINTTEST_RUNNER_INLINE Msg createFailureStringNear(double l, double r, const char* pL, const char* pR, const char* pTolerance, const std::source_location& location)
+    {
+        if (!PintTest::recordFailure(location))
+            return Msg::unreportedFailure();
+        return std::string("\n") + pL + " == " + pR + " (+/-" + pTolerance + ")\nExpected: " + GetString(l) + "\n" + "Actual: " + GetString(r) + "\n";
+    }
+
+
+    PINTTEST_RUNNER_INLINE Msg createFailureStringLatency(const PintTest::LatencyRecorder& recorder, double percentile, std::chrono::nanoseconds actual,
+        std::chrono::nanoseconds limit, const char* pRecorder, const char* pLimit, const std::source_location& location)
+    {
+        if (!PintTest::recordFailure(location))
+            return Msg::unreportedFailure();
+        const std::string statistic = percentile >= 100.0 ? std::string("max") : "p" + GetString(percentile);
+        return std::string("\n") + pRecorder + " " + statistic + " < " + pLimit + "\nExpected: < " + std::to_string(limit.count()) + "ns\n"
+            + "Actual: " + std::to_string(actual.count()) + "ns (" + statistic + " of " + std::to_string(recorder.count()) + " samples)\n";
+    }
+
+
+    constexpr size_t BYTES_BLOCK_SIZE = 4096;
+    constexpr size_t HEX_ROW_SIZE = 16;
+    constexpr size_t HEX_ROWS_BEFORE = 2;
+    constexpr size_t HEX_ROWS_AFTER = 2;
+
+    // The offset of the first byte that differs, or the size of the shorter if there isn't one.  Whole blocks are
+    // compared with memcmp, which the C library vectorises, and only the block that differs is searched byte by byte
+    PINTTEST_RUNNER_INLINE size_t bytesFirstMismatch(std::span<const unsigned char> a, std::span<const unsigned char> b)
+    {
+        const auto size = std::min(a.size(), b.size());
+        size_t start = 0;
+        for (; start + BYTES_BLOCK_SIZE <= size; start += BYTES_BLOCK_SIZE)
+            if (std::memcmp(a.data() + start, b.data() + start, BYTES_BLOCK_SIZE) != 0)
+                break;
+        return static_cast<size_t>(std::mismatch(a.begin() + static_cast<std::ptrdiff_t>(start), a.begin() + static_cast<std::ptrdiff_t>(size),
+            b.begin() + static_cast<std::ptrdiff_t>(start)).first - a.begin());
+    }
+
+    // The rows of a hex dump around offset, with the row it's in marked with a *, e.g.
+    // * 00001000  41 42 43 ff                                      |ABC.|
+    PINTTEST_RUNNER_INLINE std::string hexWindow(std::span<const unsigned char> bytes, size_t offset)
+    {
+        static constexpr char HEX[] = "0123456789abcdef";
+        const auto row = offset / HEX_ROW_SIZE;
+        const auto firstRow = row > HEX_ROWS_BEFORE ? row - HEX_ROWS_BEFORE : 0;
+        std::string text;
+        for (auto r = firstRow; r <= row + HEX_ROWS_AFTER && r * HEX_ROW_SIZE < bytes.size(); ++r)
+        {
+            const auto start = r * HEX_ROW_SIZE;
+            const auto end = std::min(start + HEX_ROW_SIZE, bytes.size());
+            text += r == row ? "* " : "  ";
+            for (int shift = 28; shift >= 0; shift -= 4)
+                text += HEX[(start >> shift) & 0xf];
+            text += ' ';
+            std::string printable;
+            for (auto i = start; i < start + HEX_ROW_SIZE; ++i)
+            {
+                text += ' ';
+                if (i < end)
+                {
+                    text += HEX[bytes[i] >> 4];
+                    text += HEX[bytes[i] & 0xf];
+                    printable += bytes[i] >= 0x20 && bytes[i] < 0x7f ? static_cast<char>(bytes[i]) : '.';
+                }
+                else
+                {
+                    text += "  ";
+                }
+            }
+            text += "  |" + printable + "|\n";
+        }
+        return text;
+    }
+
+    // The failure message: the sizes, where the first difference is, and the bytes of each around it
+    PINTTEST_NOINLINE PINTTEST_RUNNER_INLINE Msg createBytesFailure(std::span<const unsigned char> expected, std::span<const unsigned char> actual,
+        const std::string& check, const std::source_location& location)
+    {
+        if (!PintTest::recordFailure(location))
+            return Msg::unreportedFailure();
+        const auto offset = bytesFirstMismatch(expected, actual);
+        std::string message = "\n" + check + "\nSizes: " + std::to_string(expected.size()) + " and " + std::to_string(actual.size()) + "\n";
+        std::ostringstream hexOffset;
+        hexOffset << std::hex << offset;
+        message += "First difference at offset " + std::to_string(offset) + " (0x" + hexOffset.str() + "):\nExpected:\n" + hexWindow(expected, offset) + "Actual:\n" + hexWindow(actual, offset);
+        return message;
+    }
+
+    // Compare the bytes with the expected file, or with --update-snapshots write them to it if they differ
+    PINTTEST_RUNNER_INLINE Msg compBytesWithFile(const std::filesystem::path& expectedPath, std::span<const unsigned char> actual, const std::string& check,
+        const std::source_location& location)
+    {
+        std::optional<PintTest::MappedFile> expected;
+        if (std::filesystem::exists(expectedPath))
+        {
+            expected.emplace(expectedPath.string());
+            if (expected->valid() && expected->bytes().size() == actual.size() && bytesFirstMismatch(expected->bytes(), actual) == actual.size()) [[likely]]
+                return {};
+        }
+        if (PintTest::updatingSnapshots())
+        {
+            expected.reset();
+            if (const auto error = Runner::writeFile(expectedPath, actual); !error.empty())
+            {
+                if (!PintTest::recordFailure(location))
+                    return Msg::unreportedFailure();
+                return "\n" + check + "\n" + error + "\n";
+            }
+            return {};
+        }
+        if (!expected)
+        {
+            if (!PintTest::recordFailure(location))
+                return Msg::unreportedFailure();
+            return "\n" + check + "\n" + expectedPath.string() + " doesn't exist (run with --update-snapshots to write it)\n";
+        }
+        if (!expected->valid())
+        {
+            if (!PintTest::recordFailure(location))
+                return Msg::unreportedFailure();
+            return "\n" + check + "\n" + expectedPath.string() + ": " + expected->error() + "\n";
+        }
+        return createBytesFailure(expected->bytes(), actual, check, location);
+    }
+
+    PINTTEST_RUNNER_INLINE Msg compFileEqPaths(const std::string& expected, const std::string& actual, const char* pExpected, const char* pActual,
+        const std::source_location& location)
+    {
+        const auto check = [&] { return std::string(pExpected) + " == " + pActual + " (files)"; };
+        const PintTest::MappedFile actualFile(actual);
+        if (!actualFile.valid())
+        {
+            if (!PintTest::recordFailure(location))
+                return Msg::unreportedFailure();
+            return "\n" + check() + "\n" + actual + ": " + actualFile.error() + "\n";
+        }
+        return compBytesWithFile(expected, actualFile.bytes(), check(), location);
+    }
+
+    PINTTEST_RUNNER_INLINE Msg compSnapshotBytes(std::string_view name, std::span<const unsigned char> bytes, const char* pName, const char* pBytes,
+        const std::source_location& location)
+    {
+        return compBytesWithFile(Runner::snapshotPath(name), bytes, std::string(pBytes) + " matches snapshot " + pName, location);
+    }
+
+    PINTTEST_RUNNER_INLINE void reportFailure(const std::source_location& location, Msg& failure)
+    {
+        if (failure.unreported())
+            return;
+        auto message = failure.takeString();
+        if (!message.empty() && message.back() == '\n')
+            message.pop_back();
+#ifdef _WIN32
+        if (IsDebuggerPresent())
+        {
+            std::ostringstream os_;
+            os_ << location.file_name() << "(" << location.line() << "): " << message << "\n";
+            OutputDebugString(os_.str().data());
+        }
+#endif
+        PintTest::recordFailureMessage({ location.file_name(), location.line(), std::move(message) });
+    }
+
+    // Writes the results to the console (or any stream) in colour, as they arrive.  The output is collected in a buffer
+    // and only written when the buffer fills, a test fails, or the run finishes, to keep the number of writes down.  In
+    // quiet mode only failures and the summary are written
+    class ConsoleReporter : public PintTest::Reporter
+    {
+    public:
+        ConsoleReporter(std::ostream& out, bool quiet, size_t bufferSize)
+            : m_out(out), m_quiet(quiet), m_bufferSize(bufferSize)
+        {
+        }
+        ~ConsoleReporter() override
+        {
+            flush();
+        }
+        void testStarting(const std::string& name) override
+        {
+            if (!m_quiet)
+                m_buffer << PintTest::GREEN_TEXT_START << "Testing " << name << PintTest::COLOUR_TEXT_END << "\n";
+        }
+        void testFinished(const PintTest::TestResult& result) override
+        {
+            const auto durationMs = std::chrono::duration_cast<std::chrono::milliseconds>(result.m_duration).count();
+            if (result.passed())
+            {
+                if (!m_quiet)
+                {
+                    m_buffer << PintTest::GREEN_TEXT_START << "PASSED  " << result.m_name << " (" << durationMs << "ms";
+                    writeCounters(result.m_counters);
+                    writeAllocations(result.m_allocations);
+                    writeResources(result.m_resources);
+                    m_buffer << ")" << PintTest::COLOUR_TEXT_END << "\n";
+                    writeStress(result.m_stress);
+                    writeLatencies(result.m_latencies);
+                }
+                flushIfFull();
+                return;
+            }
+            for (const auto& failure : result.m_failures)
+                writeFailure(result.m_name, failure, result.m_crashed);
+            m_buffer << PintTest::RED_TEXT_START << "FAILED  " << result.m_name << " (" << durationMs << "ms";
+            writeCounters(result.m_counters);
+            writeAllocations(result.m_allocations);
+            writeResources(result.m_resources);
+            m_buffer << ")" << PintTest::COLOUR_TEXT_END << "\n";
+            writeStress(result.m_stress);
+            writeLatencies(result.m_latencies);
+            flush();
+        }
+        void benchmarkStarting(const std::string& name) override
+        {
+            if (!m_quiet)
+                m_buffer << PintTest::GREEN_TEXT_START << "Benchmarking " << name << PintTest::COLOUR_TEXT_END << "\n";
+        }
+        void benchmarkFinished(const PintTest::BenchmarkResult& result) override
+        {
+            if (!result.passed())
+            {
+                for (const auto& failure : result.m_failures)
+                    writeFailure(result.m_name, failure, false);
+                m_buffer << PintTest::RED_TEXT_START << "FAILED  " << result.m_name << PintTest::COLOUR_TEXT_END << "\n";
+            }
+            else if (!m_quiet)
+            {
+                m_buffer << PintTest::GREEN_TEXT_START << result.m_name << ": " << std::fixed << std::setprecision(2)
+                    << result.m_mean << " ns/iter mean, " << result.m_median << " median, " << result.m_stddev << " stddev, "
+                    << result.m_min << " min (" << result.m_samples.size() << " samples of " << result.m_iterationsPerSample
+                    << " iterations)" << std::defaultfloat << PintTest::COLOUR_TEXT_END << "\n";
+            }
+            flush();
+        }
+        void runFinished(const PintTest::RunSummary& summary) override
+        {
+            if (!summary.m_slowest.empty())
+            {
+                m_buffer << "Slowest " << summary.m_slowest.size() << " tests:\n";
+                for (const auto& [name, duration] : summary.m_slowest)
+                    m_buffer << "  " << std::fixed << std::setprecision(3) << std::chrono::duration<double, std::milli>(duration).count() << std::defaultfloat << "ms  " << name << "\n";
+            }
+            if (summary.m_iterations > 1)
+                m_buffer << "Ran the tests " << summary.m_iterations << " times\n";
+            if (summary.m_seed)
+                m_buffer << "Shuffled with --seed=" << *summary.m_seed << "\n";
+            // which iteration failed is only news when there was more than one, or to say what its order's seed was
+            if (summary.m_iterations > 1 || summary.m_seed)
             {
-                if (!m_Str.empty() && m_Str[m_Str.length() - 1] == '\n')
-                    m_Str = m_Str.substr(0, m_Str.length() - 1);
-                std::ostringstream os_;
-                os_ << m_fn << "(" << m_line << "): " << m_Str;
-                std::cout
-                    << PintTest::RED_TEXT_START
-                    << "Test failed: "
-                    << os_.str()
-                    << PintTest::COLOUR_TEXT_END
-                    << "\n";
-#ifdef _WIN32
-                if (IsDebuggerPresent())
+                for (const auto& [iteration, seed] : summary.m_failedIterations)
                 {
-                    auto str = os_.str();
-                    str += "\n";
-                    OutputDebugString(str.data());
+                    m_buffer << PintTest::RED_TEXT_START << "Iteration " << iteration << " failed";
+                    if (summary.m_seed)
+                        m_buffer << ", \"--shuffle --seed=" << seed << "\" runs the tests in the same order";
+                    m_buffer << PintTest::COLOUR_TEXT_END << "\n";
                 }
-#endif
             }
+            if (summary.m_resources)
+            {
+                m_buffer << "Resources used by the tests: ";
+                writeUsage(*summary.m_resources);
+                m_buffer << " (the largest of the tests' peak RSS growths)\n";
+            }
+            const auto durationMs = std::chrono::duration_cast<std::chrono::milliseconds>(summary.m_duration).count();
+            if (summary.m_fails)
+                m_buffer << PintTest::RED_TEXT_START << "Ran " << summary.m_testsRan << " tests and " << summary.m_testsFailed << " failed (" << durationMs << "ms)" << PintTest::COLOUR_TEXT_END << "\n";
+            else
+                m_buffer << PintTest::GREEN_TEXT_START << "Ran " << summary.m_testsRan << " tests and none failed" << " failed (" << durationMs << "ms)" << PintTest::COLOUR_TEXT_END << "\n";
+            flush();
         }
-    private:
-        const char* m_fn;
-        const char* m_func;
-        uint_least32_t m_line;
-        std::string m_Str;
-    };
-}
-
-// Macro to generate a test case
-#define TEST(TestCase) \
-    namespace \
-    { \
-        struct TestStruct##TestCase \
-        { \
-            static void TestBody(); \
-        }; \
-        static const auto sTestStruct##TestCase = PintTest::registerTestFn(#TestCase, TestStruct##TestCase::TestBody); \
-    } \
-    void ::TestStruct##TestCase::TestBody()
-
-// Supporting macros for the expects and asserts to extract the commonality
-#define CONSTRUCT_WRITER \
-    PintTestNS::MsgWriter(std::source_location::current().file_name(), std::source_location::current().function_name(), std::source_location::current().line())
-
-#define PREAMBLE \
-    if (auto utestMsg = 
-
-#define POSTAMBLE_EXPECT \
-     ; utestMsg.empty()) ; /*no op*/ else CONSTRUCT_WRITER = utestMsg
-
-#define POSTAMBLE_ASSERT \
-     ; utestMsg.empty()) ; /*no op*/ else return CONSTRUCT_WRITER = utestMsg
-
-//
-//
-// These are the expects and asserts that the test code actuals calls
-//
-//
-
-#define EXPECT_TRUE(a) \
-    PREAMBLE PintTestNS::compTrue((a), #a) POSTAMBLE_EXPECT
-
-#define EXPECT_FALSE(a) \
-    PREAMBLE PintTestNS::compFalse((a), #a) POSTAMBLE_EXPECT
-
-#define EXPECT_EQ(a,b) \
-    PREAMBLE PintTestNS::compEq((a), (b), #a, #b) POSTAMBLE_EXPECT
-
-#define EXPECT_NE(a,b) \
-    PREAMBLE PintTestNS::compNe((a), (b), #a, #b) POSTAMBLE_EXPECT
-
-#define EXPECT_GT(a,b) \
-    PREAMBLE PintTestNS::compGt((a), (b), #a, #b) POSTAMBLE_EXPECT
 
-#define EXPECT_LT(a,b) \
-    PREAMBLE PintTestNS::compLt((a), (b), #a, #b) POSTAMBLE_EXPECT
+    private:
+        void writeCounters(const std::optional<PintTest::PerfCounters>& counters)
+        {
+            if (!counters)
+                return;
+            using PerfCounters = PintTest::PerfCounters;
+            for (int i = 0; i < PerfCounters::COUNTER_COUNT; ++i)
+            {
+                const auto counter = static_cast<PerfCounters::Counter>(i);
+                if (counters->has(counter))
+                    m_buffer << ", " << counters->m_values[counter] << " " << PerfCounters::NAMES[counter];
+                if (counter == PerfCounters::INSTRUCTIONS && counters->ipc())
+                    m_buffer << ", " << std::fixed << std::setprecision(2) << *counters->ipc() << std::defaultfloat << " IPC";
+            }
+        }
+        void writeAllocations(const std::optional<PintTest::AllocationCounts>& allocations)
+        {
+            if (allocations)
+                m_buffer << ", " << allocations->m_allocations << " allocations of " << allocations->m_bytes << " bytes";
+        }
+        void writeResources(const std::optional<PintTest::ResourceUsage>& resources)
+        {
+            if (!resources)
+                return;
+            m_buffer << ", ";
+            writeUsage(*resources);
+        }
+        void writeUsage(const PintTest::ResourceUsage& usage)
+        {
+            const auto ms = [](std::chrono::microseconds time) { return std::chrono::duration<double, std::milli>(time).count(); };
+            m_buffer << std::fixed << std::setprecision(1) << ms(usage.m_userTime) << "ms user + " << ms(usage.m_systemTime) << "ms system CPU"
+                << std::defaultfloat << std::setprecision(6) << ", " << usage.m_minorFaults << " minor and " << usage.m_majorFaults
+                << " major page faults, " << usage.m_voluntarySwitches << " voluntary and " << usage.m_involuntarySwitches
+                << " involuntary context switches, peak RSS +" << usage.m_peakRssGrowth / 1024 << "KB";
+        }
+        // A line for each stress run, and one for each of its threads
+        void writeStress(const std::vector<PintTest::StressResult>& stressResults)
+        {
+            for (const auto& stress : stressResults)
+            {
+                m_buffer << "    stress: " << stress.m_threads.size() << " threads, " << std::fixed << std::setprecision(0) << stress.operationsPerSecond()
+                    << " ops/s, " << stress.meanLatency().count() << "ns mean latency, " << stress.maxLatency().count() << "ns max\n";
+                for (size_t t = 0; t < stress.m_threads.size(); ++t)
+                {
+                    const auto& thread = stress.m_threads[t];
+                    m_buffer << "      thread " << t << " (cpu " << thread.m_cpu << "): " << thread.m_operations << " ops, " << thread.operationsPerSecond()
+                        << " ops/s, " << thread.meanLatency().count() << "ns mean latency, " << thread.m_maxLatency.count() << "ns max\n";
+                }
+                m_buffer << std::defaultfloat << std::setprecision(6);
+            }
+        }
+        void writeLatencies(const std::vector<PintTest::LatencySummary>& latencies)
+        {
+            using LatencySummary = PintTest::LatencySummary;
+            for (const auto& latency : latencies)
+            {
+                m_buffer << "    latency " << latency.m_name << ": " << latency.m_count << " samples";
+                for (int i = 0; i < LatencySummary::STATISTIC_COUNT; ++i)
+                    m_buffer << ", " << LatencySummary::NAMES[i] << " " << latency.m_values[i].count() << "ns";
+                m_buffer << "\n";
+            }
+        }
+        void writeFailure(const std::string& name, const PintTest::Failure& failure, bool crashed)
+        {
+            if (crashed)
+                m_buffer << PintTest::RED_TEXT_START << "Test crashed: " << name << " " << failure.m_message << PintTest::COLOUR_TEXT_END << "\n";
+            else
+                m_buffer << PintTest::RED_TEXT_START << "Test failed: " << failure.m_file << "(" << failure.m_line << "): " << failure.m_message << PintTest::COLOUR_TEXT_END << "\n";
+        }
+        void flushIfFull()
+        {
+            if (static_cast<size_t>(m_buffer.tellp()) >= m_bufferSize)
+                flush();
+        }
+        void flush()
+        {
+            const auto text = m_buffer.str();
+            if (text.empty())
+                return;
+            m_out << text << std::flush;
+            m_buffer.str({});
+        }
 
-#define EXPECT_GE(a,b) \
-    PREAMBLE PintTestNS::compGe((a), (b), #a, #b) POSTAMBLE_EXPECT
+        std::ostream& m_out;
+        bool m_quiet;
+        size_t m_bufferSize;
+        std::ostringstream m_buffer;
+    };
 
-#define EXPECT_LE(a,b) \
-    PREAMBLE PintTestNS::compLe((a), (b), #a, #b) POSTAMBLE_EXPECT
+    // Escape a string for use inside a JSON string literal
+    inline std::string jsonEscape(std::string_view text)
+    {
+        std::string escaped;
+        escaped.reserve(text.size());
+        for (const char c : text)
+        {
+            switch (c)
+            {
+            case '"': escaped += "\\\""; break;
+            case '\\': escaped += "\\\\"; break;
+            case '\n': escaped += "\\n"; break;
+            case '\r': escaped += "\\r"; break;
+            case '\t': escaped += "\\t"; break;
+            default:
+                if (static_cast<unsigned char>(c) < 0x20)
+                {
+                    char code[8];
+                    std::snprintf(code, sizeof(code), "\\u%04x", static_cast<unsigned>(static_cast<unsigned char>(c)));
+                    escaped += code;
+                }
+                else
+                {
+                    escaped += c;
+                }
+            }
+        }
+        return escaped;
+    }
 
-#define EXPECT_NEAR(a, b, tol) \
-    PREAMBLE PintTestNS::compNear((a), (b), (tol), #a, #b, #tol) POSTAMBLE_EXPECT
+    // Escape a string for use in XML text or an attribute value
+    inline std::string xmlEscape(std::string_view text)
+    {
+        std::string escaped;
+        escaped.reserve(text.size());
+        for (const char c : text)
+        {
+            switch (c)
+            {
+            case '"': escaped += "&quot;"; break;
+            case '\'': escaped += "&apos;"; break;
+            case '&': escaped += "&amp;"; break;
+            case '<': escaped += "&lt;"; break;
+            case '>': escaped += "&gt;"; break;
+            default:
+                // control characters other than tab and newline aren't allowed in XML 1.0 at all
+                if (static_cast<unsigned char>(c) >= 0x20 || c == '\t' || c == '\n' || c == '\r')
+                    escaped += c;
+            }
+        }
+        return escaped;
+    }
 
+    // Base for the reporters that write to a file, or to std::cout if no file name is given
+    class FileReporter : public PintTest::Reporter
+    {
+    public:
+        explicit FileReporter(const std::string& fileName)
+            : m_toFile(!fileName.empty())
+        {
+            if (m_toFile)
+                m_file.open(fileName);
+        }
+        [[nodiscard]] bool good() const { return !m_toFile || (m_file.is_open() && m_file.good()); }
+    protected:
+        std::ostream& out() { return m_toFile ? static_cast<std::ostream&>(m_file) : std::cout; }
+    private:
+        bool m_toFile;
+        std::ofstream m_file;
+    };
 
-#define ASSERT_TRUE(a) \
-    PREAMBLE PintTestNS::compTrue((a), #a) POSTAMBLE_ASSERT
+    // Streams the results as a single JSON object, with each test written as soon as it finishes:
+    // { "tests": [ { "name", "status", "duration_ns", "failures": [ { "file", "line", "message" } ],
+    //                "counters": { "cycles", "instructions", "ipc", "branch_misses", "l1d_misses", "llc_misses" },
+    //                "allocations": { "count", "bytes" },
+    //                "resources": { "user_us", "system_us", "minor_faults", "major_faults", "voluntary_switches",
+    //                               "involuntary_switches", "peak_rss_growth_bytes" } } ],
+    //   "benchmarks": [ { "name", "status", "iterations_per_sample", "mean_ns", "median_ns", "stddev_ns", "min_ns", "failures" } ],
+    //   "summary": { "tests_ran", "tests_failed", "checks_failed", "duration_ns", "resources" } }
+    class JsonReporter : public FileReporter
+    {
+    public:
+        explicit JsonReporter(const std::string& fileName)
+            : FileReporter(fileName)
+        {
+            out() << "{\n  \"tests\": [";
+        }
+        void testFinished(const PintTest::TestResult& result) override
+        {
+            out() << (m_first ? "\n" : ",\n") << "    { \"name\": \"" << jsonEscape(result.m_name)
+                << "\", \"status\": \"" << (result.m_crashed ? "crashed" : result.passed() ? "passed" : "failed")
+                << "\", \"duration_ns\": " << result.m_duration.count() << ", \"failures\": ";
+            writeFailures(result.m_failures);
+            if (result.m_counters)
+                writeCounters(*result.m_counters);
+            if (result.m_allocations)
+                out() << ", \"allocations\": { \"count\": " << result.m_allocations->m_allocations << ", \"bytes\": " << result.m_allocations->m_bytes << " }";
+            if (result.m_resources)
+                writeResources(*result.m_resources);
+            if (!result.m_stress.empty())
+                writeStress(result.m_stress);
+            if (!result.m_latencies.empty())
+                writeLatencies(result.m_latencies);
+            out() << " }";
+            m_first = false;
+        }
+        void benchmarkFinished(const PintTest::BenchmarkResult& result) override
+        {
+            if (!m_inBenchmarks)
+            {
+                out() << "\n  ],\n  \"benchmarks\": [";
+                m_inBenchmarks = true;
+                m_first = true;
+            }
+            out() << (m_first ? "\n" : ",\n") << "    { \"name\": \"" << jsonEscape(result.m_name)
+                << "\", \"status\": \"" << (result.passed() ? "passed" : "failed")
+                << "\", \"iterations_per_sample\": " << result.m_iterationsPerSample
+                << ", \"mean_ns\": " << result.m_mean << ", \"median_ns\": " << result.m_median
+                << ", \"stddev_ns\": " << result.m_stddev << ", \"min_ns\": " << result.m_min << ", \"failures\": ";
+            writeFailures(result.m_failures);
+            out() << " }";
+            m_first = false;
+        }
+        void runFinished(const PintTest::RunSummary& summary) override
+        {
+            out() << "\n  ],\n";
+            if (!m_inBenchmarks)
+                out() << "  \"benchmarks\": [],\n";
+            if (!summary.m_slowest.empty())
+            {
+                out() << "  \"slowest\": [";
+                for (size_t i = 0; i < summary.m_slowest.size(); ++i)
+                    out() << (i ? ", " : "") << "{ \"name\": \"" << jsonEscape(summary.m_slowest[i].first) << "\", \"duration_ns\": " << summary.m_slowest[i].second.count() << " }";
+                out() << "],\n";
+            }
+            out() << "  \"summary\": { \"tests_ran\": " << summary.m_testsRan << ", \"tests_failed\": " << summary.m_testsFailed
+                << ", \"checks_failed\": " << summary.m_fails << ", \"duration_ns\": " << summary.m_duration.count();
+            if (summary.m_iterations > 1 || summary.m_seed)
+            {
+                out() << ", \"iterations\": " << summary.m_iterations;
+                if (summary.m_seed)
+                    out() << ", \"seed\": " << *summary.m_seed;
+                out() << ", \"failed_iterations\": [";
+                for (size_t i = 0; i < summary.m_failedIterations.size(); ++i)
+                {
+                    out() << (i ? ", " : "") << "{ \"iteration\": " << summary.m_failedIterations[i].first;
+                    if (summary.m_seed)
+                        out() << ", \"seed\": " << summary.m_failedIterations[i].second;
+                    out() << " }";
+                }
+                out() << "]";
+            }
+            if (summary.m_resources)
+                writeResources(*summary.m_resources);
+            out() << " }\n}\n" << std::flush;
+        }
 
-#define ASSERT_FALSE(a) \
-    PREAMBLE PintTestNS::compFalse((a), #a) POSTAMBLE_ASSERT
+    private:
+        void writeFailures(const std::vector<PintTest::Failure>& failures)
+        {
+            out() << "[";
+            for (size_t i = 0; i < failures.size(); ++i)
+            {
+                out() << (i ? ", " : "") << "{ \"file\": \"" << jsonEscape(failures[i].m_file) << "\", \"line\": " << failures[i].m_line
+                    << ", \"message\": \"" << jsonEscape(failures[i].m_message) << "\" }";
+            }
+            out() << "]";
+        }
+        void writeStress(const std::vector<PintTest::StressResult>& stressResults)
+        {
+            out() << ", \"stress\": [";
+            for (size_t i = 0; i < stressResults.size(); ++i)
+            {
+                const auto& stress = stressResults[i];
+                out() << (i ? ", " : "") << "{ \"operations\": " << stress.operations() << ", \"elapsed_ns\": " << stress.m_elapsed.count()
+                    << ", \"ops_per_second\": " << stress.operationsPerSecond() << ", \"mean_latency_ns\": " << stress.meanLatency().count()
+                    << ", \"max_latency_ns\": " << stress.maxLatency().count() << ", \"threads\": [";
+                for (size_t t = 0; t < stress.m_threads.size(); ++t)
+                {
+                    const auto& thread = stress.m_threads[t];
+                    out() << (t ? ", " : "") << "{ \"cpu\": " << thread.m_cpu << ", \"operations\": " << thread.m_operations
+                        << ", \"elapsed_ns\": " << thread.m_elapsed.count() << ", \"ops_per_second\": " << thread.operationsPerSecond()
+                        << ", \"mean_latency_ns\": " << thread.meanLatency().count() << ", \"max_latency_ns\": " << thread.m_maxLatency.count() << " }";
+                }
+                out() << "] }";
+            }
+            out() << "]";
+        }
+        void writeLatencies(const std::vector<PintTest::LatencySummary>& latencies)
+        {
+            using LatencySummary = PintTest::LatencySummary;
+            out() << ", \"latencies\": [";
+            for (size_t l = 0; l < latencies.size(); ++l)
+            {
+                out() << (l ? ", " : "") << "{ \"name\": \"" << jsonEscape(latencies[l].m_name) << "\", \"count\": " << latencies[l].m_count;
+                for (int i = 0; i < LatencySummary::STATISTIC_COUNT; ++i)
+                    out() << ", \"" << LatencySummary::NAMES[i] << "_ns\": " << latencies[l].m_values[i].count();
+                out() << " }";
+            }
+            out() << "]";
+        }
+        void writeResources(const PintTest::ResourceUsage& usage)
+        {
+            out() << ", \"resources\": { \"user_us\": " << usage.m_userTime.count() << ", \"system_us\": " << usage.m_systemTime.count()
+                << ", \"minor_faults\": " << usage.m_minorFaults << ", \"major_faults\": " << usage.m_majorFaults
+                << ", \"voluntary_switches\": " << usage.m_voluntarySwitches << ", \"involuntary_switches\": " << usage.m_involuntarySwitches
+                << ", \"peak_rss_growth_bytes\": " << usage.m_peakRssGrowth << " }";
+        }
+        // only the counters that could be read are written
+        void writeCounters(const PintTest::PerfCounters& counters)
+        {
+            using PerfCounters = PintTest::PerfCounters;
+            out() << ", \"counters\": {";
+            const char* separator = " ";
+            for (int i = 0; i < PerfCounters::COUNTER_COUNT; ++i)
+            {
+                const auto counter = static_cast<PerfCounters::Counter>(i);
+                if (!counters.has(counter))
+                    continue;
+                out() << separator << "\"" << PerfCounters::NAMES[counter] << "\": " << counters.m_values[counter];
+                separator = ", ";
+            }
+            if (const auto ipc = counters.ipc())
+                out() << separator << "\"ipc\": " << *ipc;
+            out() << " }";
+        }
 
-#define ASSERT_EQ(a,b) \
-    PREAMBLE PintTestNS::compEq((a), (b), #a, #b) POSTAMBLE_ASSERT
+        bool m_first = true;
+        bool m_inBenchmarks = false;
+    };
 
-#define ASSERT_NE(a,b) \
-    PREAMBLE PintTestNS::compNe((a), (b), #a, #b) POSTAMBLE_ASSERT
+    // Streams the results as JUnit XML, with each test written as a testcase as soon as it finishes.  The totals aren't
+    // known until the end, so they aren't given as attributes - JUnit consumers count the testcases themselves
+    class JUnitReporter : public FileReporter
+    {
+    public:
+        explicit JUnitReporter(const std::string& fileName)
+            : FileReporter(fileName)
+        {
+            out() << "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n<testsuites name=\"PintTest\">\n  <testsuite name=\"PintTest\">\n";
+        }
+        void testFinished(const PintTest::TestResult& result) override
+        {
+            std::vector<std::pair<std::string, std::string>> properties;
+            if (result.m_counters)
+            {
+                using PerfCounters = PintTest::PerfCounters;
+                for (int i = 0; i < PerfCounters::COUNTER_COUNT; ++i)
+                {
+                    const auto counter = static_cast<PerfCounters::Counter>(i);
+                    if (result.m_counters->has(counter))
+                        properties.emplace_back(PerfCounters::NAMES[counter], std::to_string(result.m_counters->m_values[counter]));
+                }
+                if (const auto ipc = result.m_counters->ipc())
+                    properties.emplace_back("ipc", PintTestNS::GetString(*ipc));
+            }
+            if (result.m_allocations)
+            {
+                properties.emplace_back("allocations", std::to_string(result.m_allocations->m_allocations));
+                properties.emplace_back("allocated_bytes", std::to_string(result.m_allocations->m_bytes));
+            }
+            if (result.m_resources)
+            {
+                properties.emplace_back("user_us", std::to_string(result.m_resources->m_userTime.count()));
+                properties.emplace_back("system_us", std::to_string(result.m_resources->m_systemTime.count()));
+                properties.emplace_back("minor_faults", std::to_string(result.m_resources->m_minorFaults));
+                properties.emplace_back("major_faults", std::to_string(result.m_resources->m_majorFaults));
+                properties.emplace_back("voluntary_switches", std::to_string(result.m_resources->m_voluntarySwitches));
+                properties.emplace_back("involuntary_switches", std::to_string(result.m_resources->m_involuntarySwitches));
+                properties.emplace_back("peak_rss_growth_bytes", std::to_string(result.m_resources->m_peakRssGrowth));
+            }
+            for (size_t i = 0; i < result.m_stress.size(); ++i)
+            {
+                const auto prefix = "stress" + std::to_string(i) + ".";
+                properties.emplace_back(prefix + "threads", std::to_string(result.m_stress[i].m_threads.size()));
+                properties.emplace_back(prefix + "ops_per_second", PintTestNS::GetString(result.m_stress[i].operationsPerSecond()));
+                properties.emplace_back(prefix + "mean_latency_ns", std::to_string(result.m_stress[i].meanLatency().count()));
+                properties.emplace_back(prefix + "max_latency_ns", std::to_string(result.m_stress[i].maxLatency().count()));
+            }
+            for (const auto& latency : result.m_latencies)
+            {
+                using LatencySummary = PintTest::LatencySummary;
+                properties.emplace_back(latency.m_name + ".count", std::to_string(latency.m_count));
+                for (int i = 0; i < LatencySummary::STATISTIC_COUNT; ++i)
+                    properties.emplace_back(latency.m_name + "." + LatencySummary::NAMES[i] + "_ns", std::to_string(latency.m_values[i].count()));
+            }
+            writeTestCase(result.m_name, "PintTest", result.m_duration, result.m_failures, result.m_crashed ? "crash" : "failure", {}, properties);
+        }
+        void benchmarkFinished(const PintTest::BenchmarkResult& result) override
+        {
+            std::ostringstream stats;
+            stats << result.m_mean << " ns/iter mean, " << result.m_median << " median, " << result.m_stddev << " stddev, " << result.m_min << " min";
+            const auto duration = std::chrono::nanoseconds(static_cast<int64_t>(result.m_mean * static_cast<double>(result.m_iterationsPerSample * result.m_samples.size())));
+            writeTestCase(result.m_name, "PintTest.benchmark", duration, result.m_failures, "failure", result.passed() ? stats.str() : std::string(), {});
+        }
+        void runFinished(const PintTest::RunSummary&) override
+        {
+            out() << "  </testsuite>\n</testsuites>\n" << std::flush;
+        }
 
-#define ASSERT_GT(a,b) \
-    PREAMBLE PintTestNS::compGt((a), (b), #a, #b) POSTAMBLE_ASSERT
+    private:
+        // The hardware counters, allocations and resource usage are written as testcase properties, which most JUnit
+        // consumers keep
+        void writeTestCase(const std::string& name, const char* className, std::chrono::nanoseconds duration,
+            const std::vector<PintTest::Failure>& failures, const char* failureType, const std::string& systemOut,
+            const std::vector<std::pair<std::string, std::string>>& properties)
+        {
+            out() << "    <testcase name=\"" << xmlEscape(name) << "\" classname=\"" << className << "\" time=\""
+                << std::fixed << std::setprecision(6) << std::chrono::duration<double>(duration).count() << std::defaultfloat << "\"";
+            if (failures.empty() && systemOut.empty() && properties.empty())
+            {
+                out() << "/>\n";
+                return;
+            }
+            out() << ">\n";
+            if (!properties.empty())
+            {
+                out() << "      <properties>\n";
+                for (const auto& [propertyName, value] : properties)
+                    out() << "        <property name=\"" << propertyName << "\" value=\"" << xmlEscape(value) << "\"/>\n";
+                out() << "      </properties>\n";
+            }
+            if (!failures.empty())
+            {
+                const auto& first = failures.front();
+                out() << "      <failure type=\"" << failureType << "\" message=\"" << xmlEscape(first.m_file) << "(" << first.m_line << ")\">";
+                for (const auto& failure : failures)
+                    out() << xmlEscape(failure.m_file) << "(" << failure.m_line << "): " << xmlEscape(failure.m_message) << "\n";
+                out() << "</failure>\n";
+            }
+            if (!systemOut.empty())
+                out() << "      <system-out>" << xmlEscape(systemOut) << "</system-out>\n";
+            out() << "    </testcase>\n";
+        }
+    };
 
-#define ASSERT_LT(a,b) \
-    PREAMBLE PintTestNS::compLt((a), (b), #a, #b) POSTAMBLE_ASSERT
+    // Passes everything on to each of a set of reporters
+    class MultiReporter : public PintTest::Reporter
+    {
+    public:
+        void add(std::shared_ptr<PintTest::Reporter> reporter) { m_reporters.push_back(std::move(reporter)); }
 
-#define ASSERT_GE(a,b) \
-    PREAMBLE PintTestNS::compGe((a), (b), #a, #b) POSTAMBLE_ASSERT
+        void testStarting(const std::string& name) override { for (auto& r : m_reporters) r->testStarting(name); }
+        void testFinished(const PintTest::TestResult& result) override { for (auto& r : m_reporters) r->testFinished(result); }
+        void benchmarkStarting(const std::string& name) override { for (auto& r : m_reporters) r->benchmarkStarting(name); }
+        void benchmarkFinished(const PintTest::BenchmarkResult& result) override { for (auto& r : m_reporters) r->benchmarkFinished(result); }
+        void runFinished(const PintTest::RunSummary& summary) override { for (auto& r : m_reporters) r->runFinished(summary); }
+    private:
+        std::vector<std::shared_ptr<PintTest::Reporter>> m_reporters;
+    };
+}
 
-#define ASSERT_LE(a,b) \
-    PREAMBLE PintTestNS::compLe((a), (b), #a, #b) POSTAMBLE_ASSERT
+PINTTEST_RUNNER_INLINE void PintTest::LatencyRecorder::report(const std::string& name) const
+{
+    if (!s_currentTest || !s_currentTest->m_result)
+        return;
+    auto summary = this->summary();
+    summary.m_name = name;
+    auto& latencies = s_currentTest->m_result->m_latencies;
+    const auto existing = std::find_if(latencies.begin(), latencies.end(), [&name](const auto& latency) { return latency.m_name == name; });
+    if (existing != latencies.end())
+        *existing = std::move(summary);
+    else
+        latencies.push_back(std::move(summary));
+}
 
-#define ASSERT_NEAR(a, b, tol) \
-    PREAMBLE PintTestNS::compNear((a), (b), (tol), #a, #b, #tol) POSTAMBLE_ASSERT
+PINTTEST_RUNNER_INLINE void PintTest::runTest(std::function<void()> testFn, const std::string& testCase)
+{
+    PintTestNS::ConsoleReporter reporter(std::cout, false, 0);
+    reporter.testStarting(testCase);
+    reporter.testFinished(executeTest(testFn, testCase));
+}
 
-//
-//
-// End of expects and asserts
-//
-//
+PINTTEST_RUNNER_INLINE std::unique_ptr<PintTest::Reporter> PintTestNS::Runner::createReporter(const Options& options)
+{
+    constexpr size_t CONSOLE_BUFFER_SIZE = 1 << 20;
+    auto reporter = std::make_unique<PintTestNS::MultiReporter>();
+    if (options.m_outputs.empty())
+        reporter->add(std::make_shared<PintTestNS::ConsoleReporter>(std::cout, false, CONSOLE_BUFFER_SIZE));
+    for (const auto& output : options.m_outputs)
+    {
+        const auto colon = output.find(':');
+        const auto kind = output.substr(0, colon);
+        const auto fileName = colon == std::string::npos ? std::string() : output.substr(colon + 1);
+        std::shared_ptr<PintTestNS::FileReporter> fileReporter;
+        if (kind == "console" && fileName.empty())
+            reporter->add(std::make_shared<PintTestNS::ConsoleReporter>(std::cout, false, CONSOLE_BUFFER_SIZE));
+        else if (kind == "quiet" && fileName.empty())
+            reporter->add(std::make_shared<PintTestNS::ConsoleReporter>(std::cout, true, CONSOLE_BUFFER_SIZE));
+        else if (kind == "json")
+            fileReporter = std::make_shared<PintTestNS::JsonReporter>(fileName);
+        else if (kind == "junit")
+            fileReporter = std::make_shared<PintTestNS::JUnitReporter>(fileName);
+        else
+        {
+            std::cerr << "Unknown \"--output=" << output << "\", terminating\n";
+            return nullptr;
+        }
+        if (fileReporter && !fileReporter->good())
+        {
+            std::cerr << "Unable to open \"" << fileName << "\" for \"--output=" << output << "\", terminating\n";
+            return nullptr;
+        }
+        if (fileReporter)
+            reporter->add(fileReporter);
+    }
+    for (const auto& added : s_addedReporters)
+        reporter->add(added);
+    return reporter;
+}
 
 // A function to sanity check the various test macros. These tests should all pass
-inline void PintTest::selfTest()
+PINTTEST_RUNNER_INLINE void PintTest::selfTest()
 {
     EXPECT_EQ(1, 1);
     EXPECT_NE(1, 2);
@@ -509,7 +6908,98 @@ inline void PintTest::selfTest()
     ASSERT_LT(1, 2);
     ASSERT_LE(1, 2);
     ASSERT_LE(2, 2);
+
+    const std::array<int, 3> ints{ 1, 2, 3 };
+    const std::vector<int> sameInts{ 1, 2, 3 };
+    EXPECT_RANGE_EQ(ints, sameInts);
+    ASSERT_RANGE_EQ(ints, sameInts);
+    const std::vector<double> doubles{ 1.0, 2.0, 3.0 };
+    EXPECT_RANGE_NEAR(doubles, ints, 0.001);
+    EXPECT_RANGE_NEAR(doubles, doubles, PintTest::Tolerance::ulps(0));
+    ASSERT_RANGE_NEAR(doubles, ints, PintTest::Tolerance::relative(0.001));
+}
+
+#endif
+
+#ifdef PINTTEST_TRACK_ALLOCATIONS
+// The replacement global allocation functions, which count every allocation for the thread that makes it.  These are
+// definitions that aren't inline, so PINTTEST_TRACK_ALLOCATIONS must only be defined in one translation unit
+namespace PintTestNS
+{
+    inline void* trackedAllocate(std::size_t size, std::align_val_t alignment, bool nothrow)
+    {
+        PintTest::countAllocation(size);
+        const auto align = static_cast<std::size_t>(alignment);
+        for (;;)
+        {
+#ifdef _WIN32
+            void* p = align <= alignof(std::max_align_t) ? std::malloc(size ? size : 1) : _aligned_malloc(size ? size : 1, align);
+#else
+            void* p = align <= alignof(std::max_align_t) ? std::malloc(size ? size : 1) : std::aligned_alloc(align, (size + align - 1) / align * align);
+#endif
+            if (p)
+                return p;
+            const auto handler = std::get_new_handler();
+            if (!handler)
+            {
+                if (nothrow)
+                    return nullptr;
+                throw std::bad_alloc();
+            }
+            // the nothrow versions are noexcept, so a handler that throws (as it may, with std::bad_alloc) means nullptr
+            if (!nothrow)
+            {
+                handler();
+                continue;
+            }
+            try
+            {
+                handler();
+            }
+            catch (...)
+            {
+                return nullptr;
+            }
+        }
+    }
+    inline void trackedFree(void* p, std::align_val_t alignment) noexcept
+    {
+#ifdef _WIN32
+        if (static_cast<std::size_t>(alignment) > alignof(std::max_align_t))
+        {
+            _aligned_free(p);
+            return;
+        }
+#else
+        (void)alignment;
+#endif
+        std::free(p);
+    }
+    inline const bool s_allocationTrackingInstalled = (PintTest::allocationTrackingInstalled(), true);
+    constexpr std::align_val_t DEFAULT_ALIGNMENT{ alignof(std::max_align_t) };
 }
 
+void* operator new(std::size_t size) { return PintTestNS::trackedAllocate(size, PintTestNS::DEFAULT_ALIGNMENT, false); }
+void* operator new[](std::size_t size) { return PintTestNS::trackedAllocate(size, PintTestNS::DEFAULT_ALIGNMENT, false); }
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept { return PintTestNS::trackedAllocate(size, PintTestNS::DEFAULT_ALIGNMENT, true); }
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept { return PintTestNS::trackedAllocate(size, PintTestNS::DEFAULT_ALIGNMENT, true); }
+void* operator new(std::size_t size, std::align_val_t alignment) { return PintTestNS::trackedAllocate(size, alignment, false); }
+void* operator new[](std::size_t size, std::align_val_t alignment) { return PintTestNS::trackedAllocate(size, alignment, false); }
+void* operator new(std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept { return PintTestNS::trackedAllocate(size, alignment, true); }
+void* operator new[](std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept { return PintTestNS::trackedAllocate(size, alignment, true); }
+void operator delete(void* p) noexcept { PintTestNS::trackedFree(p, PintTestNS::DEFAULT_ALIGNMENT); }
+void operator delete[](void* p) noexcept { PintTestNS::trackedFree(p, PintTestNS::DEFAULT_ALIGNMENT); }
+void operator delete(void* p, std::size_t) noexcept { PintTestNS::trackedFree(p, PintTestNS::DEFAULT_ALIGNMENT); }
+void operator delete[](void* p, std::size_t) noexcept { PintTestNS::trackedFree(p, PintTestNS::DEFAULT_ALIGNMENT); }
+void operator delete(void* p, const std::nothrow_t&) noexcept { PintTestNS::trackedFree(p, PintTestNS::DEFAULT_ALIGNMENT); }
+void operator delete[](void* p, const std::nothrow_t&) noexcept { PintTestNS::trackedFree(p, PintTestNS::DEFAULT_ALIGNMENT); }
+void operator delete(void* p, std::align_val_t alignment) noexcept { PintTestNS::trackedFree(p, alignment); }
+void operator delete[](void* p, std::align_val_t alignment) noexcept { PintTestNS::trackedFree(p, alignment); }
+void operator delete(void* p, std::size_t, std::align_val_t alignment) noexcept { PintTestNS::trackedFree(p, alignment); }
+void operator delete[](void* p, std::size_t, std::align_val_t alignment) noexcept { PintTestNS::trackedFree(p, alignment); }
+void operator delete(void* p, std::align_val_t alignment, const std::nothrow_t&) noexcept { PintTestNS::trackedFree(p, alignment); }
+void operator delete[](void* p, std::align_val_t alignment, const std::nothrow_t&) noexcept { PintTestNS::trackedFree(p, alignment); }
+#endif
+
 
 #endif
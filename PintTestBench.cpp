@@ -0,0 +1,313 @@
+// Benchmarks of PintTest's own overhead.  Build and run with e.g.
+//     g++ -std=c++20 -O2 -pthread PintTestBench.cpp -o PintTestBench && ./PintTestBench
+// Any arguments are passed through to PintTest::runAllTests, so --filter= can be used to pick benchmarks,
+// --output=json:<file> writes the timings out for a script to read, and --save-baseline=/--compare-baseline= keep
+// track of them from one build to the next.
+
+#include "PintTest.h"
+
+#include <vector>
+#include <string>
+#include <string_view>
+#include <sstream>
+#include <cmath>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+    // The assertion result as it was before the passing path was made allocation free - every check constructed and
+    // destroyed an ostringstream, pass or fail.  Kept here so the two can be compared
+    class OstringstreamMsg
+    {
+    public:
+        OstringstreamMsg() = default;
+        OstringstreamMsg(const std::string& value)
+            : m_Empty(value.empty())
+        {
+            m_SS << value;
+        }
+        [[nodiscard]] bool empty() const { return m_Empty; }
+    private:
+        bool m_Empty = true;
+        std::ostringstream m_SS;
+    };
+
+    template<class L, class R>
+    OstringstreamMsg ostringstreamCompEq(const L& l, const R& r, const char* pL, const char* pR)
+    {
+        if (l == r)
+            return {};
+        return std::string("\n") + pL + " == " + pR + "\nExpected: " + PintTestNS::GetString(l) + "\n" + "Actual: " + PintTestNS::GetString(r) + "\n";
+    }
+
+    BENCHMARK(PassingExpectEqOstringstreamMsg)
+    {
+        int i = 0;
+        while (state.keepRunning())
+        {
+            PintTest::DoNotOptimize(i);
+            if (auto utestMsg = ostringstreamCompEq(i, i, "i", "i"); utestMsg.empty())
+                ; // no op
+            else
+                PintTest::DoNotOptimize(utestMsg);
+        }
+    }
+
+    BENCHMARK(PassingExpectEq)
+    {
+        int i = 0;
+        while (state.keepRunning())
+        {
+            PintTest::DoNotOptimize(i);
+            EXPECT_EQ(i, i) << "streamed values are only formatted on failure " << i;
+        }
+    }
+
+    BENCHMARK(PassingExpectNear)
+    {
+        double d = 1.0;
+        while (state.keepRunning())
+        {
+            PintTest::DoNotOptimize(d);
+            EXPECT_NEAR(d, d, 0.001);
+        }
+    }
+
+    // Comparing two buffers of 64K elements (small enough to stay in cache), as a loop of EXPECT_EQs and as a single range check
+    constexpr size_t RANGE_SIZE = 1 << 16;
+
+    BENCHMARK(LoopOfExpectEq64K)
+    {
+        const std::vector<double> a(RANGE_SIZE, 1.5);
+        const std::vector<double> b(RANGE_SIZE, 1.5);
+        while (state.keepRunning())
+        {
+            for (size_t i = 0; i < RANGE_SIZE; ++i)
+                EXPECT_EQ(a[i], b[i]) << i;
+            PintTest::ClobberMemory();
+        }
+    }
+
+    BENCHMARK(RangeEqInts64K)
+    {
+        const std::vector<int> a(RANGE_SIZE, 7);
+        const std::vector<int> b(RANGE_SIZE, 7);
+        while (state.keepRunning())
+        {
+            EXPECT_RANGE_EQ(a, b);
+            PintTest::ClobberMemory();
+        }
+    }
+
+    BENCHMARK(RangeEqDoubles64K)
+    {
+        const std::vector<double> a(RANGE_SIZE, 1.5);
+        const std::vector<double> b(RANGE_SIZE, 1.5);
+        while (state.keepRunning())
+        {
+            EXPECT_RANGE_EQ(a, b);
+            PintTest::ClobberMemory();
+        }
+    }
+
+    BENCHMARK(RangeNearAbsolute64K)
+    {
+        const std::vector<double> a(RANGE_SIZE, 1.5);
+        const std::vector<double> b(RANGE_SIZE, 1.5 + 1e-12);
+        while (state.keepRunning())
+        {
+            EXPECT_RANGE_NEAR(a, b, 1e-9);
+            PintTest::ClobberMemory();
+        }
+    }
+
+    BENCHMARK(RangeNearUlps64K)
+    {
+        const std::vector<double> a(RANGE_SIZE, 1.5);
+        const std::vector<double> b(RANGE_SIZE, std::nextafter(1.5, 2.0));
+        while (state.keepRunning())
+        {
+            EXPECT_RANGE_NEAR(a, b, PintTest::Tolerance::ulps(4));
+            PintTest::ClobberMemory();
+        }
+    }
+
+    // Recording a latency, which has to be cheap enough to go in the loop being measured.  The values cycle through a
+    // range of magnitudes so that the buckets they land in vary
+    BENCHMARK(LatencyRecord)
+    {
+        PintTest::LatencyRecorder recorder;
+        uint64_t ns = 1;
+        while (state.keepRunning())
+        {
+            recorder.record(ns);
+            ns = ns * 3 % 1000003;
+            PintTest::DoNotOptimize(ns);
+        }
+        PintTest::DoNotOptimize(recorder.count());
+    }
+
+    // Checking a property, 1000 cases (the default --property-cases) per iteration, each of which makes its arguments
+    // and calls the body.  Numbers alone, then vectors, which once grown are reused from one case to the next
+    BENCHMARK(PropertyIntCases1K)
+    {
+        const auto body = [](int x, int y) { EXPECT_EQ(int64_t(x) + y, int64_t(y) + x); };
+        while (state.keepRunning())
+            PintTest::checkProperty("PropertyIntCases1K", body, PintTest::Gen::integers<int>(), PintTest::Gen::integers<int>());
+    }
+
+    BENCHMARK(PropertyVectorCases1K)
+    {
+        const auto body = [](const std::vector<int>& v) { EXPECT_LE(v.size(), 16u); };
+        while (state.keepRunning())
+            PintTest::checkProperty("PropertyVectorCases1K", body, PintTest::Gen::vectors(PintTest::Gen::integers<int>(), 16));
+    }
+
+    // Checks that fail, each in a trial of its own so that it is formatted in full (a test reports the first
+    // --failures-per-site failures of a check in full), and doesn't fail the benchmark.  EmptyTrial is the cost of the
+    // trial on its own
+    BENCHMARK(EmptyTrial)
+    {
+        while (state.keepRunning())
+            PintTest::DoNotOptimize(PintTest::runTrial([] {}));
+    }
+
+    BENCHMARK(FailingExpectEq)
+    {
+        int i = 0;
+        while (state.keepRunning())
+        {
+            PintTest::DoNotOptimize(i);
+            PintTest::DoNotOptimize(PintTest::runTrial([&i] { EXPECT_EQ(i, i + 1) << "streamed values are formatted on failure " << i; }));
+        }
+    }
+
+    // Past the first --failures-per-site failures of a check the rest are only counted
+    BENCHMARK(FailingExpectEqCounted)
+    {
+        int i = 0;
+        PintTest::runTrial([&]
+            {
+                while (state.keepRunning())
+                {
+                    PintTest::DoNotOptimize(i);
+                    EXPECT_EQ(i, i + 1) << i;
+                }
+            });
+    }
+
+    // How fast failure messages are made from values that take some formatting: 1KB strings, and ranges that differ
+    // in every element
+    BENCHMARK(FailingExpectEqStrings1K)
+    {
+        const std::string a(1024, 'a');
+        const std::string b = a + 'b';
+        while (state.keepRunning())
+            PintTest::DoNotOptimize(PintTest::runTrial([&] { EXPECT_EQ(a, b); }));
+    }
+
+    BENCHMARK(FailingRangeEqDoubles64K)
+    {
+        const std::vector<double> a(RANGE_SIZE, 1.5);
+        const std::vector<double> b(RANGE_SIZE, 2.5);
+        while (state.keepRunning())
+            PintTest::DoNotOptimize(PintTest::runTrial([&] { EXPECT_RANGE_EQ(a, b); }));
+    }
+
+#ifdef __linux__
+    // Registering tests and starting a run over them, and running them, are timed in a child process forked for each
+    // iteration, so that the tests registered there leave this run alone.  ForkAndWait is the cost of the child on its
+    // own, to subtract from the others, and the difference divided by the number of tests is the cost of each
+    bool inChild(const std::function<bool()>& fn)
+    {
+        const pid_t pid = ::fork();
+        if (pid == 0)
+        {
+            // the child's runs report to /dev/null
+            const int devNull = ::open("/dev/null", O_WRONLY | O_CLOEXEC);
+            if (devNull < 0 || ::dup2(devNull, STDOUT_FILENO) < 0 || ::dup2(devNull, STDERR_FILENO) < 0)
+                ::_exit(1);
+            if (devNull > STDERR_FILENO)
+                ::close(devNull);
+            ::_exit(fn() ? 0 : 1);
+        }
+        int status = 0;
+        return pid > 0 && ::waitpid(pid, &status, 0) == pid && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+    }
+
+    void emptyTest()
+    {
+    }
+
+    // Register count empty tests with registerTestFn, and run those that filter picks (all of them if it's empty), checking
+    // that expectedRan tests ran (counting PintTest::selfTest) and none failed
+    void registerAndRun(PintTest::BenchmarkState& state, size_t count, std::string_view filter, int expectedRan)
+    {
+        std::vector<std::string> names;
+        for (size_t i = 0; i < count; ++i)
+            names.push_back("EmptyTest" + std::to_string(i));
+        std::vector<std::string_view> args;
+        if (!filter.empty())
+            args.push_back(filter);
+        while (state.keepRunning())
+        {
+            const bool ran = inChild([&]
+                {
+                    for (const auto& name : names)
+                        PintTest::registerTestFn(name.c_str(), emptyTest);
+                    return PintTest::runAllTests2(args) == std::pair{ expectedRan, 0 };
+                });
+            EXPECT_TRUE(ran);
+        }
+    }
+
+    BENCHMARK(ForkAndWait)
+    {
+        while (state.keepRunning())
+            EXPECT_TRUE(inChild([] { return true; }));
+    }
+
+    // Startup: registering, checking the names are unique and filtering them, with a filter that picks none.
+    // PintTestStartupBench.sh times the same for tests compiled in as TESTs, static initialisers and all
+    BENCHMARK(RegisterAndStart1K)
+    {
+        registerAndRun(state, 1000, "--filter=NoTestIsCalledThis", 1);
+    }
+
+    BENCHMARK(RegisterAndStart10K)
+    {
+        registerAndRun(state, 10000, "--filter=NoTestIsCalledThis", 1);
+    }
+
+    BENCHMARK(RegisterAndStart100K)
+    {
+        registerAndRun(state, 100000, "--filter=NoTestIsCalledThis", 1);
+    }
+
+    // Dispatch: the above, but running every test and reporting it to the console, less RegisterAndStart10K
+    BENCHMARK(RegisterAndRun10K)
+    {
+        registerAndRun(state, 10000, {}, 10001);
+    }
+#endif
+
+    // The cost of the loop and DoNotOptimize on their own, to subtract from the above
+    BENCHMARK(EmptyLoop)
+    {
+        int i = 0;
+        while (state.keepRunning())
+            PintTest::DoNotOptimize(i);
+    }
+}
+
+int main(int argc, const char* argv[])
+{
+    std::vector<std::string_view> args(argv + (argc > 0 ? 1 : 0), argv + argc);
+    args.emplace_back("--benchmark");
+    return PintTest::runAllTests(args);
+}
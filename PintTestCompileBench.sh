@@ -0,0 +1,73 @@
+#!/bin/sh
+# Measures how long a test file takes to compile - generates a translation unit of TESTS tests with ASSERTIONS_PER_TEST
+# checks each (1,000 checks by default, of a mix of kinds), and times compiling it with the header used header only, and
+# with PINTTEST_SEPARATE_IMPLEMENTATION, when the runner is in a translation unit of its own (which is also timed, but
+# only has to be built once).
+#     ./PintTestCompileBench.sh [header directory]
+# The header directory defaults to this one, so another version of PintTest.h can be compared by passing its directory.
+# CXX, CXXFLAGS, TESTS, ASSERTIONS_PER_TEST and RUNS can be set in the environment.
+set -e
+
+HEADER_DIR=$(cd "${1:-$(dirname "$0")}" && pwd)
+CXX=${CXX:-g++}
+CXXFLAGS=${CXXFLAGS:--std=c++20 -O2 -pthread}
+TESTS=${TESTS:-100}
+ASSERTIONS_PER_TEST=${ASSERTIONS_PER_TEST:-10}
+RUNS=${RUNS:-3}
+
+WORK_DIR=$(mktemp -d)
+trap 'rm -rf "$WORK_DIR"' EXIT
+
+{
+    echo '#include "PintTest.h"'
+    echo '#include <string>'
+    echo '#include <vector>'
+    awk -v tests="$TESTS" -v count="$ASSERTIONS_PER_TEST" 'BEGIN {
+        for (t = 0; t < tests; ++t)
+        {
+            printf "TEST(Compile_%d)\n{\n    int i = %d;\n    double d = %d.5;\n    std::string s = \"s%d\";\n    std::vector<int> v{ 1, 2, %d };\n", t, t, t, t, t
+            for (a = 0; a < count; ++a)
+            {
+                kind = a % 5
+                if (kind == 0) printf "    EXPECT_EQ(i + %d, %d + i) << \"check \" << %d;\n", a, a, a
+                else if (kind == 1) printf "    EXPECT_NEAR(d, d + %d * 1e-9, 1e-6);\n", a
+                else if (kind == 2) printf "    ASSERT_EQ(s, \"s%d\");\n", t
+                else if (kind == 3) printf "    EXPECT_LT(i, i + %d);\n", a + 1
+                else printf "    EXPECT_RANGE_EQ(v, v);\n"
+            }
+            printf "}\n"
+        }
+    }'
+} > "$WORK_DIR/tests.cpp"
+cat > "$WORK_DIR/main.cpp" <<'EOF'
+#define PINTTEST_IMPLEMENTATION
+#include "PintTest.h"
+
+int main(int argc, const char* argv[])
+{
+    return PintTest::runAllTests(argc, argv);
+}
+EOF
+
+# Prints the time in ms that the compile took
+timeCompile()
+{
+    start=$(date +%s%N)
+    $CXX $CXXFLAGS -I"$HEADER_DIR" "$@"
+    end=$(date +%s%N)
+    echo $(( (end - start) / 1000000 ))
+}
+
+echo "Compiling $((TESTS * ASSERTIONS_PER_TEST)) checks against $HEADER_DIR/PintTest.h"
+run=0
+while [ "$run" -lt "$RUNS" ]; do
+    headerOnly=$(timeCompile -c "$WORK_DIR/tests.cpp" -o "$WORK_DIR/headerOnly.o")
+    separate=$(timeCompile -DPINTTEST_SEPARATE_IMPLEMENTATION -c "$WORK_DIR/tests.cpp" -o "$WORK_DIR/tests.o")
+    implementation=$(timeCompile -c "$WORK_DIR/main.cpp" -o "$WORK_DIR/main.o")
+    echo "header only: $headerOnly ms, separate: $separate ms (+ $implementation ms, once, for the implementation)"
+    run=$((run + 1))
+done
+
+# Check that the separate build links, and that its tests pass
+$CXX $CXXFLAGS "$WORK_DIR/tests.o" "$WORK_DIR/main.o" -o "$WORK_DIR/tests"
+"$WORK_DIR/tests" --output=quiet > /dev/null
@@ -0,0 +1,56 @@
+#!/bin/sh
+# Measures the start up cost of registering a large number of tests - builds a program with FILES translation units of
+# TESTS_PER_FILE tests each (100,000 tests by default), and times running it with a filter that matches nothing, which
+# is all static initialisation, the duplicate name check and the filter.
+#     ./PintTestStartupBench.sh [header directory]
+# The header directory defaults to this one, so another version of PintTest.h can be compared by passing its directory.
+# CXX, CXXFLAGS, FILES, TESTS_PER_FILE and RUNS can be set in the environment.
+set -e
+
+HEADER_DIR=$(cd "${1:-$(dirname "$0")}" && pwd)
+CXX=${CXX:-g++}
+CXXFLAGS=${CXXFLAGS:--std=c++20 -O2 -pthread}
+FILES=${FILES:-100}
+TESTS_PER_FILE=${TESTS_PER_FILE:-1000}
+RUNS=${RUNS:-5}
+
+WORK_DIR=$(mktemp -d)
+trap 'rm -rf "$WORK_DIR"' EXIT
+
+file=0
+while [ "$file" -lt "$FILES" ]; do
+    {
+        echo '#include "PintTest.h"'
+        awk -v file="$file" -v count="$TESTS_PER_FILE" \
+            'BEGIN { for (i = 0; i < count; ++i) printf "TEST(Startup_%d_%d) { EXPECT_TRUE(true); }\n", file, i }'
+    } > "$WORK_DIR/tests$file.cpp"
+    file=$((file + 1))
+done
+cat > "$WORK_DIR/main.cpp" <<'EOF'
+#include "PintTest.h"
+#include <chrono>
+#include <iostream>
+
+int main()
+{
+    const auto start = std::chrono::steady_clock::now();
+    PintTest::runAllTests2({ "--filter=NoSuchTest" });
+    std::cout << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() << "\n";
+}
+EOF
+
+echo "Building $((FILES * TESTS_PER_FILE)) tests against $HEADER_DIR/PintTest.h"
+for source in "$WORK_DIR"/*.cpp; do
+    echo "$source"
+done | xargs -P "$(nproc 2>/dev/null || echo 4)" -I{} sh -c "$CXX $CXXFLAGS -I'$HEADER_DIR' -c {} -o {}.o"
+$CXX $CXXFLAGS "$WORK_DIR"/*.o -o "$WORK_DIR/startup"
+
+# The whole process is timed, to include the static initialisers, as well as the time spent in runAllTests2
+run=0
+while [ "$run" -lt "$RUNS" ]; do
+    start=$(date +%s%N)
+    inRun=$("$WORK_DIR/startup" | tail -n 1)
+    end=$(date +%s%N)
+    echo "process: $(( (end - start) / 1000000 )) ms, runAllTests2: $inRun ms"
+    run=$((run + 1))
+done